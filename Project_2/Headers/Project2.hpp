@@ -18,8 +18,10 @@
 #include <shader.hpp>
 #include <camera.hpp>
 #include <heightmap.hpp>
+#include <terrain_tiles.hpp>
 #include <track.hpp>
 #include <model.hpp>
+#include <texture_loader.hpp>
 
 // Basic C++ and C headers
 #include <iostream>
@@ -43,8 +45,6 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
-unsigned int loadTexture(const char *path);
-unsigned int loadCubemap(std::vector<std::string> faces);
 void set_lighting(Shader shader, glm::vec3 * pointLightPositions);
 
 
@@ -57,7 +57,6 @@ Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 float lastX = (float)SCR_WIDTH / 2.0;
 float lastY = (float)SCR_HEIGHT / 2.0;
 bool firstMouse = true;
-glm::vec3 init_Front;
 
 // timing
 float deltaTime = 0.0f;
@@ -69,6 +68,14 @@ bool drawHeightmap = true;
 bool drawBoxes = true;
 bool quaterians = true;
 bool drawNormals = true;
+// lift a flat grid by the height texture in the vertex shader instead of building the heightmap mesh
+bool displaceHeightmap = false;
+// light the heightmap from a lightmap of the static lights baked at startup instead of every light per fragment
+bool bakeHeightmapLight = true;
+// decode the texture images on the decode threads while the rest of the scene loads, instead of one after another as they are asked for
+bool parallelTextureDecode = true;
+// upload the models' vertices packed (VertexPacked, 24 bytes) instead of as floats (VertexModel, 56 bytes)
+bool packModelVertices = true;
 
 // Transformation Matrices
 glm::vec3 translation   = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -80,6 +87,9 @@ glm::vec3 scale         = glm::vec3(1.0f, 1.0f, 1.0f);
 // Step size of transformations
 float step_multiplier = 1.0f;
 
+// Distance between the planks of the track
+float plank_spacing = 2.0f;
+
 // Last Press
 float last_pressed = 0.0f;
 
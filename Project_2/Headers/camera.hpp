@@ -54,7 +54,7 @@ public:
 	float MouseSensitivity;
 	float Zoom;
 	// Our Parameters
-	float s;  // Position you are on the track
+	float distance = 0.0f;  // Position you are on the track, as the distance from the start
 	bool onTrack = false; // Whether or not you are following the track
 
 	// Constructor with vectors
@@ -96,46 +96,24 @@ public:
 			Position += Right * velocity;
 	}
 
-	//  Find the next camera position based on the amount of passed time, the track, and the track position s (defined in this class).  You can just use your code from the track function. 
+	//  Find the next camera position based on the amount of passed time, the track, and the track position distance (defined in this class).  You can just use your code from the track function. 
 	void ProcessTrackMovement(float deltaTime, Track &track)
 	{
 		// velocity will never be zero because hmax is higher than the actual highest point
-		float velocity = sqrt(2 * G * (track.hmax - track.get_point(s).y));
+		float velocity = sqrt(2 * G * (track.hmax - track.frame_at_distance(distance).origin.y));
 		float frame_movement = velocity * deltaTime;
 
-		// Use modula operation to limit value s;
-		if (s > track.max_s)
-			s = fmod(s, track.max_s);
+		// Use modula operation to limit the distance to one loop
+		distance = fmod(distance + frame_movement, track.track_length());
 
-		// small step movement
-		float step_size = 0.0001f;
-
-		// Calculate distance between current s and next_s
-		glm::vec3 temp_pos = track.get_point(s);
-		glm::vec3 next_pos = track.get_point(s + step_size);
-		float distance = glm::distance(next_pos, temp_pos);
-		while (distance < frame_movement) {
-			s += step_size;
-			frame_movement -= distance;
-
-			glm::vec3 temp_pos = next_pos;
-			glm::vec3 next_pos = track.get_point(s + step_size);
-			float distance = glm::distance(next_pos, temp_pos);
-		}
-
-		// When exit the while loop, already move enough distances
-		// Then update the orientation
-		bg_Front = glm::normalize(next_pos - temp_pos);
-		bg_Up = glm::normalize(glm::cross(bg_Right, bg_Front));
-		// At the end of the spline, add offset to let the up vector at the
-		// beginning and at the end match.
-		if (s >= track.max_s - 2.0f && s <= track.max_s) {
-			float local_step = (s - (track.max_s - 2.0f)) / 2.0f;
-			bg_Up += local_step * (glm::vec3(0.0f, 1.0f, 0.0f) - bg_Up);
-		}
-		bg_Right = glm::normalize(glm::cross(bg_Front, bg_Up));
+		// The orientation comes from the same frame table as the rails, so the cart follows
+		// their twist exactly and the loop closes without a jump
+		Orientation ori = track.frame_at_distance(distance);
+		bg_Front = ori.Front;
+		bg_Up = ori.Up;
+		bg_Right = ori.Right;
 		
-		bg_Position = temp_pos + bg_Up; //camera need to be above the rail
+		bg_Position = ori.origin + bg_Up; //camera need to be above the rail
 
 		if (onTrack)
 		{
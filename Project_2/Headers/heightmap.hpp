@@ -9,54 +9,55 @@
 #include <iostream>
 
 #include <shader.hpp>
+#include <heightmap_core.hpp>
+#include <terrain_bake.hpp>
 
 // Reference: https://github.com/nothings/stb/blob/master/stb_image.h#L4
 // To use stb_image, add this in *one* C++ source file.
 #include <stb_image.h>
 
-struct Vertex {
-	// position
-	glm::vec3 Position;
-	// position
-	glm::vec3 Normal;
-	// texCoords
-	glm::vec2 TexCoords;
-};
-
-class Heightmap
+// The height grid, mesh and normals are built by HeightmapCore (heightmap_core.hpp) so they can be
+// built and profiled without an OpenGL context. This class loads the image and owns the GL side.
+class Heightmap : public HeightmapCore
 {
 public:
-	//Heightmap attributes
-	int width, height;
 
 	// VAO for Heightmap
 	unsigned int VAO;
 
-	// pointer to data
-	unsigned char *data;
-
-	// Heightmap data
-	std::vector<Vertex> vertices;
-	// indices for EBO
-	std::vector<unsigned int> indices;
-
 
-	// constructor
-	Heightmap(const char* heightmapPath)
+	// Constructor, the chunks are drawn as triangle lists or as strips with primitive restart.
+	// MODE_DISPLACED keeps only a height texture and has to be drawn with heightmapShader_displaced.vert.
+	Heightmap(const char* heightmapPath, Topology topology = TOPOLOGY_TRIANGLES, Mode mode = MODE_MESH)
 	{
+		this->topology = topology;
+
 		// load Heightmap data
-		load_heightmap(heightmapPath);
+		int nrChannels;
+		unsigned char *data = stbi_load(heightmapPath, &width, &height, &nrChannels, 0);
+		if (!data)
+		{
+			std::cout << "Failed to load heightmap" << std::endl;
+		}
+
+		if (mode == MODE_DISPLACED)
+		{
+			// only the heights, the vertex shader does the rest
+			create_displaced(data, width, height, nrChannels);
+			stbi_image_free(data);
+			setup_displaced();
+			setup_normal_map();
+			return;
+		}
 
-		// create Heightmap verts from the data
-		create_heightmap();
+		// create Heightmap verts, normals and indices from the data
+		create_heightmap(data, width, height, nrChannels);
 
 		// free image data
 		stbi_image_free(data);
 
-		// create_indices - not using since normals are needed
-		create_indices();
-
 		setup_heightmap();
+		setup_normal_map();
 	}
 
 	// render the mesh
@@ -64,10 +65,7 @@ public:
 	{
 		// Set the shader properties
 		shader.use();
-		glm::mat4 heightmap_model;
-		heightmap_model = glm::translate(heightmap_model, glm::vec3(0.0f, -25.0f, 0.0f));
-		heightmap_model = glm::scale(heightmap_model, glm::vec3(30.0f, 10.0f, 30.0f));
-		shader.setMat4("model", heightmap_model);
+		shader.setMat4("model", model_matrix());
 
 
 		// Set material properties
@@ -80,119 +78,206 @@ public:
 		// and finally bind the textures
 		glBindTexture(GL_TEXTURE_2D, textureID);
 
-		// draw mesh
+		// the baked light on unit 2 for heightmapShader_baked.frag, the other shaders don't read it
+		if (lightTexture != 0)
+		{
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, lightTexture);
+			shader.setInt("lightmap", 2);
+		}
+
+		// the normal of every pixel on unit 3 for heightmapShader.frag and heightmapShader_baked.frag
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, normalTexture);
+		shader.setInt("normalMap", 3);
+		shader.setMat3("normalMatrix", glm::mat3(glm::transpose(glm::inverse(model_matrix()))));
+
 		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		if (topology == TOPOLOGY_STRIPS)
+		{
+			glEnable(GL_PRIMITIVE_RESTART);
+			glPrimitiveRestartIndex(RESTART_INDEX);
+		}
+		GLenum primitive = topology == TOPOLOGY_STRIPS ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+
+		if (mode == MODE_DISPLACED)
+		{
+			// the heights on unit 1, the flat patch once for every patch update_lod() kept
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, heightTexture);
+			shader.setInt("heights", 1);
+			shader.setInt("patchSize", PATCH_SIZE);
+			shader.setInt("patchColumns", patch_columns);
+			shader.setIVec2("gridSize", width, height);
+			shader.setVec2("extent", extent_x, extent_z);
+
+			if (uploaded_patches != patch_draws.size()) update_patches();
+			if (!patch_draws.empty())
+				glDrawElementsInstanced(primitive, (GLsizei)patch_indices.size(), GL_UNSIGNED_INT, 0, (GLsizei)patch_draws.size());
+		}
+		else
+		{
+			// draw the chunks picked by update_lod() in one call, every index pattern is relative to its chunk's first vertex
+			if (draw_counts.size() != chunk_draws.size()) update_draws();
+			if (!chunk_draws.empty())
+				glMultiDrawElementsBaseVertex(primitive, &draw_counts[0], GL_UNSIGNED_INT, &draw_offsets[0],
+					(GLsizei)chunk_draws.size(), &draw_bases[0]);
+		}
+
+		if (topology == TOPOLOGY_STRIPS)
+			glDisable(GL_PRIMITIVE_RESTART);
 		glBindVertexArray(0);
 
 		// always good practice to set everything back to defaults once configured.
 		glActiveTexture(GL_TEXTURE0);
 	}
 
+	// pick the level of every chunk and cull the ones outside the view, once per frame before Draw.
+	// Displaced patches are only culled.
+	void update_lod(const glm::mat4& view, const glm::mat4& projection, float viewport_height)
+	{
+		if (mode == MODE_DISPLACED)
+		{
+			select_patches(model_matrix(), view, projection);
+			update_patches();
+			return;
+		}
+		select_chunks(model_matrix(), view, projection, viewport_height);
+		update_draws();
+	}
+
 	void delete_buffers()
 	{
 		glDeleteVertexArrays(1, &VAO);
 		glDeleteBuffers(1, &VBO);
 		glDeleteBuffers(1, &EBO);
+		if (mode == MODE_DISPLACED)
+		{
+			glDeleteBuffers(1, &patchVBO);
+			glDeleteTextures(1, &heightTexture);
+		}
+		if (lightTexture != 0)
+			glDeleteTextures(1, &lightTexture);
+		glDeleteTextures(1, &normalTexture);
 	}
 
-private:
-
-	/*  Render data  */
-	unsigned int VBO , EBO;
-
-	void load_heightmap(const char* heightmapPath)
+	// upload what a TerrainBake baked for this heightmap, Draw binds it from then on
+	void set_lightmap(const TerrainBake& bake)
 	{
-		int nrChannels;
-		data = stbi_load(heightmapPath, &width, &height, &nrChannels, 0);
-		if (!data)
+		if (bake.width != width || bake.height != height || bake.texels.empty())
 		{
-			std::cout << "Failed to load heightmap" << std::endl;
+			std::cout << "Baked lighting doesn't fit the heightmap" << std::endl;
+			return;
 		}
-	}
-
-
 
-
-	Vertex make_vertex(int x, int y)
-	{
-		Vertex v;
-		//XYZ coords
-		v.Position.x = 2.0f*(float(x) / float(width - 1)) - 1.0f;
-		v.Position.y = float(data[x*width + y]) / 255.0f;
-		v.Position.z = 2.0f*(float(y) / float(height - 1)) - 1.0f;
-
-		// Setting normal to default, calculate later.  
-		v.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
-
-		//Texture Coords
-		v.TexCoords.x = float(x) / float(width - 1);
-		v.TexCoords.y = float(y) / float(height - 1);
-		return v;
+		if (lightTexture == 0)
+			glGenTextures(1, &lightTexture);
+		glBindTexture(GL_TEXTURE_2D, lightTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &bake.texels[0]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
+	// true once set_lightmap() has uploaded baked lighting
+	bool has_lightmap() const { return lightTexture != 0; }
 
+private:
 
-	void create_heightmap()
+	/*  Render data  */
+	unsigned int VBO , EBO;
+	// MODE_DISPLACED: the heights and the numbers of the patches to draw, one per instance
+	unsigned int heightTexture = 0, patchVBO = 0;
+	// the baked static lighting, RGBA8 with one texel per pixel
+	unsigned int lightTexture = 0;
+	// normal_texels, two bytes per pixel
+	unsigned int normalTexture = 0;
+	size_t uploaded_patches = 0;
+
+	// chunk_draws split up the way glMultiDrawElementsBaseVertex takes them
+	std::vector<GLsizei> draw_counts;
+	std::vector<const void*> draw_offsets;
+	std::vector<GLint> draw_bases;
+
+	void update_draws()
 	{
-		// convert heightmap to floats and set texture coordinates
-		for (int x = 0; x < width; x++)
+		draw_counts.resize(chunk_draws.size());
+		draw_offsets.resize(chunk_draws.size());
+		draw_bases.resize(chunk_draws.size());
+		for (size_t i = 0; i < chunk_draws.size(); i++)
 		{
-			for (int y = 0; y < height; y++)
-			{
-				vertices.push_back(make_vertex(x, y));
-			}
-
+			draw_counts[i] = (GLsizei)chunk_draws[i].count;
+			draw_offsets[i] = (const void*)(chunk_draws[i].first * sizeof(unsigned int));
+			draw_bases[i] = chunk_draws[i].base_vertex;
 		}
 	}
 
-	// Find the normal for each triangle uisng the cross product and then add it to all three vertices of the triangle.  
-	//   The normalization of all the triangles happens in the shader which averages all norms of adjacent triangles.   
-	//   Order of the triangles matters here since you want to normal facing out of the object.  
-	void set_normals(Vertex &p1, Vertex &p2, Vertex &p3)
+	void update_patches()
 	{
-		glm::vec3 normal =  glm::cross(p2.Position - p1.Position, p3.Position - p1.Position);
-		p1.Normal += normal;
-		p2.Normal += normal;
-		p3.Normal += normal;
+		glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+		if (!patch_draws.empty())
+			glBufferData(GL_ARRAY_BUFFER, patch_draws.size() * sizeof(int), &patch_draws[0], GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		uploaded_patches = patch_draws.size();
 	}
 
-
-	void create_indices()
+	void setup_displaced()
 	{
-		// convert heightmap to floats and set texture coordinates.  Also set normals for each triangle we define.
-		for (int x = 0; x < width - 1; x++)
-		{
-			for (int y = 0; y < height - 1; y++)
-			{
+		// the first channel of the image as it is, rows aren't padded to 4 bytes
+		glGenTextures(1, &heightTexture);
+		glBindTexture(GL_TEXTURE_2D, heightTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, height_pixels.empty() ? NULL : &height_pixels[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+		glGenBuffers(1, &patchVBO);
 
-				unsigned int a, b, c, d;
-				a = x*width + y;
-				b = x*width + y + 1;
-				c = (x + 1)*width + y;
-				d = (x + 1)*width + y + 1;
+		glBindVertexArray(VAO);
 
-				// Triangle 1
-				indices.push_back(a); // 0
-				indices.push_back(b); // 1
-				indices.push_back(c); // 3
+		// the flat patch, two bytes per vertex
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, patch_vertices.size(), &patch_vertices[0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribIPointer(0, 2, GL_UNSIGNED_BYTE, 2, (void*)0);
 
-				//while here, add normals. 
-				set_normals(vertices[a], vertices[b], vertices[c]);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, patch_indices.size() * sizeof(unsigned int), &patch_indices[0], GL_STATIC_DRAW);
 
-				// Triangle 2
-				indices.push_back(b); // 1
-				indices.push_back(d); // 2
-				indices.push_back(c); // 3
+		// which patch, once per instance
+		update_patches();
+		glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+		glEnableVertexAttribArray(3);
+		glVertexAttribIPointer(3, 1, GL_INT, sizeof(int), (void*)0);
+		glVertexAttribDivisor(3, 1);
 
-				//And again, add normals. 
-				set_normals(vertices[b], vertices[d], vertices[c]);
- 
-			}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 
-		}
+	void setup_normal_map()
+	{
+		// filtered between the pixels like the lightmap, rows of two bytes aren't always padded to 4
+		glGenTextures(1, &normalTexture);
+		glBindTexture(GL_TEXTURE_2D, normalTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, width, height, 0, GL_RG, GL_UNSIGNED_BYTE, normal_texels.empty() ? NULL : &normal_texels[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
 	}
-	
 
 	void setup_heightmap()
 	{
@@ -210,7 +295,8 @@ private:
 		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+		// the index patterns of all the chunk levels, the full grid's indices aren't needed on the GPU
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, chunk_indices.size() * sizeof(unsigned int), &chunk_indices[0], GL_STATIC_DRAW);
 
 		// set the vertex attribute pointers
 		// vertex Positions
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+#include <vertex.hpp>
+
+
+// Everything about the heightmap that doesn't need an OpenGL context: the height grid,
+// the terrain mesh and its normals. Heightmap (heightmap.hpp) loads the image and adds
+// the buffers and the draw call on top of this, the benchmark uses it directly.
+//
+// In MODE_DISPLACED there is no mesh, only the 8 bit heights and one flat patch of PATCH_SIZE cells
+// that the vertex shader moves into place and lifts for every part of the grid (create_displaced()).
+//
+// Image row r and column c become vertex r * width + c. Rows run along x and columns
+// along z, the longer side of the image spans [-1, 1] and the shorter one keeps the aspect ratio.
+class HeightmapCore
+{
+public:
+
+	// a block of the grid drawn on its own at the level of detail select_chunks() picks for it
+	struct Chunk {
+		// first vertex and size in cells
+		int row, column, rows, columns;
+		// which set of index patterns fits it, the last row and column of chunks can be larger
+		int shape;
+		// model space bounds
+		glm::vec3 lower, upper;
+		// largest height difference in model space between the full grid and each level
+		float error[8];
+	};
+
+	// one chunk in a glMultiDrawElementsBaseVertex call
+	struct ChunkDraw {
+		// first index in chunk_indices and how many
+		unsigned int first, count;
+		// first vertex of the chunk, added to every index
+		int base_vertex;
+		// triangles it draws
+		unsigned int triangles;
+	};
+
+	// how indices and chunk_indices list the triangles
+	enum Topology {
+		// three indices per triangle, drawn as GL_TRIANGLES
+		TOPOLOGY_TRIANGLES,
+		// triangle strips ended by RESTART_INDEX, drawn as GL_TRIANGLE_STRIP with primitive restart
+		TOPOLOGY_STRIPS
+	};
+
+	// which sides of a chunk meet a chunk one level coarser, the first row of a chunk is the top
+	enum Stitch { STITCH_TOP = 1, STITCH_BOTTOM = 2, STITCH_LEFT = 4, STITCH_RIGHT = 8, STITCH_MASKS = 16 };
+
+	// cells along each side of a chunk, the last row/column of chunks also takes what is left over
+	static const int CHUNK_SIZE = 64;
+	// level l keeps every 2^l-th row and column of a chunk, at most 8 (see Chunk::error)
+	static const int LOD_LEVELS = 6;
+	// cells along each side of a patch in MODE_DISPLACED, patches on the last row/column stick out of the grid
+	static const int PATCH_SIZE = 64;
+	// ends a strip in TOPOLOGY_STRIPS
+	static constexpr unsigned int RESTART_INDEX = 0xFFFFFFFFu;
+
+	// pixels per row and number of rows of the image
+	int width = 0, height = 0;
+
+	// height of every pixel in [0, 1], row major like the image
+	std::vector<float> heights;
+
+	// Heightmap data, one vertex per pixel
+	std::vector<Vertex> vertices;
+	// the whole grid, two triangles per cell listed as topology says. Only create_indices() fills it, the
+	// viewer draws chunk_indices, and at 8192x8192 this would be 1.6 GB.
+	std::vector<unsigned int> indices;
+
+	// where the vertices come from
+	enum Mode {
+		// a Vertex per pixel built on the CPU by create_heightmap(), drawn in chunks with levels of detail
+		MODE_MESH,
+		// the heights stay 8 bit and go to the GPU as a texture, heightmapShader_displaced.vert makes
+		// the vertices from one flat patch drawn once per PATCH_SIZE x PATCH_SIZE cells (create_displaced())
+		MODE_DISPLACED
+	};
+	Mode mode = MODE_MESH;
+
+	// set before create_heightmap(), the triangles are the same either way
+	Topology topology = TOPOLOGY_TRIANGLES;
+	// Cells across one block of strips, 0 = strips along whole rows. The strips of a block run row after
+	// row, so the vertices the next strip shares with this one are still in the GPU's post-transform cache,
+	// which has to hold a little more than a block's row: 8 fits caches of 16 vertices.
+	int strip_block = 8;
+
+	// half the size of the grid along x (rows) and z (columns), the longer one is 1
+	float extent_x = 1.0f, extent_z = 1.0f;
+
+	// chunks, row by row, calculated by build_chunks()
+	std::vector<Chunk> chunks;
+	int chunk_rows = 0, chunk_columns = 0;
+
+	// Index patterns of every chunk shape, level and stitch mask, relative to the first vertex of the chunk.
+	// Pattern (shape * LOD_LEVELS + level) * STITCH_MASKS + stitch starts at pattern_first and has pattern_count indices.
+	std::vector<unsigned int> chunk_indices;
+	std::vector<unsigned int> pattern_first, pattern_count, pattern_triangles;
+
+	// level of every chunk and the visible chunks, from select_chunks().
+	// Until it is called every chunk is drawn at full detail.
+	std::vector<int> chunk_level;
+	std::vector<ChunkDraw> chunk_draws;
+	// triangles in chunk_draws
+	size_t chunk_triangles = 0;
+
+	// MODE_DISPLACED: the first channel of the image, row major
+	std::vector<unsigned char> height_pixels;
+	// patches across the grid, and the lowest and highest height of each one (row major)
+	int patch_rows = 0, patch_columns = 0;
+	std::vector<glm::vec2> patch_heights;
+	// the flat patch: (row, column) of every vertex inside the patch, and its indices as topology says
+	std::vector<unsigned char> patch_vertices;
+	std::vector<unsigned int> patch_indices;
+	// the patches in view from select_patches(), row major numbers. Until it is called all of them.
+	std::vector<int> patch_draws;
+
+	// Model space normal of every pixel for the terrain shaders, row major like the image. Two bytes: x and z
+	// mapped from [-1, 1] to [0, 255], y follows from them because the ground always faces up. Built in either
+	// mode, so the lighting keeps the image's resolution however coarse the chunks or patches drawn are.
+	std::vector<unsigned char> normal_texels;
+
+	// largest height error select_chunks() lets a chunk show on screen, in pixels
+	float pixel_error = 2.0f;
+
+	// threads create_heightmap() may use, 0 = the whole shared pool plus the caller
+	unsigned int threads = 0;
+
+	// empty heightmap, call create_heightmap() yourself
+	HeightmapCore() {}
+
+	// MODE_DISPLACED instead of create_heightmap(): keep the first channel of the image, the height range of
+	// every patch and the flat patch. Nothing per vertex, the memory is about the size of the grey image.
+	void create_displaced(const unsigned char* pixels, int width, int height, int channels);
+
+	// the patches whose bounds are inside the view frustum, into patch_draws
+	void select_patches(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+
+	// What heightmapShader_displaced.vert makes of vertex (row, column) of the flat patch drawn for patch number
+	// patch. The same as the vertex create_heightmap() makes for the pixel, the benchmark checks that it is.
+	Vertex displaced_vertex(int patch, int row, int column) const;
+
+	// Build the heights, vertices, normals and chunks from an 8 bit image as stbi_load returns it.
+	// The first channel of every pixel is the height, so grey, grey + alpha and RGB(A) images all work.
+	// Every buffer is sized once and filled by row bands in parallel. An image smaller than 2x2 gives no mesh.
+	void create_heightmap(const unsigned char* pixels, int width, int height, int channels);
+
+	// stage 1: heights of rows [first, last) from the image
+	void build_heights(const unsigned char* pixels, int channels, int first, int last);
+	// stage 2: vertices of rows [first, last), normals by central differences of the heights
+	void build_vertices(int first, int last);
+	// size indices for topology and fill them in parallel, not part of create_heightmap(), only on request
+	void create_indices();
+	// indices of the cells between rows [first, last) and the row after each, TOPOLOGY_TRIANGLES
+	void build_indices(int first, int last);
+	// strips of the blocks [first, last) of strip_block columns, TOPOLOGY_STRIPS
+	void build_strips(int first, int last);
+	// indices build_strips() writes for a block of columns cells
+	size_t strip_block_size(int columns) const;
+	// stage 4: chunks, their bounds and errors, and the index patterns of every level (heightmap_chunks.cpp)
+	void build_chunks();
+	// the flat patch of MODE_DISPLACED, laid out like a chunk at full detail (heightmap_chunks.cpp)
+	void build_patch();
+	// stage 5, in either mode: size normal_texels and fill it in parallel
+	void create_normal_map();
+	// normal_texels of rows [first, last) from normal_at()
+	void build_normal_map(int first, int last);
+
+	// the unit normal texel (row, column) of normal_texels decodes to, what heightmapShader.frag gets at the pixel
+	glm::vec3 normal_texel(int row, int column) const;
+
+	// Pick a level for every chunk so its error covers at most pixel_error pixels, with neighbours at most one
+	// level apart so the coarser one's edge can be stitched in, and list the chunks inside the view frustum.
+	void select_chunks(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, float viewport_height);
+
+	// the draw call of a chunk at its level in chunk_level, stitched to its neighbours
+	ChunkDraw chunk_draw(size_t chunk) const;
+
+	// the heightmap's model matrix, its grid is scaled up to 60 x 10 x 60 below the track
+	glm::mat4 model_matrix() const;
+
+	// model space x of a row and z of a column of pixels
+	float row_x(int row) const;
+	float column_z(int column) const;
+
+	// height of pixel (row, column) in [0, 1], clamped to the image, in either mode
+	float height_at(int row, int column) const;
+	// unit normal of the surface at pixel (row, column) in model space, before the heightmap's model matrix
+	glm::vec3 normal_at(int row, int column) const;
+
+	// Ground under a world space point (x, z) through model_matrix(): the height bilinearly filtered between
+	// the four pixels around it and, if normal isn't NULL, the world space unit normal filtered the same way.
+	// Points off the grid get the height of its nearest edge. (heightmap_query.cpp)
+	float ground_height(glm::vec2 point, glm::vec3* normal = NULL) const;
+	// The same for count points at once, four at a time with SIMD (if ground_simd()) unless simd is false,
+	// and split over the shared pool when there are many. normals may be NULL. In MODE_DISPLACED the normals
+	// of the four pixels are worked out on the way and there is no SIMD.
+	void ground_heights(const glm::vec2* points, size_t count, float* heights, glm::vec3* normals = NULL, bool simd = true) const;
+	// true if ground_heights() was built with SIMD
+	static bool ground_simd();
+
+private:
+
+	// forget the old grid and take the size and extents of a new one
+	void reset(int width, int height);
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped read-only into memory. The pages are only read from disk when they
+// are touched, so opening a large file is cheap and nothing is copied.
+// The mapping is released by close() or when the object goes away.
+class MappedFile
+{
+public:
+
+	MappedFile() {}
+	~MappedFile() { close(); }
+
+	// map the file, false if it can't be opened. An empty file opens with size() == 0.
+	bool open(const std::string& path)
+	{
+		close();
+
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER file_size;
+		GetFileSizeEx(file, &file_size);
+		bytes = (size_t)file_size.QuadPart;
+		if (bytes == 0) return true;
+
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL)
+			memory = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		descriptor = ::open(path.c_str(), O_RDONLY);
+		if (descriptor < 0) return false;
+
+		struct stat info;
+		fstat(descriptor, &info);
+		bytes = (size_t)info.st_size;
+		if (bytes == 0) return true;
+
+		void* view = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, descriptor, 0);
+		if (view != MAP_FAILED)
+			memory = (const unsigned char*)view;
+#endif
+
+		if (memory == NULL)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (memory != NULL) UnmapViewOfFile(memory);
+		if (mapping != NULL) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (memory != NULL) munmap((void*)memory, bytes);
+		if (descriptor >= 0) ::close(descriptor);
+		descriptor = -1;
+#endif
+		memory = NULL;
+		bytes = 0;
+	}
+
+	// trade mappings, so one that was checked can be handed on without mapping the file again
+	void swap(MappedFile& other)
+	{
+		std::swap(memory, other.memory);
+		std::swap(bytes, other.bytes);
+#ifdef _WIN32
+		std::swap(file, other.file);
+		std::swap(mapping, other.mapping);
+#else
+		std::swap(descriptor, other.descriptor);
+#endif
+	}
+
+	bool is_open()
+	{
+#ifdef _WIN32
+		return file != INVALID_HANDLE_VALUE;
+#else
+		return descriptor >= 0;
+#endif
+	}
+
+	// first byte of the file, NULL when it is empty or not open
+	const unsigned char* data() { return memory; }
+
+	size_t size() { return bytes; }
+
+private:
+
+	// a mapping can't be shared between two owners
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const unsigned char* memory = NULL;
+	size_t bytes = 0;
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int descriptor = -1;
+#endif
+};
+
+// 64 bit FNV-1a hash of a block of memory, used to tell whether a cached file still matches its source
+inline unsigned long long hash_bytes(const void* data, size_t size, unsigned long long hash = 14695981039346656037ULL)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// hash_bytes of a whole file, 0 if it can't be read
+inline unsigned long long hash_file(const std::string& path)
+{
+	MappedFile file;
+	if (!file.open(path)) return 0;
+	return hash_bytes(file.data(), file.size());
+}
@@ -8,6 +8,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <shader.hpp>
+#include <vertex.hpp>
 
 #include <string>
 #include <fstream>
@@ -16,19 +17,6 @@
 #include <vector>
 using namespace std;
 
-struct VertexModel {
-	// position
-	glm::vec3 Position;
-	// normal
-	glm::vec3 Normal;
-	// texCoords
-	glm::vec2 TexCoords;
-	// tangent
-	glm::vec3 Tangent;
-	// bitangent
-	glm::vec3 Bitangent;
-};
-
 struct Texture {
 	unsigned int id;
 	string type;
@@ -38,21 +26,30 @@ struct Texture {
 class Mesh {
 public:
 	/*  Mesh Data  */
-	vector<VertexModel> vertices;
-	vector<unsigned int> indices;
+	// the vertices and indices only live in the buffers, they are uploaded from wherever the model has them
+	unsigned int indexCount;
 	vector<Texture> textures;
 	unsigned int VAO;
 
 	/*  Functions  */
 	// constructor
-	Mesh(vector<VertexModel> vertices, vector<unsigned int> indices, vector<Texture> textures)
+	Mesh(const VertexModel* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, vector<Texture> textures)
 	{
-		this->vertices = vertices;
-		this->indices = indices;
+		this->indexCount = (unsigned int)indexCount;
 		this->textures = textures;
 
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
-		setupMesh();
+		setupMesh(vertices, vertexCount, indices);
+	}
+
+	// the same with VertexPacked vertices, only lightingShader_nMap.vert and the shaders that just read
+	// the position and the normal can draw it (there is no bitangent attribute)
+	Mesh(const VertexPacked* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, vector<Texture> textures)
+	{
+		this->indexCount = (unsigned int)indexCount;
+		this->textures = textures;
+
+		setupPackedMesh(vertices, vertexCount, indices);
 	}
 
 	// render the mesh
@@ -87,20 +84,28 @@ public:
 
 		// draw mesh
 		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
 		glBindVertexArray(0);
 
 		// always good practice to set everything back to defaults once configured.
 		glActiveTexture(GL_TEXTURE0);
 	}
 
+	// the textures belong to the model, only the buffers go
+	void delete_buffers()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+	}
+
 private:
 	/*  Render data  */
 	unsigned int VBO, EBO;
 
 	/*  Functions    */
 	// initializes all the buffer objects/arrays
-	void setupMesh()
+	void setupMesh(const VertexModel* vertices, size_t vertexCount, const unsigned int* indices)
 	{
 		// create buffers/arrays
 		glGenVertexArrays(1, &VAO);
@@ -113,10 +118,10 @@ private:
 		// A great thing about structs is that their memory layout is sequential for all its items.
 		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
 		// again translates to 3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexModel), &vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(VertexModel), vertices, GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
 
 		// set the vertex attribute pointers
 		// vertex Positions
@@ -137,4 +142,34 @@ private:
 
 		glBindVertexArray(0);
 	}
+
+	// initializes the buffer objects/arrays for packed vertices
+	void setupPackedMesh(const VertexPacked* vertices, size_t vertexCount, const unsigned int* indices)
+	{
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(VertexPacked), vertices, GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+		// vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexPacked), (void*)0);
+		// vertex normals, signed normalized 10:10:10:2, the shaders read xyz
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(VertexPacked), (void*)offsetof(VertexPacked, Normal));
+		// vertex texture coords, half floats
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(VertexPacked), (void*)offsetof(VertexPacked, TexCoords));
+		// vertex tangent with the sign of the bitangent in w
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(VertexPacked), (void*)offsetof(VertexPacked, Tangent));
+
+		glBindVertexArray(0);
+	}
 };
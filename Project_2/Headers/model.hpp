@@ -10,8 +10,12 @@
 #include <assimp/postprocess.h>
 
 #include <mesh.hpp>
+#include <model_core.hpp>
 #include <shader.hpp>
+#include <texture_loader.hpp>
 
+#include <chrono>
+#include <cstdio>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -22,24 +26,76 @@
 
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
-
-class Model
+// The vertices, indices and texture names come from ModelCore (model_core.hpp), filled by Assimp on the
+// first run and from the cache file next to the model after that. This class adds the buffers and textures.
+class Model : public ModelCore
 {
 public:
 	/*  Model Data */
-	vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+	vector<Texture> textures_loaded;	// every texture this model holds in TextureRegistry::shared(), one reference each, given back by delete_buffers().
 	vector<Mesh> meshes;
-	string directory;
 	bool gammaCorrection;
+	VertexLayout layout;
 
 	/*  Functions   */
-	// constructor, expects a filepath to a 3D model.
-	Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+	// constructor, expects a filepath to a 3D model. Assimp only runs if the cache is missing or stale,
+	// the meshes it makes are welded and reordered for the vertex cache (optimize_meshes()) before they are cached.
+	// The textures are decoded by textures and only filled in by its upload_ready() or finish(),
+	// without one the model decodes its own in parallel and uploads them before it returns.
+	// gamma loads the diffuse maps as sRGB textures, a different texture from the same file loaded without it.
+	// LAYOUT_PACKED uploads the vertices as VertexPacked, which only lightingShader_nMap.vert and normal.vert draw.
+	Model(string const &path, TextureLoader* textures = NULL, bool gamma = false, VertexLayout layout = LAYOUT_FLOAT)
+		: gammaCorrection(gamma), layout(layout)
+	{
+		string cache = cache_path(path);
+		if (load_cache(cache, path))
+		{
+			printf("Model %s loaded from its cache in %.1f ms (Assimp took %.1f ms)\n", path.c_str(), cache_ms, import_ms);
+		}
+		else
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			loadModel(path);
+			import_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+			printf("Model %s imported by Assimp in %.1f ms\n", path.c_str(), import_ms);
+			optimize_meshes();
+			if (!mesh_data.empty())
+				save_cache(cache, path);
+		}
+		printf("Model %s: meshes optimized in %.1f ms, %d entry vertex cache\n", path.c_str(), optimize_ms, (int)VERTEX_CACHE_SIZE);
+		for (size_t i = 0; i < mesh_data.size(); i++)
+			printf("  mesh %2zu: %7zu -> %7zu vertices, ACMR %.2f -> %.2f\n", i, mesh_data[i].source_vertices, mesh_data[i].vertex_count(),
+				mesh_data[i].acmr_before, mesh_data[i].acmr_after);
+
+		auto t0 = std::chrono::steady_clock::now();
+		if (textures != NULL)
+		{
+			setupMeshes(*textures);
+		}
+		else
+		{
+			TextureLoader own;
+			setupMeshes(own);
+			own.finish();
+		}
+		release_cache();
+		printf("Model %s: %zu meshes, %.1f MB uploaded in %.1f ms\n", path.c_str(), meshes.size(), mesh_bytes(layout) / (1024.0 * 1024.0),
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+		if (layout == LAYOUT_PACKED)
+			printf("Model %s: packed vertices save %.1f MB (%.1f MB as floats)\n", path.c_str(),
+				(mesh_bytes(LAYOUT_FLOAT) - mesh_bytes(LAYOUT_PACKED)) / (1024.0 * 1024.0), mesh_bytes(LAYOUT_FLOAT) / (1024.0 * 1024.0));
+	}
+
+	// the textures go back to the registry, if this was the last model holding them they are deleted
+	~Model()
 	{
-		loadModel(path);
+		release_textures();
 	}
 
+	// the meshes and the textures hold GL names, a copy would delete them twice
+	Model(const Model&) = delete;
+	Model& operator=(const Model&) = delete;
+
 	// draws the model, and thus all its meshes
 	void Draw(Shader shader)
 	{
@@ -47,9 +103,18 @@ public:
 			meshes[i].Draw(shader);
 	}
 
+	// delete the mesh buffers and give back the textures, while the OpenGL context is still there
+	void delete_buffers()
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			meshes[i].delete_buffers();
+		meshes.clear();
+		release_textures();
+	}
+
 private:
 	/*  Functions   */
-	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+	// loads a model with supported ASSIMP extensions from file and stores the resulting meshes in mesh_data.
 	void loadModel(string const &path)
 	{
 		// read file via ASSIMP
@@ -77,7 +142,7 @@ private:
 			// the node object only contains indices to index the actual objects in the scene. 
 			// the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			meshes.push_back(processMesh(mesh, scene));
+			mesh_data.push_back(processMesh(mesh, scene));
 		}
 		// after we've processed all of the meshes (if any) we then recursively process each of the children nodes
 		for (unsigned int i = 0; i < node->mNumChildren; i++)
@@ -87,12 +152,13 @@ private:
 
 	}
 
-	Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+	MeshData processMesh(aiMesh *mesh, const aiScene *scene)
 	{
 		// data to fill
-		vector<VertexModel> vertices;
-		vector<unsigned int> indices;
-		vector<Texture> textures;
+		MeshData data;
+		vector<VertexModel>& vertices = data.vertices;
+		vector<unsigned int>& indices = data.indices;
+		vector<TextureName>& textures = data.textures;
 
 		// Walk through each of the mesh's vertices
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -151,93 +217,74 @@ private:
 		// normal: texture_normalN
 
 		// 1. diffuse maps
-		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+		materialTextureNames(material, aiTextureType_DIFFUSE, "texture_diffuse", textures);
 		// 2. specular maps
-		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+		materialTextureNames(material, aiTextureType_SPECULAR, "texture_specular", textures);
 		// 3. normal maps
-		std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-		textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+		materialTextureNames(material, aiTextureType_HEIGHT, "texture_normal", textures);
 		// 4. height maps
-		std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
+		materialTextureNames(material, aiTextureType_AMBIENT, "texture_height", textures);
 
-		// return a mesh object created from the extracted mesh data
-		return Mesh(vertices, indices, textures);
+		// return the extracted mesh data, setupMeshes() makes the Mesh objects from it
+		return data;
 	}
 
-	// checks all material textures of a given type and loads the textures if they're not loaded yet.
-	// the required info is returned as a Texture struct.
-	vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+	// the names of all material textures of a given type, the textures are loaded by setupMeshes()
+	void materialTextureNames(aiMaterial *mat, aiTextureType type, string typeName, vector<TextureName>& textures)
 	{
-		vector<Texture> textures;
 		for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 		{
 			aiString str;
 			mat->GetTexture(type, i, &str);
-			// check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-			bool skip = false;
-			for (unsigned int j = 0; j < textures_loaded.size(); j++)
+			TextureName name;
+			name.type = typeName;
+			name.path = str.C_Str();
+			textures.push_back(name);
+		}
+	}
+
+	// a Mesh with its buffers and textures for every mesh in mesh_data
+	void setupMeshes(TextureLoader& loader)
+	{
+		meshes.reserve(mesh_data.size());
+		for (size_t i = 0; i < mesh_data.size(); i++)
+		{
+			vector<Texture> textures;
+			for (size_t t = 0; t < mesh_data[i].textures.size(); t++)
+				textures.push_back(loadMaterialTexture(mesh_data[i].textures[t], loader));
+			// straight from the mapped cache file after load_cache()
+			const MeshData& data = mesh_data[i];
+			if (layout == LAYOUT_PACKED)
 			{
-				if (std::strcmp(textures_loaded[j].path.C_Str(), str.C_Str()) == 0)
-				{
-					textures.push_back(textures_loaded[j]);
-					skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-					break;
-				}
-			}
-			if (!skip)
-			{   // if texture hasn't been loaded already, load it
-				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), this->directory);
-				texture.type = typeName;
-				texture.path = str;
-				textures.push_back(texture);
-				textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+				vector<VertexPacked> packed;
+				pack_vertices(data.vertex_data(), data.vertex_count(), packed);
+				meshes.push_back(Mesh(packed.empty() ? NULL : &packed[0], packed.size(), data.index_data(), data.index_count(), textures));
 			}
+			else
+				meshes.push_back(Mesh(data.vertex_data(), data.vertex_count(), data.index_data(), data.index_count(), textures));
 		}
-		return textures;
 	}
-};
 
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-	string filename = string(path);
-	filename = directory + '/' + filename;
-
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-	if (data)
+	// the texture from the registry, loaded (its image decoded by loader) if no model or anything else has it yet.
+	// the required info is returned as a Texture struct.
+	Texture loadMaterialTexture(const TextureName& name, TextureLoader& loader)
 	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
+		// only colours are sRGB, normal, specular and height maps are data
+		bool srgb = gammaCorrection && name.type == "texture_diffuse";
+
+		Texture texture;
+		texture.id = loader.acquire_2d(this->directory + '/' + name.path, srgb);
+		texture.type = name.type;
+		texture.path.Set(name.path);
+		textures_loaded.push_back(texture);
+		return texture;
 	}
-	else
+
+	void release_textures()
 	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+		for (unsigned int i = 0; i < textures_loaded.size(); i++)
+			TextureRegistry::shared().release(textures_loaded[i].id);
+		textures_loaded.clear();
 	}
+};
 
-	return textureID;
-}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vertex.hpp>
+#include <mapped_file.hpp>
+
+
+// Everything about an Assimp model that doesn't need an OpenGL context or Assimp: the vertices, indices
+// and texture names of every mesh as Model::processMesh() makes them. Model (model.hpp) fills it from
+// Assimp or from the cache file next to the model and adds the buffers and textures on top of it.
+//
+// The cache keeps the meshes in the order processNode() visits them, together with a hash of the model
+// file and of the material libraries it names. A cache from another version, for other source files or
+// for sources that changed since is ignored, and the model is imported and cached again (model_cache.cpp).
+class ModelCore
+{
+public:
+
+	// a texture of a mesh: the sampler name without its number (texture_diffuse ...) and the file,
+	// relative to the model's folder
+	struct TextureName {
+		std::string type, path;
+	};
+
+	// one aiMesh after processMesh()
+	struct MeshData {
+		std::vector<VertexModel> vertices;
+		std::vector<unsigned int> indices;
+		std::vector<TextureName> textures;
+
+		// After load_cache() vertices and indices are empty, the mesh stays in the mapped cache file and
+		// these point into it until release_cache(). The counts are kept after that.
+		const VertexModel* mapped_vertices = NULL;
+		const unsigned int* mapped_indices = NULL;
+		size_t mapped_vertex_count = 0, mapped_index_count = 0;
+
+		// the vertices and indices to upload, wherever they are
+		const VertexModel* vertex_data() const { return vertices.empty() ? mapped_vertices : &vertices[0]; }
+		const unsigned int* index_data() const { return indices.empty() ? mapped_indices : &indices[0]; }
+		size_t vertex_count() const { return vertices.empty() ? mapped_vertex_count : vertices.size(); }
+		size_t index_count() const { return indices.empty() ? mapped_index_count : indices.size(); }
+
+		// vertices before optimize_mesh() welded the identical ones, and the average cache miss ratio
+		// (vertices transformed per triangle) before and after it, all 0 if it never ran
+		size_t source_vertices = 0;
+		float acmr_before = 0.0f, acmr_after = 0.0f;
+	};
+	std::vector<MeshData> mesh_data;
+
+	// folder of the model file, without the last '/'
+	std::string directory;
+
+	// How long Assimp took to import the model, also when it came from the cache (the cache keeps the time
+	// it was made in), and how long the last load_cache() took. from_cache tells which one the model used.
+	double import_ms = 0.0, cache_ms = 0.0;
+	// how long optimize_meshes() took, kept in the cache like import_ms
+	double optimize_ms = 0.0;
+	bool from_cache = false;
+
+	// entries of the FIFO post-transform cache the triangle order is made for and acmr() counts with
+	static const unsigned int VERTEX_CACHE_SIZE = 16;
+
+	// how Model uploads the vertices: as they are, or packed into VertexPacked
+	enum VertexLayout { LAYOUT_FLOAT, LAYOUT_PACKED };
+
+	ModelCore() {}
+
+	// nanosuit/nanosuit.obj -> nanosuit/nanosuit.model
+	static std::string cache_path(const std::string& modelPath);
+
+	// what the cache depends on: the model file and, for an .obj, every mtllib it names, relative to its folder
+	static std::vector<std::string> source_files(const std::string& modelPath);
+
+	// write mesh_data and import_ms to path with the hashes of the source files of modelPath,
+	// false if it can't be written
+	bool save_cache(const std::string& path, const std::string& modelPath) const;
+
+	// map path and take the meshes from it, false (and nothing changed) if it is missing, from
+	// another version, broken, or a source file of modelPath isn't the one it was made from.
+	// The vertices and indices aren't copied, the file stays mapped until release_cache().
+	bool load_cache(const std::string& path, const std::string& modelPath);
+
+	// unmap the cache file once the meshes are uploaded
+	void release_cache();
+
+	// vertices and indices of every mesh, what goes to the GPU in layout
+	size_t mesh_bytes(VertexLayout layout = LAYOUT_FLOAT) const;
+
+	// the normal and the tangent normalized and quantized to 10 bits, the sign of the bitangent against
+	// cross(normal, tangent), the texture coordinates rounded to half floats (model_pack.cpp)
+	static VertexPacked pack_vertex(const VertexModel& vertex);
+	// the other way, with the bitangent worked out the way lightingShader_nMap.vert does
+	static VertexModel unpack_vertex(const VertexPacked& vertex);
+	static void pack_vertices(const VertexModel* vertices, size_t count, std::vector<VertexPacked>& packed);
+	static void pack_vertices(const std::vector<VertexModel>& vertices, std::vector<VertexPacked>& packed);
+
+	static uint16_t float_to_half(float value);
+	static float half_to_float(uint16_t half);
+
+	// Assimp gives every triangle corner its own vertex: weld the ones that are the same byte for byte,
+	// reorder the triangles for the post-transform cache (Tipsify) and the vertices into the order the
+	// triangles first use them (model_optimize.cpp). Done once at import, the cache keeps the result.
+	static void optimize_mesh(MeshData& mesh);
+	void optimize_meshes();
+
+	// vertices transformed per triangle drawing indices through a FIFO cache of cache_size entries,
+	// 3 without any reuse, 0.5 at best for a large regular grid
+	static float acmr(const std::vector<unsigned int>& indices, unsigned int cache_size = VERTEX_CACHE_SIZE);
+
+private:
+
+	// the file load_cache() took the meshes from
+	MappedFile cache;
+};
@@ -6,6 +6,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class rc_SplineSegment;
@@ -24,16 +25,37 @@ private:
 	/** @brief vector of control points */
 	pointVector m_vPoints;
 
+	/** @brief points of every segment file parsed so far, by full path
+	*
+	*	An index can name the same segment many times, it is only read once.
+	*/
+	std::unordered_map<std::string, pointVector> m_segmentCache;
+
 	/** @brief load the definition of this spline segment from a file 
 	*  
 	*  @param filename file containing the definition for this spline segment
+	*  @return false if the file is missing or malformed, see error
+	*/
+	bool loadSegmentFrom(std::string filename);
+
+	/** @brief parse a segment file into points, without touching the cache
 	*/
-	void loadSegmentFrom(std::string filename);
+	bool parseSegment(const std::string& path, pointVector& points);
 
 public:
 	
 	std::string folder;
 
+	/** @brief every file loadSplineFrom read, relative to folder, the index first
+	*
+	*	Each file is listed once, however often the index names it.
+	*	Used to tell whether a compiled track is older than the files it was made from.
+	*/
+	std::vector<std::string> files;
+
+	/** @brief what went wrong in the last load that returned false, as "file:line: message"
+	*/
+	std::string error;
 
 	/** @brief add a point to the spline segment 
 	*  
@@ -61,8 +83,10 @@ public:
 	/** @brief load the definition of this spline from a file 
 	*  
 	*  @param filename file containing the definition for this spline
+	*  @return false if the index or one of its segments is missing or malformed,
+	*	the message is printed and kept in error
 	*/
-	void loadSplineFrom(std::string filename);
+	bool loadSplineFrom(std::string filename);
 
 
 };
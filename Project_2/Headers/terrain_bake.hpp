@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include <heightmap_core.hpp>
+
+
+// The heightmap's lighting from everything that doesn't move, worked out once on the shared thread pool
+// instead of in every fragment: the directional light with the shadows the terrain casts, horizon based
+// ambient occlusion and the diffuse part of the point lights. heightmapShader_baked.frag reads it back
+// as one texture fetch and only adds the flashlight, which follows the camera.
+//
+// There is one texel per pixel of the heightmap, row major like the image, so the texture has the
+// image's size. The result is kept in a .bake file next to the image with a key made from the heights,
+// the model matrix, the lights and the settings, a file with another key is baked again.
+class TerrainBake
+{
+public:
+
+	// the lights of set_lighting() in Project2.cpp that don't follow the camera
+	struct Lights {
+		// direction the sun shines in
+		glm::vec3 direction = glm::vec3(0.24f, -0.3f, 0.91f);
+		glm::vec3 ambient = glm::vec3(0.05f), diffuse = glm::vec3(0.5f);
+		// the point lights all share one attenuation
+		glm::vec3 point_position[4] = { glm::vec3(0.7f, 0.2f, 2.0f), glm::vec3(2.3f, -3.3f, -4.0f),
+			glm::vec3(-4.0f, 2.0f, -12.0f), glm::vec3(0.0f, 0.0f, -3.0f) };
+		glm::vec3 point_ambient[4] = { glm::vec3(0.05f), glm::vec3(0.05f), glm::vec3(0.05f), glm::vec3(0.05f) };
+		glm::vec3 point_diffuse[4] = { glm::vec3(0.8f), glm::vec3(0.8f), glm::vec3(0.8f), glm::vec3(0.8f) };
+		float constant = 1.0f, linear = 0.09f, quadratic = 0.032f;
+	};
+	Lights lights;
+
+	// pixels the horizon is searched along each of the 8 directions for occlusion
+	int ao_radius = 32;
+	// pixels a shadow ray goes toward the sun at most before the pixel counts as lit
+	int shadow_distance = 512;
+	// threads bake() may use, 0 = the whole shared pool plus the caller
+	unsigned int threads = 0;
+
+	// size of the heightmap it was baked for
+	int width = 0, height = 0;
+	// RGBA8 per pixel: the static light reaching the ground (rgb) and the ambient occlusion (a)
+	std::vector<unsigned char> texels;
+
+	// how long the last bake() or load() took, and whether bake_cached() could use the file
+	double bake_ms = 0.0, load_ms = 0.0;
+	bool from_cache = false;
+
+	TerrainBake() {}
+
+	// bake every pixel of map, split into bands of rows over the shared pool
+	void bake(const HeightmapCore& map);
+
+	// load path if its key matches map and the settings, otherwise bake and write it
+	void bake_cached(const HeightmapCore& map, const std::string& path);
+
+	// the texels from path, false (and nothing changed) if it is missing, broken or for other heights or lights
+	bool load(const std::string& path, const HeightmapCore& map);
+	// write the texels to path with the key of map, false if it can't be written
+	bool save(const std::string& path, const HeightmapCore& map) const;
+
+	// hash of the heights, the model matrix, the lights and the settings
+	unsigned long long key(const HeightmapCore& map) const;
+
+	// hflab4.jpg -> hflab4.bake
+	static std::string cache_path(const std::string& imagePath);
+
+private:
+
+	// world space height of every pixel, its highest one and the world distance between rows and columns, from bake()
+	std::vector<float> world_height;
+	float highest = 0.0f, step_x = 1.0f, step_z = 1.0f;
+	// highest world height under every block of 8x8 pixels and the two rows and columns after it,
+	// a shadow ray above it can't hit anything before it leaves the block
+	std::vector<float> block_highest;
+	int block_columns = 0;
+	// pixels away the horizon is looked for, and one over their world distance in each direction
+	std::vector<int> horizon_steps;
+	std::vector<float> horizon_inverse;
+
+	// texels of rows [first, last)
+	void bake_rows(const HeightmapCore& map, int first, int last);
+	// 1 if the sun reaches pixel (row, column), 0 if the terrain is in the way
+	float sun_visible(int row, int column) const;
+	// share of the sky above pixel (row, column) the terrain around it leaves open, in [0, 1]
+	float open_sky(int row, int column) const;
+	// world height between the pixels, bilinearly filtered
+	float world_height_at(float row, float column) const;
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+
+#include <shader.hpp>
+#include <terrain_tiles_core.hpp>
+
+
+// Tiles, cache and loading live in TerrainTilesCore (terrain_tiles_core.hpp). This class gives every
+// resident tile its own vertex buffer and draws them, the vertices are only kept on the GPU.
+class TerrainTiles : public TerrainTilesCore
+{
+public:
+
+	TerrainTiles() {}
+
+	~TerrainTiles()
+	{
+		close();
+	}
+
+	// render the resident tiles, each moved to its place in the world
+	void Draw(Shader shader, unsigned int textureID)
+	{
+		// Set the shader properties
+		shader.use();
+
+		// Set material properties
+		shader.setVec3("material.specular", 0.3f, 0.3f, 0.3f);
+		shader.setFloat("material.shininess", 64.0f);
+
+		// active proper texture unit before binding
+		glActiveTexture(GL_TEXTURE0);
+		// and finally bind the textures
+		glBindTexture(GL_TEXTURE_2D, textureID);
+
+		for (size_t id = 0; id < tiles.size(); id++)
+		{
+			if (tiles[id].state != TILE_RESIDENT) continue;
+
+			glm::mat4 tile_model;
+			tile_model = glm::translate(tile_model, tile_origin(id));
+			shader.setMat4("model", tile_model);
+
+			glBindVertexArray(tile_VAO[id]);
+			glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		}
+		glBindVertexArray(0);
+
+		// always good practice to set everything back to defaults once configured.
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	void delete_buffers()
+	{
+		clear();
+		if (EBO != 0) glDeleteBuffers(1, &EBO);
+		EBO = 0;
+	}
+
+protected:
+
+	void upload_tile(size_t id)
+	{
+		Tile& tile = tiles[id];
+		if (tile_VAO.size() != tiles.size())
+		{
+			tile_VAO.assign(tiles.size(), 0);
+			tile_VBO.assign(tiles.size(), 0);
+		}
+
+		// every tile has the same indices
+		if (EBO == 0)
+		{
+			glGenBuffers(1, &EBO);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+		}
+
+		glGenVertexArrays(1, &tile_VAO[id]);
+		glGenBuffers(1, &tile_VBO[id]);
+
+		glBindVertexArray(tile_VAO[id]);
+		glBindBuffer(GL_ARRAY_BUFFER, tile_VBO[id]);
+		glBufferData(GL_ARRAY_BUFFER, tile.vertices.size() * sizeof(Vertex), &tile.vertices[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		// vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		// vertex normal coords
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+		glBindVertexArray(0);
+
+		// the GPU has it now
+		std::vector<Vertex>().swap(tile.vertices);
+	}
+
+	void release_tile(size_t id)
+	{
+		if (id >= tile_VAO.size() || tile_VAO[id] == 0) return;
+		glDeleteVertexArrays(1, &tile_VAO[id]);
+		glDeleteBuffers(1, &tile_VBO[id]);
+		tile_VAO[id] = tile_VBO[id] = 0;
+	}
+
+private:
+
+	/*  Render data  */
+	std::vector<unsigned int> tile_VAO, tile_VBO;
+	unsigned int EBO = 0;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vertex.hpp>
+#include <thread_pool.hpp>
+
+
+// Terrain too big for memory, split into tiles of RAW height samples that are mapped and turned
+// into meshes on a background thread when the camera comes near, and dropped again (least recently
+// used first) when the tiles in memory would go over memory_budget.
+// TerrainTiles (terrain_tiles.hpp) uploads the meshes and draws them, the benchmark uses this directly.
+//
+// A tile set is a small text file naming the layout, next to one file per tile:
+//
+//   tiles 16 16      # rows and columns of tiles
+//   samples 513 513  # samples per tile (rows, columns), neighbouring tiles share their edge samples
+//   format u16       # u16 or f32, little endian, row major
+//   spacing 0.25     # world units between two samples
+//   scale 0.001      # world height = offset + sample * scale
+//   offset -25
+//   origin -30 -30   # world x and z of the first sample of tile 0 0
+//
+// Tile (row, column) is <row>_<column>.raw in the same folder. Rows run along x and columns along z
+// like the heightmap.
+class TerrainTilesCore
+{
+public:
+
+	enum TileFormat { FORMAT_U16, FORMAT_F32 };
+
+	enum TileState {
+		// not in memory
+		TILE_EMPTY,
+		// being built on the loader thread
+		TILE_LOADING,
+		// built, waiting for update() to upload it
+		TILE_LOADED,
+		// uploaded and drawn
+		TILE_RESIDENT,
+		// the file is missing or the wrong size, not tried again
+		TILE_FAILED
+	};
+
+	struct Tile {
+		int row, column;
+		TileState state;
+		// the mesh, in the tile's own space (see tile_origin), until upload_tile() takes it
+		std::vector<Vertex> vertices;
+		// lowest and highest world height, once it is loaded
+		float low, high;
+		// place in the least recently used list while resident
+		std::list<size_t>::iterator used;
+	};
+
+	// layout from the tile set file
+	int tile_rows = 0, tile_columns = 0;
+	int sample_rows = 0, sample_columns = 0;
+	TileFormat format = FORMAT_U16;
+	float spacing = 1.0f, scale = 1.0f, offset = 0.0f;
+	glm::vec2 origin;
+	// folder of the tile set file, with the trailing slash
+	std::string folder;
+
+	// every tile, row by row
+	std::vector<Tile> tiles;
+	// indices of one tile, the same for all of them
+	std::vector<unsigned int> indices;
+
+	// bytes the tiles in memory (and on their way) may take up together
+	size_t memory_budget = 256u << 20;
+	// tiles closer than this to the camera (in x and z) are wanted
+	float view_distance = 60.0f;
+	// loaded tiles handed to upload_tile() per update(), so a burst of loads doesn't stall a frame
+	int uploads_per_frame = 2;
+
+	// counters since open(): a wanted tile was resident (hit) or had to be loaded (miss)
+	size_t hits = 0, misses = 0, evictions = 0, failures = 0;
+	// bytes of the tiles in memory or being loaded, now and at most so far
+	size_t resident_bytes = 0, peak_resident_bytes = 0;
+	// time the loader thread spent building tiles, in milliseconds
+	double build_ms = 0.0;
+
+	// what went wrong in open()
+	std::string error;
+
+	TerrainTilesCore() {}
+	virtual ~TerrainTilesCore();
+
+	// read a tile set file, false (with error set) if it is missing or malformed.
+	// The tiles themselves are only read when update() wants them.
+	bool open(const std::string& path);
+
+	// Once per frame: take the tiles the loader finished, upload a few, and request the wanted tiles
+	// around camera (nearest first), dropping the least recently used ones that aren't wanted to stay in budget.
+	void update(glm::vec3 camera);
+
+	// wait until the loader thread has nothing left to do
+	void wait();
+
+	// drop every tile, the counters stay
+	void clear();
+
+	// size of one tile's mesh
+	size_t tile_bytes() const;
+
+	// world position of the first sample of a tile, its vertices are relative to this
+	glm::vec3 tile_origin(size_t id) const;
+
+	// file of one tile
+	std::string tile_path(int row, int column) const;
+
+	// map a tile's file and build its mesh, false if the file is missing or the wrong size. Thread safe.
+	bool build_tile(size_t id, std::vector<Vertex>& out, float& low, float& high) const;
+
+protected:
+
+	// a tile has been loaded, the GL side makes its buffers here and can let go of the vertices
+	virtual void upload_tile(size_t /*id*/) {}
+	// a tile is being dropped, the GL side deletes its buffers here
+	virtual void release_tile(size_t /*id*/) {}
+
+	// stop the loader, subclasses call this first in their destructor so no job sees them half destroyed
+	void close();
+
+private:
+
+	// resident tiles, most recently used first
+	std::list<size_t> used;
+	// the frame the tile was last wanted, tiles wanted this frame aren't dropped
+	std::vector<unsigned int> wanted_frame;
+	unsigned int frame = 0;
+
+	// what the loader hands back for a tile
+	struct Finished {
+		size_t id;
+		bool ok;
+		double ms;
+	};
+	std::mutex finished_mutex;
+	std::vector<Finished> finished;
+	// tiles requested and not collected yet
+	size_t loading = 0;
+	std::atomic<bool> closing{ false };
+
+	// take what the loader finished, TILE_LOADED or TILE_FAILED
+	void collect();
+	// drop a resident tile
+	void evict(size_t id);
+
+	// the background thread that builds the tiles, last so it is stopped before everything else goes
+	ThreadPool loader{ 1 };
+};
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <texture_loader_core.hpp>
+#include <texture_registry.hpp>
+
+// Reference: https://github.com/nothings/stb/blob/master/stb_image.h#L4
+// To use stb_image, add this in *one* C++ source file.
+#include <stb_image.h>
+
+// Textures whose images are decoded with stb_image on the decode threads (texture_loader_core.hpp) and
+// uploaded on this thread, which has the OpenGL context. load_2d() and load_cubemap() make the texture
+// right away so the meshes and the draw code can keep its name, and fill it in once its image comes back:
+// upload_ready() takes the ones done so far, finish() all of them before the first frame.
+// acquire_2d() and acquire_cubemap() go through TextureRegistry::shared() and only load what isn't there yet.
+class TextureLoader : public TextureLoaderCore
+{
+public:
+
+	// time spent in glTexImage2D and glGenerateMipmap
+	double upload_ms = 0.0;
+
+	// parallel = false decodes and uploads every image when it is asked for and lets the driver make the
+	// mipmaps, the way the textures were loaded before
+	TextureLoader(bool parallel = true)
+	{
+		this->parallel = parallel;
+		cpu_mipmaps = parallel;
+		decode = [](const char* path, int* width, int* height, int* channels)
+		{
+			return stbi_load(path, width, height, channels, 0);
+		};
+		release = [](unsigned char* pixels)
+		{
+			stbi_image_free(pixels);
+		};
+	}
+
+	// 2D texture with mipmaps, repeated, from an image file; srgb for colours stored in sRGB
+	unsigned int load_2d(const std::string& path, bool srgb = false)
+	{
+		unsigned int textureID = create_2d();
+		queue(textureID, GL_TEXTURE_2D, path, srgb, false);
+		return textureID;
+	}
+
+	// load_2d() through the registry: the texture already loaded from the same file if there is one,
+	// give it back with TextureRegistry::shared().release()
+	unsigned int acquire_2d(const std::string& path, bool srgb = false)
+	{
+		TextureRegistry& registry = TextureRegistry::shared();
+		std::string name = TextureRegistryCore::normalize_path(path);
+		unsigned int textureID = registry.acquire(name, srgb);
+		if (textureID != 0) return textureID;
+
+		textureID = create_2d();
+		registry.insert(name, srgb, textureID);
+		queue(textureID, GL_TEXTURE_2D, name, srgb, true);
+		return textureID;
+	}
+
+	// loads a cubemap texture from 6 individual texture faces
+	// order:
+	// +X (right)
+	// -X (left)
+	// +Y (top)
+	// -Y (bottom)
+	// +Z (front)
+	// -Z (back)
+	unsigned int load_cubemap(const std::vector<std::string>& faces)
+	{
+		unsigned int textureID = create_cubemap();
+		for (unsigned int i = 0; i < faces.size(); i++)
+			queue(textureID, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faces[i], false, false);
+		return textureID;
+	}
+
+	// load_cubemap() through the registry, keyed by all its faces
+	unsigned int acquire_cubemap(const std::vector<std::string>& faces)
+	{
+		TextureRegistry& registry = TextureRegistry::shared();
+		std::vector<std::string> names;
+		std::string name;
+		for (size_t i = 0; i < faces.size(); i++)
+		{
+			names.push_back(TextureRegistryCore::normalize_path(faces[i]));
+			name += names[i] + '\n';
+		}
+		unsigned int textureID = registry.acquire(name, false);
+		if (textureID != 0) return textureID;
+
+		textureID = create_cubemap();
+		registry.insert(name, false, textureID);
+		for (unsigned int i = 0; i < names.size(); i++)
+			queue(textureID, GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, names[i], false, true);
+		return textureID;
+	}
+
+	// upload the images decoded so far, in the order they were asked for
+	size_t upload_ready()
+	{
+		return TextureLoaderCore::upload_ready(uploader());
+	}
+
+	// upload every image asked for, waiting for the ones still being decoded
+	size_t finish()
+	{
+		return TextureLoaderCore::finish(uploader());
+	}
+
+private:
+
+	// the texture and face each image goes to, by its place in the upload order
+	struct Target {
+		unsigned int id;
+		GLenum target;
+		// in the registry, which gets its size
+		bool shared;
+	};
+	std::vector<Target> targets;
+
+	unsigned int create_2d()
+	{
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		return textureID;
+	}
+
+	unsigned int create_cubemap()
+	{
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
+		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		return textureID;
+	}
+
+	// decode path for the target (a 2D texture with mipmaps or a cube map face), right away without parallel
+	void queue(unsigned int textureID, GLenum target, const std::string& path, bool srgb, bool shared)
+	{
+		targets.push_back(Target{ textureID, target, shared });
+		request(path, target == GL_TEXTURE_2D, srgb);
+		if (!parallel) upload_ready();
+	}
+
+	UploadFunction uploader()
+	{
+		return [this](const Image& image, size_t index) { upload(image, targets[index]); };
+	}
+
+	void upload(const Image& image, const Target& target)
+	{
+		bool cube = target.target != GL_TEXTURE_2D;
+		// released again before its image came in, the texture is gone
+		TextureRegistry& registry = TextureRegistry::shared();
+		if (target.shared && registry.find(target.id) == NULL)
+			return;
+		if (!image.ok())
+		{
+			std::cout << (cube ? "Cubemap texture" : "Texture") << " failed to load at path: " << image.path << std::endl;
+			return;
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		GLenum format = GL_RGBA;
+		if (image.channels == 1)
+			format = GL_RED;
+		else if (image.channels == 2)
+			format = GL_RG;
+		else if (image.channels == 3)
+			format = GL_RGB;
+		// one and two channel images have no sRGB format, they are data anyway
+		GLenum internalFormat = format;
+		if (image.srgb && image.channels == 3)
+			internalFormat = GL_SRGB8;
+		else if (image.srgb && image.channels == 4)
+			internalFormat = GL_SRGB8_ALPHA8;
+
+		glBindTexture(cube ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D, target.id);
+		// the rows of RGB images and of the small levels aren't 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int l = 0; l < image.level_count(); l++)
+		{
+			int width, height;
+			const unsigned char* pixels = image.level(l, width, height);
+			glTexImage2D(target.target, l, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, pixels);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		// without cpu_mipmaps the driver makes them, as before, about another third of the image
+		size_t bytes = (size_t)image.width * image.height * image.channels + image.mip_pixels.size();
+		if (image.mipmaps && image.level_count() == 1)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
+			bytes += bytes / 3;
+		}
+		if (target.shared)
+			registry.add_bytes(target.id, bytes);
+		upload_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	}
+};
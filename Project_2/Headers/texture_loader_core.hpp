@@ -0,0 +1,106 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Everything about loading texture images that doesn't need an OpenGL context. The files are decoded, and
+// their mip levels made, on a pool of decode threads while the main thread gets on with the rest of the
+// startup, and handed back to it in the order they were asked for, so the textures are filled the same way
+// whichever image happens to be decoded first. TextureLoader (texture_loader.hpp) decodes with stb_image and
+// uploads every image into the texture it was asked for with, the benchmark uses this directly.
+//
+// request() and the draining calls belong to one thread, only the decoding runs anywhere else.
+class TextureLoaderCore
+{
+public:
+
+	// Decodes the file at path into 8 bit pixels with as many channels as the file has, NULL if it can't.
+	// Called from the decode threads, several at once. release frees what it returned.
+	typedef std::function<unsigned char*(const char* path, int* width, int* height, int* channels)> DecodeFunction;
+	typedef std::function<void(unsigned char* pixels)> ReleaseFunction;
+
+	struct Image {
+		std::string path;
+		// asked for with mipmaps, the levels are only made here with cpu_mipmaps
+		bool mipmaps = false;
+		// colours stored in sRGB, averaged in linear light for the mip levels
+		bool srgb = false;
+		// all 0 and NULL if the file couldn't be decoded
+		int width = 0, height = 0, channels = 0;
+		unsigned char* pixels = NULL;
+		// levels 1 .. one after another, each half the size of the one before (rounded down, at least 1)
+		std::vector<unsigned char> mip_pixels;
+		std::vector<size_t> mip_offsets;
+		double decode_ms = 0.0, mipmap_ms = 0.0;
+		// set once the decode thread is done with it
+		bool decoded = false;
+
+		bool ok() const { return pixels != NULL; }
+		int level_count() const { return ok() ? 1 + (int)mip_offsets.size() : 0; }
+		// pixels of a level and its size
+		const unsigned char* level(int index, int& level_width, int& level_height) const;
+	};
+
+	// gets every image, also the ones that failed, with its place in the order they were asked for
+	typedef std::function<void(const Image& image, size_t index)> UploadFunction;
+
+	DecodeFunction decode;
+	ReleaseFunction release;
+
+	// false decodes each image on the calling thread when it is asked for, the way textures used to load
+	bool parallel = true;
+	// make the mip levels of the images asked for with mipmaps next to the decode, instead of leaving them to the driver
+	bool cpu_mipmaps = true;
+
+	// totals of the images handed over so far: time the decode threads spent on them, time the draining
+	// thread had to wait for one, and the bytes of their pixels with all mip levels
+	double decode_ms = 0.0, mipmap_ms = 0.0, wait_ms = 0.0;
+	size_t image_count = 0, failed_count = 0, image_bytes = 0;
+
+	TextureLoaderCore() {}
+	// waits for the images still being decoded
+	~TextureLoaderCore();
+
+	// the decode threads hold on to the images
+	TextureLoaderCore(const TextureLoaderCore&) = delete;
+	TextureLoaderCore& operator=(const TextureLoaderCore&) = delete;
+
+	// queue the file for decoding, returns its place in the upload order
+	size_t request(const std::string& path, bool mipmaps, bool srgb = false);
+
+	// hand over the decoded images from the oldest one not handed over yet up to the first one still
+	// being decoded, without waiting; returns how many
+	size_t upload_ready(const UploadFunction& upload);
+	// hand over every image asked for so far, waiting for each one in turn
+	size_t finish(const UploadFunction& upload);
+
+	size_t requested() const { return images.size(); }
+	size_t uploaded() const { return next_upload; }
+
+	// mip levels of image from its pixels, each texel the average of the 2x2 texels above it, in linear light
+	// for the colours of an sRGB image (a level with an odd size drops the last row or column of the one
+	// above it like glGenerateMipmap may)
+	static void make_mipmaps(Image& image);
+
+	// decode threads, one per hardware thread, shared by every loader
+	static unsigned int decode_threads();
+
+private:
+
+	// a deque so the images don't move while the decode threads fill them in
+	std::deque<Image> images;
+	size_t next_upload = 0;
+
+	// guards Image::decoded
+	std::mutex mutex;
+	std::condition_variable decoded;
+
+	void decode_image(Image& image, bool mipmaps);
+	void free_pixels(Image& image);
+	size_t drain(const UploadFunction& upload, bool wait);
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <texture_registry_core.hpp>
+
+// The one texture registry of the program (texture_registry_core.hpp), which deletes a texture when its last
+// reference goes. TextureLoader::acquire_2d() and acquire_cubemap() load the textures that aren't in it yet.
+class TextureRegistry : public TextureRegistryCore
+{
+public:
+
+	// the registry the whole program shares
+	static TextureRegistry& shared()
+	{
+		static TextureRegistry registry;
+		return registry;
+	}
+
+	// give back a texture from acquire_2d() or acquire_cubemap(), the last one deletes it
+	void release(unsigned int id)
+	{
+		if (TextureRegistryCore::release(id))
+			glDeleteTextures(1, &id);
+	}
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+
+// The textures of the whole program by file, so two models (or a model and the scene) that use the same
+// image share one texture, and a texture is deleted once the last one holding it lets it go. The key is the
+// normalized path and whether the image is sRGB, which makes it a different texture. A cube map is keyed by
+// its faces. TextureRegistry (texture_registry.hpp) deletes the GL textures, TextureLoader fills it in.
+//
+// Only used from the thread with the OpenGL context.
+class TextureRegistryCore
+{
+public:
+
+	struct Entry {
+		unsigned int id;
+		// normalized path, or the paths of the faces one per line for a cube map
+		std::string name;
+		bool srgb;
+		size_t references;
+		// pixels uploaded into it so far, with its mip levels
+		size_t bytes;
+	};
+
+	// every acquire(), and the ones that found the texture already there
+	size_t lookups = 0, hits = 0;
+
+	TextureRegistryCore() {}
+
+	// a\b//./c/../d.png -> a/b/d.png, only the text is looked at (no links followed, case kept)
+	static std::string normalize_path(const std::string& path);
+
+	// the texture of name and srgb with one more reference, 0 if there is none yet
+	unsigned int acquire(const std::string& name, bool srgb);
+	// a texture just made for name and srgb, holding its first reference
+	void insert(const std::string& name, bool srgb, unsigned int id);
+	// one reference fewer, true if that was the last one and the texture has to be deleted
+	bool release(unsigned int id);
+
+	// count bytes more for the texture, ignored if it isn't registered (any more)
+	void add_bytes(unsigned int id, size_t bytes);
+
+	// the entry of a registered texture, NULL for any other
+	const Entry* find(unsigned int id) const;
+
+	size_t texture_count() const { return by_id.size(); }
+	size_t total_bytes() const { return bytes; }
+
+private:
+
+	std::unordered_map<std::string, unsigned int> by_name;
+	std::unordered_map<unsigned int, Entry> by_id;
+	size_t bytes = 0;
+
+	// name and the sRGB flag, a path can't hold the 0 between them
+	static std::string key(const std::string& name, bool srgb);
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run queued jobs in order.
+// Mostly used through parallel_for(), which splits a range over the workers and the calling
+// thread and returns when all of it is done. Jobs must not call parallel_for() on the same
+// pool again, the outer call could end up waiting for workers that are all waiting themselves.
+class ThreadPool
+{
+public:
+
+	// threads = 0 starts one worker per hardware thread
+	ThreadPool(unsigned int threads = 0)
+	{
+		if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned int i = 0; i < threads; i++)
+			workers.push_back(std::thread(&ThreadPool::work, this));
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+
+	// number of worker threads
+	unsigned int size() { return (unsigned int)workers.size(); }
+
+	// run job on one of the workers
+	void enqueue(std::function<void()> job)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobs.push(job);
+		}
+		wake.notify_one();
+	}
+
+	// Call body(begin, end) on consecutive pieces of [first, last), one piece per thread.
+	// max_threads limits how many threads take part (0 = every worker plus the caller),
+	// the calling thread always does the last piece itself.
+	// If a piece throws, the other pieces still finish before the first exception is thrown on.
+	void parallel_for(size_t first, size_t last, std::function<void(size_t, size_t)> body, unsigned int max_threads = 0)
+	{
+		if (last <= first) return;
+
+		size_t pieces = max_threads == 0 ? size() + 1 : max_threads;
+		pieces = std::min(pieces, last - first);
+		if (pieces <= 1)
+		{
+			body(first, last);
+			return;
+		}
+
+		size_t piece_size = (last - first + pieces - 1) / pieces;
+
+		std::mutex done_mutex;
+		std::condition_variable done;
+		size_t remaining = 0;
+		std::exception_ptr failure;
+
+		size_t begin = first;
+		for (; begin + piece_size < last; begin += piece_size)
+		{
+			size_t end = begin + piece_size;
+			{
+				std::unique_lock<std::mutex> lock(done_mutex);
+				remaining++;
+			}
+			enqueue([&body, &done_mutex, &done, &remaining, &failure, begin, end]()
+			{
+				std::exception_ptr thrown;
+				try { body(begin, end); }
+				catch (...) { thrown = std::current_exception(); }
+
+				std::unique_lock<std::mutex> lock(done_mutex);
+				if (thrown && !failure) failure = thrown;
+				if (--remaining == 0) done.notify_one();
+			});
+		}
+
+		// the last piece on this thread, the queued pieces point into this frame so they are waited for even if it throws
+		std::exception_ptr thrown;
+		try { body(begin, last); }
+		catch (...) { thrown = std::current_exception(); }
+
+		std::unique_lock<std::mutex> lock(done_mutex);
+		while (remaining > 0) done.wait(lock);
+
+		if (!thrown) thrown = failure;
+		if (thrown) std::rethrow_exception(thrown);
+	}
+
+	// the pool the whole program shares, started on first use
+	static ThreadPool& shared()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+private:
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()> > jobs;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	// worker loop: take the next job until the pool is destroyed
+	void work()
+	{
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				while (!stopping && jobs.empty()) wake.wait(lock);
+				if (jobs.empty()) return;
+
+				job = jobs.front();
+				jobs.pop();
+			}
+			job();
+		}
+	}
+};
@@ -8,53 +8,31 @@
 #include <iostream>
 
 #include <shader.hpp>
-#include <rc_spline.h>
+#include <track_core.hpp>
 
-struct Orientation {
-	// Front
-	glm::vec3 Front;
-	// Up
-	glm::vec3 Up;
-	// Right
-	glm::vec3 Right;
-	// origin
-	glm::vec3 origin;
-};
 
-
-class Track
+// The spline, frames and mesh generation live in TrackCore (track_core.hpp) so they can be
+// built and profiled without an OpenGL context. This class only owns the GL side.
+class Track : public TrackCore
 {
 public:
 
 	// VAO
 	unsigned int VAO;
-
-	// Control Points Loading Class for loading from File
-	rc_Spline g_Track;
-
-	// Vector of control points
-	std::vector<glm::vec3> controlPoints;
-
-	// Track data
-	std::vector<Vertex> vertices;
-	// indices for EBO
-	std::vector<unsigned int> indices;
-
-	// hmax for camera
-	float hmax = 0.0f;
-
-	// maximun s value, calculated by create_track()
-	int max_s;
+	// VAO for the plank mesh plus its per instance transforms
+	unsigned int plankVAO;
+	// VAO for the pillar mesh plus the per instance position and height of every support
+	unsigned int supportVAO = 0;
 
 	// constructor, just use same VBO as before, 
-	Track(const char* trackPath)
-	{		
-		// load Track data
-		load_track(trackPath);
+	Track(const char* trackPath) : TrackCore(trackPath)
+	{
+		setup_track();
 
-		create_track();
+		setup_planks();
 
-		setup_track();
+		// the rails of a compiled track came straight from its mapping, which isn't needed any more
+		release_compiled();
 	}
 
 	// render the mesh
@@ -78,321 +56,117 @@ public:
 
 		// draw mesh
 		glBindVertexArray(VAO);
-		glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+		glDrawElements(GL_TRIANGLES, rail_index_count(), index_type, 0);
 		glBindVertexArray(0);
 
 		// always good practice to set everything back to defaults once configured.
 		glActiveTexture(GL_TEXTURE0);
 	}
 
-	// give a positive float s, find the point by interpolation
-	// determine pA, pB, pC, pD based on the integer of s
-	// determine u based on the decimal of s
-	// E.g. s=1.5 is the at the halfway point between the 1st and 2nd control point,
-	//		the 4 control points are:[0,1,2,3], with u=0.5
-	glm::vec3 get_point(float s)
+	// render all planks with one instanced draw call,
+	// the shader takes the plank transform from attribute 3-6 (see lightingShader_instanced.vert)
+	void DrawPlanks(Shader shader, unsigned int textureID)
 	{
-		// use modulo operation to ensure all points are valid (max_s hard-coded)
-		int pA = ((int)floor(s) + max_s - 1) % max_s;
-		int pB = ((int)floor(s) + max_s) % max_s;
-		int pC = ((int)floor(s) + max_s + 1) % max_s;
-		int pD = ((int)floor(s) + max_s + 2) % max_s;
-		float u = s - floor(s);
-
-		return interpolate(controlPoints[pA], controlPoints[pB], controlPoints[pC], controlPoints[pD], 0.5f, u);
-	}
-
+		if (plank_transforms.empty()) return;
 
-	void delete_buffers()
-	{
-		glDeleteVertexArrays(1, &VAO);
-		glDeleteBuffers(1, &VBO);
-		glDeleteBuffers(1, &EBO);
-	}
-
-	
-	private:
-	
-	/*  Render data  */
-	unsigned int VBO, EBO;
+		// Set the shader properties
+		shader.use();
+		glm::mat4 track_model;
+		shader.setMat4("model", track_model);
 
-	void load_track(const char* trackPath)
-	{
-		// Set folder path for our projects (easier than repeatedly defining it)
-		g_Track.folder = "../Project_2/Media/";
+		// Set material properties
+		shader.setVec3("material.specular", 0.3f, 0.3f, 0.3f);
+		shader.setFloat("material.shininess", 64.0f);
 
-		// Load the control points
-		g_Track.loadSplineFrom(trackPath);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, textureID);
 
-	}
+		// draw mesh
+		glBindVertexArray(plankVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, plank_indices.size(), GL_UNSIGNED_INT, 0, plank_transforms.size());
+		glBindVertexArray(0);
 
-	// Implement the Catmull-Rom Spline here
-	//	Given 4 points, a tau and the u value 
-	//	u in range of [0,1]  
-	//	Since you can just use linear algebra from glm, just make the vectors and matrices and multiply them.  
-	//	This should not be a very complicated function
-	glm::vec3 interpolate(glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, float tau, float u)
-	{
-		// Construct a matrix with points 		
-		glm::mat4x3 mat_points;
-		mat_points[0] = pointA;
-		mat_points[1] = pointB;
-		mat_points[2] = pointC;
-		mat_points[3] = pointD;
-
-		// Construct a matrix with tau
-		glm::mat4 mat_tau;
-
-		// each group is a column
-		mat_tau[0].x = 0;
-		mat_tau[0].y = -tau;
-		mat_tau[0].z = 2*tau;
-		mat_tau[0].w = -tau;
-
-		mat_tau[1].x = 1;
-		mat_tau[1].y = 0;
-		mat_tau[1].z = tau-3;
-		mat_tau[1].w = 2-tau;
-
-		mat_tau[2].x = 0;
-		mat_tau[2].y = tau;
-		mat_tau[2].z = 3-2*tau;
-		mat_tau[2].w = tau-2;
-
-		mat_tau[3].x = 0;
-		mat_tau[3].y = 0;
-		mat_tau[3].z = -tau;
-		mat_tau[3].w = tau;
-
-		mat_tau = glm::transpose(mat_tau);
-
-		// Construct a vector with u
-		glm::vec4 vec_u;
-
-		vec_u[0] = 1;
-		vec_u[1] = u;
-		vec_u[2] = u * u;
-		vec_u[3] = u * u * u;
-
-		// Return the interpolated point
-		return mat_points * mat_tau * vec_u; 
+		// always good practice to set everything back to defaults once configured.
+		glActiveTexture(GL_TEXTURE0);
 	}
 
-	// Here is the class where you will make the vertices or positions of the necessary objects of the track (calling subfunctions)
-	//  For example, to make a basic roller coster:
-	//    First, make the vertices for each rail here (and indices for the EBO if you do it that way).  
-	//        You need the XYZ world coordinates, the Normal Coordinates, and the texture coordinates.
-	//        The normal coordinates are necessary for the lighting to work.  
-	//    Second, make vector of transformations for the planks across the rails
-	void create_track()
+	// render all supports with one instanced draw call,
+	// the shader takes (x, bottom y, z, height) from attribute 3 (see lightingShader_supports.vert)
+	void DrawSupports(Shader shader, unsigned int textureID)
 	{
-		// Create the vertices and indices (optional) for the rails
-		//    One trick in creating these is to move along the spline and 
-		//    shift left and right (from the forward direction of the spline) 
-		//     to find the 3D coordinates of the rails.
-
-		glm::vec3 currentpos = glm::vec3(-2.0f, 0.0f, -2.0f);
-		max_s = 0;
-
-		for (pointVectorIter ptsiter = g_Track.points().begin(); ptsiter != g_Track.points().end(); ptsiter++)
-		{
-			/* get the next point from the iterator */
-			glm::vec3 pt(*ptsiter);
-
-			/* now just the uninteresting code that is no use at all for this project */
-			currentpos += pt;
-
-			// Set the control points apart
-			controlPoints.push_back(currentpos * 2.0f);
-
-			// record the hmax
-			if (currentpos.y * 2.0f > hmax) hmax = currentpos.y * 2.0f;
+		if (support_instances.empty()) return;
 
-			max_s += 1;
-		}
-
-		hmax *= 1.05f;
+		shader.use();
+		glm::mat4 track_model;
+		shader.setMat4("model", track_model);
 
-		// Then traverse the spline with small steps
-		float step_size = 0.03125f;
+		shader.setVec3("material.specular", 0.3f, 0.3f, 0.3f);
+		shader.setFloat("material.shininess", 64.0f);
 
-		Orientation Ori_Pn_1, Ori_Pn;
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, textureID);
 
-		// Initialize Ori_Pn_1 (Initially on s=0)
-		Ori_Pn.origin = get_point(0.0f);
-		Ori_Pn.Front = glm::normalize(get_point(0.0f + step_size) - get_point(0.0f));
-		Ori_Pn.Up = glm::vec3(0.0f, 1.0f, 0.0f);
-		Ori_Pn.Right = glm::normalize(glm::cross(Ori_Pn.Front, Ori_Pn.Up));
+		glBindVertexArray(supportVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, support_indices.size(), GL_UNSIGNED_INT, 0, support_instances.size());
+		glBindVertexArray(0);
 
-		// On first iteration, Pn_1 = Position(s=0), Pn = Position(s=1 * step_size)
-		for (float s = 1 * step_size; s <= max_s; s += step_size)
-		{
-			Ori_Pn_1.origin = Ori_Pn.origin;
-			Ori_Pn_1.Up = Ori_Pn.Up;
-			Ori_Pn_1.Front = Ori_Pn.Front;
-			Ori_Pn_1.Right = Ori_Pn.Right;
-
-			Ori_Pn.origin = get_point(s);
-			Ori_Pn.Front = glm::normalize(get_point(s + step_size) - Ori_Pn.origin);
-			Ori_Pn.Up = glm::normalize(glm::cross(Ori_Pn_1.Right, Ori_Pn.Front));
-			if (s >= max_s - 64 * step_size) {
-				float local_step = (s - (max_s - 64 * step_size)) / (64 * step_size);
-				Ori_Pn.Up += local_step * (glm::vec3(0.0f, 1.0f, 0.0f) - Ori_Pn.Up);
-			}
-			Ori_Pn.Right = glm::normalize(glm::cross(Ori_Pn.Front, Ori_Pn.Up));
-
-			makeRailPart(Ori_Pn_1, Ori_Pn, glm::vec2(0.5f, 0.1f));
-
-			// create plank when s is a multiple of 0.125f.
-			if (fmod(s, 0.125f) <= 0.02f) makePlank(Ori_Pn, glm::vec2(0.5f, 0.1f));
-		}
+		glActiveTexture(GL_TEXTURE0);
 	}
 
-
-	// Given 3 Points, create a triangle and push it into vertices (and EBO if you are using one)
-		// Optional boolean to flip the normal if you need to
-
-	//			A---------------------B
-	//			|					  |
-	//			|					  |
-	//			C---------------------D
-	
-	// By default, All four points has same normal, calculated by AC X AB
-
-	void make_face(glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, bool flipNormal)
+	// place the supports on the ground ground() reports and upload them, again whenever the ground changes
+	void set_supports(const GroundQuery& ground)
 	{
-		glm::vec3 normal = glm::normalize(glm::cross((pointC - pointA), (pointB - pointA)));
-
-		Vertex A, B, C, D;
-		A.Position = pointA; B.Position = pointB; C.Position = pointC; D.Position = pointD;
-		A.Normal = normal; B.Normal = normal; C.Normal = normal; D.Normal = normal;
-		A.TexCoords = glm::vec2(0.0f, 1.0f);
-		B.TexCoords = glm::vec2(1.0f, 1.0f);
-		C.TexCoords = glm::vec2(0.0f, 0.0f);
-		D.TexCoords = glm::vec2(1.0f, 0.0f);
-
-		// Push: up triangle
-		vertices.push_back(A);
-		vertices.push_back(B);
-		vertices.push_back(C);
-
-		// Push: down triangle
-		vertices.push_back(C);
-		vertices.push_back(B);
-		vertices.push_back(D);
+		build_supports(ground);
+		if (supportVAO == 0)
+			setup_supports();
+		update_support_instances();
 	}
 
-	// Given two orintations, create the rail between them.  Offset can be useful if you want to call this for more than for multiple rails
-	//			A-----B						 E-----F
-	//			|	  |      Center of       |	   |
-	//			|	  |		 Ori.origin      |	   |
-	//			C-----D						 G-----H
-
-	// In the figure above, front vector is point into the screen, dimension is shown below:
-	// lengh(AC) = 2*up_offset; lengh(AF)=2*right_offset; lengh(AB) = 2*up_offset
-
-	void makeRailPart(Orientation ori_prev, Orientation ori_cur, glm::vec2 offset)
+	// change the distance between planks, only the instance buffer is rebuilt, the rails stay as they are
+	void set_plank_spacing(float spacing)
 	{
-		// offset[0] = left & right offset, offset[1] = up & down offset
-		glm::vec3 right_offset_1, right_offset_2, up_offset;
-
-		// Get all the points, 4 points for each Ori struct, see above picture for naming rule
-		// 4 points around ori_prev
-		right_offset_1 = ori_prev.Right * offset[0];			   // long horizontal offset, like A to center
-		right_offset_2 = ori_prev.Right * (offset[0] - offset[1]); // short horizontal offset, like B to center
-		up_offset = ori_prev.Up * offset[1];
-
-		glm::vec3 prev_A = ori_prev.origin - right_offset_1 + up_offset;
-		glm::vec3 prev_F = ori_prev.origin + right_offset_1 + up_offset;
-		glm::vec3 prev_C = ori_prev.origin - right_offset_1 - up_offset;
-		glm::vec3 prev_H = ori_prev.origin + right_offset_1 - up_offset;
-
-		glm::vec3 prev_B = ori_prev.origin - right_offset_2 + up_offset;
-		glm::vec3 prev_E = ori_prev.origin + right_offset_2 + up_offset;
-		glm::vec3 prev_D = ori_prev.origin - right_offset_2 - up_offset;
-		glm::vec3 prev_G = ori_prev.origin + right_offset_2 - up_offset;
-
-		// 4 points around ori_cur
-		right_offset_1 = ori_cur.Right * offset[0];
-		right_offset_2 = ori_cur.Right * (offset[0] - offset[1]);
-		up_offset = ori_cur.Up * offset[1];
-
-		glm::vec3 cur_A = ori_cur.origin - right_offset_1 + up_offset;
-		glm::vec3 cur_F = ori_cur.origin + right_offset_1 + up_offset;
-		glm::vec3 cur_C = ori_cur.origin - right_offset_1 - up_offset;
-		glm::vec3 cur_H = ori_cur.origin + right_offset_1 - up_offset;
-
-		glm::vec3 cur_B = ori_cur.origin - right_offset_2 + up_offset;
-		glm::vec3 cur_E = ori_cur.origin + right_offset_2 + up_offset;
-		glm::vec3 cur_D = ori_cur.origin - right_offset_2 - up_offset;
-		glm::vec3 cur_G = ori_cur.origin + right_offset_2 - up_offset;
-
-		// Make faces
-		make_face(prev_B, cur_B, prev_D, cur_D, false); // right face
-		make_face(prev_A, cur_A, prev_B, cur_B, false); // up face
-		make_face(prev_C, cur_C, prev_A, cur_A, false); // left face
-		make_face(prev_D, cur_D, prev_C, cur_C, false); // bottom face
-
-		make_face(prev_F, cur_F, prev_H, cur_H, false); // right face
-		make_face(prev_E, cur_E, prev_F, cur_F, false); // up face
-		make_face(prev_G, cur_G, prev_E, cur_E, false); // left face
-		make_face(prev_H, cur_H, prev_G, cur_G, false); // bottom face
+		plank_spacing = spacing;
+		build_planks();
+		update_plank_instances();
 	}
 
-	// ori_cur is the center of the plank, offset is the size of the rail,
-	// which should be the same as the makerailpart offset
+	void delete_buffers()
+	{
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
 
-	//			A----------------------------E
-	//		   /|                           /|
-	//		  B-|--------------------------F |
-	//        | D                          | H
-	//        |/                           |/
-	//        C----------------------------G
-	//
+		glDeleteVertexArrays(1, &plankVAO);
+		glDeleteBuffers(1, &plankVBO);
+		glDeleteBuffers(1, &plankEBO);
+		glDeleteBuffers(1, &instanceVBO);
 
-	void makePlank(Orientation ori_cur, glm::vec2 offset)
-	{
-		glm::vec3 front_offset, up_offset, right_offset;
-
-		// Calculate the offsets based on the given rail size
-		// offset[0] = left & right offset, offset[1] = up & down offset
-		up_offset = ori_cur.Up * offset[1] * 0.7f;
-		right_offset = ori_cur.Right * offset[0] * 0.9f;
-		front_offset = ori_cur.Front * offset[1] * 0.7f;
-
-		glm::vec3 pA = ori_cur.origin - right_offset + up_offset + front_offset;
-		glm::vec3 pB = ori_cur.origin - right_offset + up_offset - front_offset;
-		glm::vec3 pC = ori_cur.origin - right_offset - up_offset - front_offset;
-		glm::vec3 pD = ori_cur.origin - right_offset - up_offset + front_offset;
-
-		glm::vec3 pE = ori_cur.origin + right_offset + up_offset + front_offset;
-		glm::vec3 pF = ori_cur.origin + right_offset + up_offset - front_offset;
-		glm::vec3 pG = ori_cur.origin + right_offset - up_offset - front_offset;
-		glm::vec3 pH = ori_cur.origin + right_offset - up_offset + front_offset;
-
-		// Make faces
-		make_face(pA, pE, pB, pF, false); // up face
-		make_face(pD, pH, pA, pE, false); // back face
-		make_face(pC, pG, pD, pH, false); // bottom face
-		make_face(pB, pF, pC, pG, false); // front face
+		if (supportVAO != 0)
+		{
+			glDeleteVertexArrays(1, &supportVAO);
+			glDeleteBuffers(1, &supportVBO);
+			glDeleteBuffers(1, &supportEBO);
+			glDeleteBuffers(1, &supportInstanceVBO);
+		}
 	}
 
-	// Find the normal for each triangle uisng the cross product and then add it to all three vertices of the triangle.  
-	//   The normalization of all the triangles happens in the shader which averages all norms of adjacent triangles.   
-	//   Order of the triangles matters here since you want to normal facing out of the object.  
-	void set_normals(Vertex &p1, Vertex &p2, Vertex &p3)
-	{
-		glm::vec3 normal = glm::cross(p2.Position - p1.Position, p3.Position - p1.Position);
-		p1.Normal += normal;
-		p2.Normal += normal;
-		p3.Normal += normal;
-	}
+	
+	private:
+	
+	/*  Render data  */
+	unsigned int VBO, EBO;
+	unsigned int plankVBO, plankEBO, instanceVBO;
+	unsigned int supportVBO, supportEBO, supportInstanceVBO;
+
+	// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, see setup_track()
+	GLenum index_type;
 
 	void setup_track()
 	{
 		// create buffers/arrays
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
 
 		glBindVertexArray(VAO);
 		// load data into vertex buffers
@@ -400,7 +174,22 @@ public:
 		// A great thing about structs is that their memory layout is sequential for all its items.
 		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/3/2 array which
 		// again translates to 3/3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+		// The rails come from vertices and indices, or straight from the mapped compiled file.
+		glBufferData(GL_ARRAY_BUFFER, rail_vertex_count() * sizeof(Vertex), rail_vertex_data(), GL_STATIC_DRAW);
+
+		// shorter tracks fit in 16 bit indices, which halves the index buffer
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		if (short_indices())
+		{
+			std::vector<unsigned short> short_indices(rail_index_data(), rail_index_data() + rail_index_count());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, short_indices.size() * sizeof(unsigned short), &short_indices[0], GL_STATIC_DRAW);
+			index_type = GL_UNSIGNED_SHORT;
+		}
+		else
+		{
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, rail_index_count() * sizeof(unsigned int), rail_index_data(), GL_STATIC_DRAW);
+			index_type = GL_UNSIGNED_INT;
+		}
 
 		// set the vertex attribute pointers
 		// vertex Positions
@@ -416,4 +205,93 @@ public:
 		glBindVertexArray(0);
 	}
 
-};
+	void setup_planks()
+	{
+		glGenVertexArrays(1, &plankVAO);
+		glGenBuffers(1, &plankVBO);
+		glGenBuffers(1, &plankEBO);
+		glGenBuffers(1, &instanceVBO);
+
+		glBindVertexArray(plankVAO);
+		// the single plank mesh
+		glBindBuffer(GL_ARRAY_BUFFER, plankVBO);
+		glBufferData(GL_ARRAY_BUFFER, plank_vertices.size() * sizeof(Vertex), &plank_vertices[0], GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, plankEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, plank_indices.size() * sizeof(unsigned int), &plank_indices[0], GL_STATIC_DRAW);
+
+		// vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		// vertex normal coords
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+		// plank transforms, a mat4 takes 4 attribute slots (one per column) that advance once per instance
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		for (int column = 0; column < 4; column++)
+		{
+			glEnableVertexAttribArray(3 + column);
+			glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + column, 1);
+		}
+
+		glBindVertexArray(0);
+
+		update_plank_instances();
+	}
+
+	void setup_supports()
+	{
+		glGenVertexArrays(1, &supportVAO);
+		glGenBuffers(1, &supportVBO);
+		glGenBuffers(1, &supportEBO);
+		glGenBuffers(1, &supportInstanceVBO);
+
+		glBindVertexArray(supportVAO);
+		// the single pillar mesh
+		glBindBuffer(GL_ARRAY_BUFFER, supportVBO);
+		glBufferData(GL_ARRAY_BUFFER, support_vertices.size() * sizeof(Vertex), &support_vertices[0], GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, supportEBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, support_indices.size() * sizeof(unsigned int), &support_indices[0], GL_STATIC_DRAW);
+
+		// vertex Positions
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		// vertex normal coords
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+		// one vec4 per support that advances once per instance
+		glBindBuffer(GL_ARRAY_BUFFER, supportInstanceVBO);
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void*)0);
+		glVertexAttribDivisor(3, 1);
+
+		glBindVertexArray(0);
+	}
+
+	// upload support_instances, called again whenever the supports are placed again
+	void update_support_instances()
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, supportInstanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, support_instances.size() * sizeof(glm::vec4), support_instances.empty() ? NULL : &support_instances[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// upload plank_transforms, called again whenever the spacing changes
+	void update_plank_instances()
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, plank_transforms.size() * sizeof(glm::mat4), plank_transforms.empty() ? NULL : &plank_transforms[0], GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+};
\ No newline at end of file
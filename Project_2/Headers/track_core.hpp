@@ -0,0 +1,297 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vertex.hpp>
+#include <rc_spline.h>
+#include <mapped_file.hpp>
+
+struct Orientation {
+	// Front
+	glm::vec3 Front;
+	// Up
+	glm::vec3 Up;
+	// Right
+	glm::vec3 Right;
+	// origin
+	glm::vec3 origin;
+};
+
+// everything the spline knows about one s, see TrackCore::evaluate()
+struct SplinePoint {
+	// position on the spline
+	glm::vec3 position;
+	// unit tangent, the direction of travel
+	glm::vec3 tangent;
+	// unit principal normal, towards the centre of the turn (zero on a straight piece)
+	glm::vec3 normal;
+	// 1 / radius of the turn
+	float curvature;
+};
+
+// a stretch of the track check_track() found a problem with
+struct TrackIssue {
+	enum Kind {
+		// the track runs into another part of itself
+		SELF_INTERSECTION,
+		// the track is closer to the ground than check_clearance, or under it
+		TERRAIN_CLEARANCE
+	};
+	Kind kind;
+	// where along the track, in s, s_end is below s_begin if the issue goes over the start of the track
+	float s_begin, s_end;
+	// SELF_INTERSECTION: the part of the track it runs into, in s
+	float other_begin, other_end;
+	// SELF_INTERSECTION: the closest the two parts' centre lines come,
+	// TERRAIN_CLEARANCE: the lowest the bottom of the envelope gets above the ground (negative below it)
+	float distance;
+};
+
+
+// Everything about the track that doesn't need an OpenGL context: loading the control points,
+// evaluating the Catmull-Rom spline, propagating the frames and generating the rail/plank mesh.
+// Track (track.hpp) adds the buffers and the draw call on top of this, the benchmark uses it directly.
+class TrackCore
+{
+public:
+
+	// Control Points Loading Class for loading from File
+	rc_Spline g_Track;
+
+	// Vector of control points
+	std::vector<glm::vec3> controlPoints;
+
+	// cubic coefficients of every segment, P(s) = c0 + c1*u + c2*u^2 + c3*u^3 with u = s - i,
+	// one array per axis indexed [i * 4 + power] so the batch evaluator can gather them
+	std::vector<float> coeff_x, coeff_y, coeff_z;
+
+	// rotation-minimizing frames at every step_size, calculated by create_track()
+	// frames[k] is the frame at s = k * step_size, the last one is back at s = 0 and matches the first
+	std::vector<Orientation> frames;
+
+	// distance along the track of every frame, for frame_at_distance()
+	std::vector<float> frame_distance;
+
+	// Track data (rails only), made by build_mesh(). load_compiled() leaves both empty, the rails stay in
+	// the mapped file and rail_vertex_data() / rail_index_data() point there until release_compiled().
+	std::vector<Vertex> vertices;
+	// indices for EBO
+	std::vector<unsigned int> indices;
+
+	// one plank in its own frame (x = Right, y = Up, z = -Front), drawn once per plank transform
+	std::vector<Vertex> plank_vertices;
+	std::vector<unsigned int> plank_indices;
+
+	// per instance model matrix of every plank, calculated by build_planks()
+	std::vector<glm::mat4> plank_transforms;
+
+	// distance along the track between two planks
+	float plank_spacing = 2.0f;
+
+	// heights of the ground under count world space points (x, z), like HeightmapCore::ground_heights
+	typedef std::function<void(const glm::vec2* points, size_t count, float* heights)> GroundQuery;
+
+	// one support pillar standing on y = 0 and one unit tall, drawn once per support instance
+	std::vector<Vertex> support_vertices;
+	std::vector<unsigned int> support_indices;
+
+	// per instance (x, bottom y, z, height) of every pillar, calculated by build_supports()
+	std::vector<glm::vec4> support_instances;
+
+	// distance along the track between two supports
+	float support_spacing = 3.0f;
+	// no support where the track is closer to the ground than this, or where its Up points
+	// less than support_min_up upwards (loops, steep banks)
+	float support_min_height = 0.3f, support_min_up = 0.5f;
+	// how far a pillar goes below the rails' origin, and into the ground so slopes leave no gap
+	static constexpr float SUPPORT_TOP_OFFSET = 0.1f, SUPPORT_SINK = 0.2f;
+
+	// hmax for camera
+	float hmax = 0.0f;
+
+	// maximun s value, calculated by create_track()
+	int max_s = 0;
+
+	// distance in s between two frames of the rail mesh
+	float step_size = 0.03125f;
+
+	// cumulative arc length sampled at uniform steps of s, calculated by create_track()
+	// arc_length[i] is the distance travelled from s=0 to s=i/ARC_SAMPLES_PER_SEGMENT
+	std::vector<float> arc_length;
+
+	// number of arc length table entries per control point
+	static const int ARC_SAMPLES_PER_SEGMENT = 32;
+
+	// vertices in one cross section of the two rails, see makeRailRing()
+	static const int RAIL_RING_SIZE = 16;
+	// indices of the rails between two rings, 8 quads of 6, see makeRailPart()
+	static const int RAIL_PART_SIZE = 48;
+
+	// check_track(): distance along the track between two samples, radius around the spline that the rails
+	// and the cart take up, and how far above the ground the bottom of that has to stay
+	float check_spacing = 0.25f, check_envelope = 0.6f, check_clearance = 0.5f;
+	// what check_track() found, self intersections first, each kind in order of s
+	std::vector<TrackIssue> issues;
+
+	// threads build_mesh(), build_planks() and check_track() may use, 0 = the whole shared pool plus the caller
+	unsigned int threads = 0;
+
+	// empty track, fill g_Track and call create_track() yourself
+	TrackCore() {}
+
+	// load the compiled track next to the spline (see compiled_path), or if that is
+	// missing or stale, load the spline and generate the mesh
+	TrackCore(const char* trackPath);
+
+	// load the control point offsets of a track file (relative to folder),
+	// false if it is missing or malformed, g_Track.error says where
+	bool load_track(const char* trackPath, std::string folder = "../Project_2/Media/");
+
+	// run all the stages below in order
+	void create_track();
+
+	// compiled track file for a spline: the .sp extension replaced by .spc, in the same folder
+	static std::string compiled_path(const std::string& trackPath);
+
+	// write the spline, tables, frames and mesh from create_track() to a compiled track file,
+	// together with a hash of every .sp file they came from (see track_compiled.cpp)
+	bool save_compiled(const std::string& path, const std::string& folder = "../Project_2/Media/");
+
+	// map a compiled track file and take everything from it instead of running create_track(),
+	// false (and nothing changed) if it is missing, from another version or its .sp files changed.
+	// Both paths are relative to folder, like load_track.
+	bool load_compiled(const std::string& path, const std::string& folder = "../Project_2/Media/");
+
+	// the rails as Track uploads them, from vertices and indices or from the compiled file,
+	// the counts stay right after release_compiled()
+	const Vertex* rail_vertex_data() const { return vertices.empty() ? mapped_vertices : &vertices[0]; }
+	const unsigned int* rail_index_data() const { return indices.empty() ? mapped_indices : &indices[0]; }
+	size_t rail_vertex_count() const { return vertices.empty() ? mapped_vertex_count : vertices.size(); }
+	size_t rail_index_count() const { return indices.empty() ? mapped_index_count : indices.size(); }
+
+	// unmap the compiled file once the rails are uploaded
+	void release_compiled();
+
+	// stage 1: turn the offsets in g_Track into absolute control points, find hmax
+	void build_control_points();
+	// stage 1b: Catmull-Rom coefficients of every segment, needed by get_point and everything after it
+	void build_segment_coefficients();
+	// stage 2: distance <-> s lookup for the ride
+	void build_arc_length_table();
+	// stage 3: the frame table, shared by the rail mesh, the planks and the ride
+	void build_frames();
+	// stage 4: indexed rails between consecutive frames, in parallel
+	void build_mesh();
+	// stage 5: the shared plank mesh and one transform every plank_spacing along the track, in parallel,
+	// can be called again on its own after changing plank_spacing
+	void build_planks();
+
+	// Stage 6, not part of create_track() because it needs the terrain: a pillar from below the rails down to
+	// the ground every support_spacing along the track. The frames are looked up in parallel and the ground
+	// under all of them is asked for in one batch. Can be called again after changing the spacing or the ground.
+	void build_supports(const GroundQuery& ground);
+
+	// Validation, not part of create_track(): sample the track every check_spacing and find where the envelopes
+	// of two parts of the track overlap, and where the envelope comes closer to the ground than check_clearance
+	// (left out if ground is empty). The samples are bucketed into a uniform spatial hash, so every sample is only
+	// compared with the ones in the 27 cells around it, in parallel. Parts of the track closer than 4 envelopes
+	// along it are neighbours, not a crossing. Fills issues and returns how many there are (track_check.cpp).
+	size_t check_track(const GroundQuery& ground = GroundQuery());
+
+	// position on the spline at s, see track_core.cpp
+	glm::vec3 get_point(float s);
+
+	// same as get_point, but returns the derivative dP/ds instead of the position
+	glm::vec3 get_derivative(float s);
+
+	// second derivative d^2P/ds^2
+	glm::vec3 get_second_derivative(float s);
+
+	// unit tangent at s, the exact direction of travel
+	glm::vec3 get_tangent(float s);
+
+	// curvature at s, 1 / radius of the turn
+	float get_curvature(float s);
+
+	// position, tangent, normal and curvature from a single segment lookup
+	SplinePoint evaluate(float s);
+
+	// get_point for count values of s at once, the positions are written to three separate arrays
+	// uses AVX2 or SSE2 when the compiler targets them, plain loops otherwise
+	void get_points(const float* s, int count, float* out_x, float* out_y, float* out_z);
+
+	// get_point through the tau matrix, kept as the reference for the coefficient and batch paths
+	glm::vec3 get_point_reference(float s);
+
+	// total length of one loop of the track
+	float track_length();
+
+	// true when every index fits in 16 bits, the index buffer is uploaded as unsigned short then
+	bool short_indices() { return rail_vertex_count() <= 65536; }
+
+	// size of the vertex and index buffers as uploaded to the GPU, plank and support meshes and instances included
+	size_t mesh_bytes()
+	{
+		return rail_vertex_count() * sizeof(Vertex) + rail_index_count() * (short_indices() ? 2 : 4)
+			+ plank_vertices.size() * sizeof(Vertex) + plank_indices.size() * sizeof(unsigned int)
+			+ plank_transforms.size() * sizeof(glm::mat4)
+			+ support_vertices.size() * sizeof(Vertex) + support_indices.size() * sizeof(unsigned int)
+			+ support_instances.size() * sizeof(glm::vec4);
+	}
+
+	// distance along the track from s=0 to the given s
+	float distance_at(float s);
+
+	// inverse of distance_at: find the s that is the given distance away from s=0
+	float s_at_distance(float distance);
+
+	// orientation at any s, interpolated between the two closest frames
+	Orientation frame_at(float s);
+
+	// orientation at any distance along the track, interpolated between the two closest frames,
+	// origin included, so it is two table reads and no spline evaluation
+	Orientation frame_at_distance(float distance);
+
+protected:
+
+	// the compiled file load_compiled() took the track from, kept mapped for the rails until release_compiled()
+	MappedFile compiled;
+	const Vertex* mapped_vertices = NULL;
+	const unsigned int* mapped_indices = NULL;
+	size_t mapped_vertex_count = 0, mapped_index_count = 0;
+
+	// things placed every spacing along a track total long, the first at spacing and none at the start again
+	static size_t spacing_count(float total, float spacing);
+
+	// map any s into [0, max_s)
+	float wrap_s(float s);
+
+	// segment that s falls in and the u within it
+	int segment_of(float s, float &u);
+
+	// frames[k] and frames[k + 1] mixed by t, the axes orthonormalized again
+	Orientation blend_frames(int k, float t);
+
+	// length of the spline between s0 and s1 (within the same table step)
+	float integrate_length(float s0, float s1);
+
+	// matrix that turns [1, u, u^2, u^3] into the weights of the 4 control points
+	glm::mat4 catmull_rom_matrix(float tau);
+
+	// Catmull-Rom position and derivative for one segment, u in range of [0,1]
+	glm::vec3 interpolate(glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, float tau, float u);
+	glm::vec3 interpolate_derivative(glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, float tau, float u);
+
+	// mesh helpers, see the pictures in track_core.cpp
+	void make_face(std::vector<Vertex> &out_vertices, std::vector<unsigned int> &out_indices, glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, bool flipNormal);
+	void makeRailRing(Orientation ori, glm::vec2 offset, float u, Vertex* out);
+	void makeRailPart(unsigned int prev_ring, unsigned int cur_ring, unsigned int* out);
+	void makePlank(glm::vec2 offset);
+	void makePillar(float radius);
+
+	void set_normals(Vertex &p1, Vertex &p2, Vertex &p3);
+};
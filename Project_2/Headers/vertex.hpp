@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Vertex layout shared by the heightmap and the track.
+// Kept apart from heightmap.hpp so code that only builds meshes doesn't pull in OpenGL.
+struct Vertex {
+	// position
+	glm::vec3 Position;
+	// position
+	glm::vec3 Normal;
+	// texCoords
+	glm::vec2 TexCoords;
+};
+
+// Vertex layout of the models Assimp loads (mesh.hpp), with the tangent space for normal mapping.
+struct VertexModel {
+	// position
+	glm::vec3 Position;
+	// normal
+	glm::vec3 Normal;
+	// texCoords
+	glm::vec2 TexCoords;
+	// tangent
+	glm::vec3 Tangent;
+	// bitangent
+	glm::vec3 Bitangent;
+};
+
+// VertexModel in 24 bytes instead of 56 (ModelCore::pack_vertex). The normal and the tangent are 10:10:10:2
+// signed normalized (GL_INT_2_10_10_10_REV), the tangent's w is the sign of the bitangent, which
+// lightingShader_nMap.vert works out as cross(N, T) * w. The texture coordinates are half floats.
+struct VertexPacked {
+	// position
+	glm::vec3 Position;
+	// normal, w unused
+	uint32_t Normal;
+	// tangent, w = handedness
+	uint32_t Tangent;
+	// texCoords
+	uint16_t TexCoords[2];
+};
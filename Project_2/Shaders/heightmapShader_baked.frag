@@ -0,0 +1,89 @@
+#version 330 core
+out vec4 FragColor;
+
+// lightingShader_basic.frag for the heightmap with the static lights baked by TerrainBake:
+// the sun with the terrain's shadows, ambient occlusion and the point lights come from one
+// texture fetch, only the flashlight that follows the camera is worked out here, with the
+// normal from the heightmap's normal map like heightmapShader.frag.
+// Specular highlights of the baked lights are left out, they depend on where the camera is.
+
+struct Material {
+    sampler2D diffuse;
+    vec3 specular;
+    float shininess;
+};
+
+struct Light {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+
+    float constant;
+    float linear;
+    float quadratic;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+uniform vec3 viewPos;
+uniform Light spotLight;
+uniform Material material;
+
+// one texel per pixel of the heightmap: the light reaching the ground (rgb) and the open sky (a)
+uniform sampler2D lightmap;
+// one texel per pixel of the heightmap: x and z of the model space normal in [0, 1]
+uniform sampler2D normalMap;
+// transpose(inverse(model)), the vertex shaders work it out per vertex
+uniform mat3 normalMatrix;
+
+vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir);
+
+void main()
+{
+    vec3 viewDir = normalize(viewPos - FragPos);
+
+    // TexCoords are (row, column) / (size - 1), the texels sit at their centres. Both maps have the image's size
+    vec2 size = vec2(textureSize(lightmap, 0));
+    vec2 uv = (TexCoords.yx * (size - 1.0) + 0.5) / size;
+
+    vec2 xz = texture(normalMap, uv).rg * 2.0 - 1.0;
+    vec3 norm = normalize(normalMatrix * vec3(xz.x, sqrt(max(1.0 - dot(xz, xz), 0.0)), xz.y));
+
+    vec3 result = texture(lightmap, uv).rgb * vec3(texture(material.diffuse, TexCoords));
+    result += CalcSpotLight(spotLight, norm, FragPos, viewDir);
+
+    FragColor = vec4(result, 1.0);
+}
+
+// calculates the color when using a spot light.
+vec3 CalcSpotLight(Light light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    // diffuse shading
+    float diff = max(dot(normal, lightDir), 0.0);
+    // specular shading
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0),  material.shininess);
+    // attenuation
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    // spotlight intensity
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    // combine results
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+    vec3 specular = light.specular * spec * material.specular;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
@@ -0,0 +1,54 @@
+#version 330 core
+// one flat patch of the heightmap grid, drawn once per patch and lifted by the height texture
+layout (location = 0) in uvec2 aCell;     // (row, column) inside the patch
+layout (location = 3) in int aPatch;      // per instance: which patch, row by row
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// the first channel of the image, texel (column, row), not filtered
+uniform sampler2D heights;
+// pixels per row and rows, half the size of the grid along x and z (HeightmapCore::extent_x, extent_z)
+uniform ivec2 gridSize;
+uniform vec2 extent;
+uniform int patchSize;
+uniform int patchColumns;
+
+float height(int row, int column)
+{
+    return texelFetch(heights, ivec2(column, row), 0).r;
+}
+
+void main()
+{
+    // the part of a patch that sticks out of the grid folds onto its edge
+    int row = min(aPatch / patchColumns * patchSize + int(aCell.x), gridSize.y - 1);
+    int column = min(aPatch % patchColumns * patchSize + int(aCell.y), gridSize.x - 1);
+
+    vec3 position = vec3((2.0 * (float(row) / float(gridSize.y - 1)) - 1.0) * extent.x, height(row, column),
+        (2.0 * (float(column) / float(gridSize.x - 1)) - 1.0) * extent.y);
+
+    // Sobel weighted central differences like HeightmapCore::normal_at, one sided on the border
+    int up = min(row + 1, gridSize.y - 1), down = max(row - 1, 0);
+    int right = min(column + 1, gridSize.x - 1), left = max(column - 1, 0);
+    float step_x = 2.0 * extent.x / float(gridSize.y - 1);
+    float step_z = 2.0 * extent.y / float(gridSize.x - 1);
+
+    float rise_x = (height(up, left) + 2.0 * height(up, column) + height(up, right))
+        - (height(down, left) + 2.0 * height(down, column) + height(down, right));
+    float rise_z = (height(down, right) + 2.0 * height(row, right) + height(up, right))
+        - (height(down, left) + 2.0 * height(row, left) + height(up, left));
+    float slope_x = rise_x / (4.0 * float(up - down) * step_x);
+    float slope_z = rise_z / (4.0 * float(right - left) * step_z);
+
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(model))) * normalize(vec3(-slope_x, 1.0, -slope_z));
+    TexCoords = vec2(float(row) / float(gridSize.y - 1), float(column) / float(gridSize.x - 1));
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per instance transform, takes locations 3 to 6 (one per column)
+layout (location = 3) in mat4 aInstanceModel;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    FragPos = vec3(model * aInstanceModel * vec4(aPos, 1.0));
+    // the instance transforms are rotations plus a translation, only model needs the inverse transpose
+    Normal = mat3(transpose(inverse(model))) * mat3(aInstanceModel) * normalize(aNormal);
+    TexCoords = aTexCoords;
+    
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -2,8 +2,8 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
+// w is the sign of the bitangent, 1 when the mesh has plain vec3 tangents
+layout (location = 3) in vec4 aTangent;
 
 out VS_OUT {
     vec3 FragPos;
@@ -26,12 +26,12 @@ void main()
     vs_out.FragPos = vec3(model * vec4(aPos, 1.0));   
     vs_out.TexCoords = aTexCoords;
     
-    vec3 T = normalize(vec3(model * vec4(aTangent, 0.0)));
+    vec3 T = normalize(vec3(model * vec4(aTangent.xyz, 0.0)));
     vec3 N = normalize(vec3(model * vec4(aNormal, 0.0)));
     // re-orthogonalize T with respect to N
     T = normalize(T - dot(T, N) * N);
-    // then retrieve perpendicular vector B with the cross product of T and N
-    vec3 B = cross(N, T);
+    // then retrieve perpendicular vector B with the cross product of T and N, flipped for mirrored texture coordinates
+    vec3 B = cross(N, T) * (aTangent.w < 0.0 ? -1.0 : 1.0);
     
     vs_out.TBN = transpose(mat3(T, B, N));
    
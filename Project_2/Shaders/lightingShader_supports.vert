@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+// per instance: x, bottom y, z and height of the support, see TrackCore::build_supports
+layout (location = 3) in vec4 aSupport;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    // the pillar is one unit tall, stretched to the support; its sides face sideways so the normals stay
+    vec3 position = vec3(aSupport.x + aPos.x, aSupport.y + aPos.y * aSupport.w, aSupport.z + aPos.z);
+    FragPos = vec3(model * vec4(position, 1.0));
+    Normal = mat3(transpose(inverse(model))) * aNormal;
+    // the texture repeats along the pillar instead of stretching with it
+    TexCoords = vec2(aTexCoords.x, aTexCoords.y * aSupport.w);
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
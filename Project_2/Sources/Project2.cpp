@@ -22,6 +22,7 @@ std::string preamble =
 "Pressing B will toggle reflections for the box textures\n "
 "Pressing H will toggle heightmap\n "
 "Pressing N will toggle Normals\n "
+"Pressing [ and ] will decrease and increase the plank spacing\n "
 "Pressing P will print information\n\n";
 
 int main()
@@ -78,6 +79,12 @@ int main()
 	Shader lightingShader_specular("../Project_2/Shaders/lightingShader_specular.vert", "../Project_2/Shaders/lightingShader_specular.frag");
 	Shader normalShader("../Project_2/Shaders/normal.vert", "../Project_2/Shaders/normal.frag", "../Project_2/Shaders/normal.geom");
 	Shader lightingShader_nMap("../Project_2/Shaders/lightingShader_nMap.vert", "../Project_2/Shaders/lightingShader_nMap.frag");
+	Shader lightingShader_instanced("../Project_2/Shaders/lightingShader_instanced.vert", "../Project_2/Shaders/lightingShader_basic.frag");
+	Shader heightmapShader_mesh("../Project_2/Shaders/lightingShader_basic.vert", "../Project_2/Shaders/heightmapShader.frag");
+	Shader heightmapShader_displaced("../Project_2/Shaders/heightmapShader_displaced.vert", "../Project_2/Shaders/heightmapShader.frag");
+	Shader lightingShader_supports("../Project_2/Shaders/lightingShader_supports.vert", "../Project_2/Shaders/lightingShader_basic.frag");
+	Shader heightmapShader_baked("../Project_2/Shaders/lightingShader_basic.vert", "../Project_2/Shaders/heightmapShader_baked.frag");
+	Shader heightmapShader_displacedBaked("../Project_2/Shaders/heightmapShader_displaced.vert", "../Project_2/Shaders/heightmapShader_baked.frag");
 
 	// set up vertex data (and buffer(s)) and configure vertex attributes
 	// ------------------------------------------------------------------
@@ -157,6 +164,9 @@ int main()
 
 	// load textures
 	// -------------
+	// only asked for here, the images are decoded while the models, heightmap and track load, and the textures
+	// are filled in as they come back
+	TextureLoader textures(parallelTextureDecode);
 
 	std::vector<std::string> faces =
 	{
@@ -167,16 +177,61 @@ int main()
 		"../Project_2/Media/skybox/back.jpg",
 		"../Project_2/Media/skybox/front.jpg"
 	};
-	unsigned int cubemapTexture = loadCubemap(faces);
+	unsigned int cubemapTexture = textures.acquire_cubemap(faces);
 
-	// init heatmap
-	Heightmap heightmap("../Project_2/Media/heightmaps/hflab4.jpg");
-	unsigned int heightmap_texture = loadTexture("../Project_2/Media/skybox_old/bottom.jpg");
-	unsigned int diffuseMap = loadTexture("../Project_2/Media/textures/container2.png");
-	unsigned int specularMap = loadTexture("../Project_2/Media/textures/container2_specular.png");
+	unsigned int heightmap_texture = textures.acquire_2d("../Project_2/Media/skybox_old/bottom.jpg");
+	unsigned int diffuseMap = textures.acquire_2d("../Project_2/Media/textures/container2.png");
+	unsigned int specularMap = textures.acquire_2d("../Project_2/Media/textures/container2_specular.png");
+
+	// load models
+	// -----------
+	// before the heightmap and the track so their textures decode while those are built
+	ModelCore::VertexLayout modelLayout = packModelVertices ? ModelCore::LAYOUT_PACKED : ModelCore::LAYOUT_FLOAT;
+	Model ourModel("../Project_2/Media/nanosuit/nanosuit.obj", &textures, false, modelLayout);
+	Model cart("../Project_2/Media/shell_car/bowsershell.obj", &textures, false, modelLayout);
+
+	// init heatmap, drawn as triangle strips (about 0.4x the indices of a triangle list and half the vertex shader runs)
+	std::string heightmapPath = "../Project_2/Media/heightmaps/hflab4.jpg";
+	Heightmap heightmap(heightmapPath.c_str(), Heightmap::TOPOLOGY_STRIPS,
+		displaceHeightmap ? Heightmap::MODE_DISPLACED : Heightmap::MODE_MESH);
+
+	// a survey too big for one heightmap is streamed in tiles around the camera instead, if there is one
+	TerrainTiles terrain;
+	bool streamTerrain = terrain.open("../Project_2/Media/terrain/terrain.tiles");
+
+	// whatever is decoded by now goes up while the track loads
+	textures.upload_ready();
 
 	Track track("spline/custom_track.sp");
-	init_Front = glm::normalize(track.get_point(0.0f + 0.03125f) - track.get_point(0.0f));
+
+	// pillars from under the track down to the heightmap, the ground under all of them asked for in one batch
+	if (!streamTerrain)
+	{
+		track.set_supports([&heightmap](const glm::vec2* points, size_t count, float* heights)
+		{
+			heightmap.ground_heights(points, count, heights);
+		});
+	}
+
+	// where the track runs into itself or too close to the ground, printed once so the track file can be fixed
+	{
+		TrackCore::GroundQuery ground;
+		if (!streamTerrain)
+			ground = [&heightmap](const glm::vec2* points, size_t count, float* heights)
+			{
+				heightmap.ground_heights(points, count, heights);
+			};
+		track.check_track(ground);
+		for (size_t i = 0; i < track.issues.size(); i++)
+		{
+			const TrackIssue& issue = track.issues[i];
+			if (issue.kind == TrackIssue::SELF_INTERSECTION)
+				std::printf("Track runs into itself: s %.2f - %.2f and %.2f - %.2f, %.2f apart\n", issue.s_begin, issue.s_end,
+					issue.other_begin, issue.other_end, issue.distance);
+			else
+				std::printf("Track too close to the ground: s %.2f - %.2f, %.2f above it\n", issue.s_begin, issue.s_end, issue.distance);
+		}
+	}
 
 	// positions of the point lights
 	glm::vec3 pointLightPositions[] = {
@@ -186,10 +241,19 @@ int main()
 		glm::vec3(0.0f,  0.0f, -3.0f)
 	};
 
-	// load models
-	// -----------
-	Model ourModel("../Project_2/Media/nanosuit/nanosuit.obj");
-	Model cart("../Project_2/Media/shell_car/bowsershell.obj");
+	// the lights that don't move, baked into the heightmap once and kept in hflab4.bake until they or the heights change
+	if (bakeHeightmapLight)
+	{
+		TerrainBake bake;
+		for (int i = 0; i < 4; i++)
+			bake.lights.point_position[i] = pointLightPositions[i];
+		bake.bake_cached(heightmap, TerrainBake::cache_path(heightmapPath));
+		if (bake.from_cache)
+			std::printf("Heightmap lighting loaded in %.1f ms\n", bake.load_ms);
+		else
+			std::printf("Heightmap lighting baked in %.1f ms\n", bake.bake_ms);
+		heightmap.set_lightmap(bake);
+	}
 
 	// shader configuration
 	// --------------------
@@ -202,6 +266,21 @@ int main()
 	lightingShader_basic.use();
 	lightingShader_basic.setInt("material.diffuse", 0);
 
+	lightingShader_instanced.use();
+	lightingShader_instanced.setInt("material.diffuse", 0);
+
+	lightingShader_supports.use();
+	lightingShader_supports.setInt("material.diffuse", 0);
+
+	heightmapShader_mesh.use();
+	heightmapShader_mesh.setInt("material.diffuse", 0);
+
+	heightmapShader_baked.use();
+	heightmapShader_baked.setInt("material.diffuse", 0);
+
+	heightmapShader_displacedBaked.use();
+	heightmapShader_displacedBaked.setInt("material.diffuse", 0);
+
 	lightingShader_specular.use();
 	lightingShader_specular.setInt("material.diffuse", 0);
 	lightingShader_specular.setInt("material.specular", 1);
@@ -211,6 +290,17 @@ int main()
 	lightingShader_nMap.setInt("material.specular", 1);
 	lightingShader_nMap.setInt("material.normal", 2);
 
+	// the rest of the textures, the first frame needs all of them
+	textures.finish();
+	std::printf("Textures: %zu images, %.1f MB with mipmaps, %.1f ms of decoding and %.1f ms of mipmaps on %u threads, "
+		"waited %.1f ms for them and %.1f ms to upload them\n", textures.image_count, textures.image_bytes / (1024.0 * 1024.0),
+		textures.decode_ms, textures.mipmap_ms, parallelTextureDecode ? TextureLoader::decode_threads() : 1u,
+		textures.wait_ms, textures.upload_ms);
+	TextureRegistry& registry = TextureRegistry::shared();
+	std::printf("Texture registry: %zu textures in %.1f MB, %zu of %zu requests found theirs already loaded\n",
+		registry.texture_count(), registry.total_bytes() / (1024.0 * 1024.0), registry.hits, registry.lookups);
+	bool firstFrame = true;
+
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
@@ -230,6 +320,18 @@ int main()
 		// Camera Movement
 		camera.ProcessTrackMovement(deltaTime, track);
 
+		// off the track the camera doesn't go below the heightmap
+		if (!camera.onTrack && drawHeightmap && !streamTerrain)
+		{
+			float ground = heightmap.ground_height(glm::vec2(camera.Position.x, camera.Position.z)) + 0.5f;
+			if (camera.Position.y < ground)
+				camera.Position.y = ground;
+		}
+
+		// only the plank instances are rebuilt, not the rails
+		if (plank_spacing != track.plank_spacing)
+			track.set_plank_spacing(plank_spacing);
+
 		// render
 		// ------
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -263,9 +365,39 @@ int main()
 		lightingShader_nMap.setMat4("view", view);
 		lightingShader_nMap.setMat4("projection", projection);
 
+		lightingShader_instanced.use();
+		lightingShader_instanced.setMat4("view", view);
+		lightingShader_instanced.setMat4("projection", projection);
+
+		lightingShader_supports.use();
+		lightingShader_supports.setMat4("view", view);
+		lightingShader_supports.setMat4("projection", projection);
+
+		heightmapShader_mesh.use();
+		heightmapShader_mesh.setMat4("view", view);
+		heightmapShader_mesh.setMat4("projection", projection);
+
+		heightmapShader_displaced.use();
+		heightmapShader_displaced.setMat4("view", view);
+		heightmapShader_displaced.setMat4("projection", projection);
+
+		heightmapShader_baked.use();
+		heightmapShader_baked.setMat4("view", view);
+		heightmapShader_baked.setMat4("projection", projection);
+
+		heightmapShader_displacedBaked.use();
+		heightmapShader_displacedBaked.setMat4("view", view);
+		heightmapShader_displacedBaked.setMat4("projection", projection);
+
 		set_lighting(lightingShader_basic, pointLightPositions);
+		set_lighting(lightingShader_instanced, pointLightPositions);
+		set_lighting(lightingShader_supports, pointLightPositions);
 		set_lighting(lightingShader_specular, pointLightPositions);
 		set_lighting(lightingShader_nMap, pointLightPositions);
+		set_lighting(heightmapShader_mesh, pointLightPositions);
+		set_lighting(heightmapShader_displaced, pointLightPositions);
+		set_lighting(heightmapShader_baked, pointLightPositions);
+		set_lighting(heightmapShader_displacedBaked, pointLightPositions);
 		
 
 
@@ -353,14 +485,28 @@ int main()
 
 		glBindVertexArray(0);
 
-		// Draw the heightmap
-		if (drawHeightmap)
+		// Draw the heightmap, only the chunks in view and each at the detail it needs from here
+		heightmap.update_lod(view, projection, (float)SCR_HEIGHT);
+		if (streamTerrain)
 		{
-			heightmap.Draw(lightingShader_basic, heightmap_texture);
+			terrain.update(camera.Position);
+			if (drawHeightmap)
+				terrain.Draw(lightingShader_basic, heightmap_texture);
+		}
+		else if (drawHeightmap)
+		{
+			// with baked lighting the static lights are one texture fetch
+			Shader& heightmapShader = heightmap.mode == Heightmap::MODE_DISPLACED
+				? (heightmap.has_lightmap() ? heightmapShader_displacedBaked : heightmapShader_displaced)
+				: (heightmap.has_lightmap() ? heightmapShader_baked : heightmapShader_mesh);
+			heightmap.Draw(heightmapShader, heightmap_texture);
 		}
 
 		// Draw the track
 		track.Draw(lightingShader_basic, diffuseMap);
+		track.DrawPlanks(lightingShader_instanced, diffuseMap);
+		if (drawHeightmap)
+			track.DrawSupports(lightingShader_supports, diffuseMap);
 
 
 		// Loading model of the crysis character.  Provided so you can create better scenes.
@@ -424,6 +570,14 @@ int main()
 							  // -------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		// time since glfwInit(), to compare parallelTextureDecode on and off
+		if (firstFrame)
+		{
+			std::printf("First frame after %.0f ms, textures decoded %s\n", glfwGetTime() * 1000.0,
+				parallelTextureDecode ? "in parallel" : "one after another");
+			firstFrame = false;
+		}
 	}
 
 	// optional: de-allocate all resources once they've outlived their purpose:
@@ -433,6 +587,13 @@ int main()
 	glDeleteBuffers(1, &VBO);
 	glDeleteBuffers(1, &skyboxVAO);
 	heightmap.delete_buffers();
+	terrain.delete_buffers();
+	ourModel.delete_buffers();
+	cart.delete_buffers();
+	registry.release(cubemapTexture);
+	registry.release(heightmap_texture);
+	registry.release(diffuseMap);
+	registry.release(specularMap);
 
 	glfwTerminate();
 
@@ -478,7 +639,9 @@ void processInput(GLFWwindow *window)
 		glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS ||
 		glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS ||
 		glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS ||
-		glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS;
+		glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS ||
+		glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS ||
+		glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS;
 	if (somethingPressed && last_pressed < currentFrame - 0.5f || last_pressed == 0.0f)
 	{
 		if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS)
@@ -487,6 +650,11 @@ void processInput(GLFWwindow *window)
 			drawBoxes ? drawBoxes = false : drawBoxes = true;
 		if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS)
 			drawNormals ? drawNormals = false : drawNormals = true;
+		// plank spacing, picked up by the render loop
+		if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS && plank_spacing > 0.5f)
+			plank_spacing -= 0.5f;
+		if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS)
+			plank_spacing += 0.5f;
 		if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
 			if (camera.onTrack)
 			{
@@ -505,11 +673,7 @@ void processInput(GLFWwindow *window)
 				camera.onTrack = true;
 
 				if (virgin) {
-					camera.s = 0.0f;
-
-					camera.bg_Front = init_Front;
-					camera.bg_Up = glm::vec3(0.0f, 1.0f, 0.0f);
-					camera.bg_Right = glm::normalize(glm::cross(camera.bg_Front, camera.bg_Up));
+					camera.distance = 0.0f;
 					
 					virgin = false;
 				}
@@ -562,7 +726,7 @@ void processInput(GLFWwindow *window)
 			std::printf("Scale (%.05f,%.05f,%.05f)\n", scale.x, scale.y, scale.z);
 			std::printf("Front (%.05f,%.05f,%.05f)\n", camera.Front.x, camera.Front.y, camera.Front.z);
 			std::printf("Front (%.05f,%.05f,%.05f)\n", camera.Position.x, camera.Position.y, camera.Position.z);
-			std::printf("current s value %.05f\n", camera.s);
+			std::printf("current distance %.05f\n", camera.distance);
 			quaterians ? std::printf("Using Quaterians\n") : std::printf("Not Using Quaterians\n");
 			std::printf("\n");
 			
@@ -653,84 +817,6 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 	camera.ProcessMouseScroll(yoffset);
 }
 
-// utility function for loading a 2D texture from file
-// ---------------------------------------------------
-unsigned int loadTexture(char const * path)
-{
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else
-	{
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
-}
-
-// loads a cubemap texture from 6 individual texture faces
-// order:
-// +X (right)
-// -X (left)
-// +Y (top)
-// -Y (bottom)
-// +Z (front) 
-// -Z (back)
-// -------------------------------------------------------
-unsigned int loadCubemap(std::vector<std::string> faces)
-{
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-	int width, height, nrComponents;
-	for (unsigned int i = 0; i < faces.size(); i++)
-	{
-		unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrComponents, 0);
-		if (data)
-		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
-		}
-	}
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-	return textureID;
-}
-
 void set_lighting(Shader shader, glm::vec3 * pointLightPositions)
 {
 	shader.use();
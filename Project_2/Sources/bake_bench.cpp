@@ -0,0 +1,230 @@
+/*** @file bake_bench.cpp
+*
+*   @brief Headless benchmark for the baked heightmap lighting (TerrainBake)
+*
+*   Bakes generated heightmaps (the shipped 200x200 size, 1k and 2k by default) on one
+*   thread and on the whole shared pool, and times writing the bake file and loading it
+*   back, which is what the viewer does on every start after the first.
+*
+*   Checks that every thread count gives the same bytes, that a flat heightmap is lit
+*   exactly like lightingShader_basic.frag lights it (no occlusion, no shadow), that a wall
+*   casts its shadow away from the sun and darkens the sky next to it, that MODE_DISPLACED
+*   bakes the same as the mesh, and that the bake file is only used for the same heights
+*   and lights. The exit code is 1 if any check fails.
+*
+*   usage: bake_bench [image sizes ...]
+*   e.g.   bake_bench 512 4096
+**/
+
+#include <terrain_bake.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// rolling hills with some steeper detail, the same as heightmap_bench's, quantized to 8 bits
+static std::vector<unsigned char> generate_image(int width, int height)
+{
+	std::vector<unsigned char> pixels((size_t)width * height);
+	for (int row = 0; row < height; row++)
+	{
+		for (int column = 0; column < width; column++)
+		{
+			float x = float(row) / float(height), z = float(column) / float(width);
+			float h = 0.5f + 0.25f * sin(6.0f * x + 1.0f) * cos(5.0f * z) + 0.15f * sin(17.0f * (x + z))
+				+ 0.05f * sin(61.0f * x) * sin(53.0f * z);
+			pixels[(size_t)row * width + column] = (unsigned char)std::min(255.0f, std::max(0.0f, h * 255.0f + 0.5f));
+		}
+	}
+	return pixels;
+}
+
+// only the sun, so the expected light is easy to work out
+static TerrainBake::Lights sun_only()
+{
+	TerrainBake::Lights lights;
+	for (int i = 0; i < 4; i++)
+		lights.point_ambient[i] = lights.point_diffuse[i] = glm::vec3(0.0f);
+	return lights;
+}
+
+// channel of texel (row, column)
+static int texel(const TerrainBake& bake, int row, int column, int channel)
+{
+	return bake.texels[((size_t)row * bake.width + column) * 4 + channel];
+}
+
+static bool report(const char* name, bool ok)
+{
+	std::printf("%-40s %s\n", name, ok ? "ok" : "WRONG");
+	return ok;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++)
+		sizes.push_back(atoi(argv[i]));
+	if (sizes.empty())
+	{
+		sizes.push_back(200);
+		sizes.push_back(1024);
+		sizes.push_back(2048);
+	}
+
+	std::string root = (std::filesystem::temp_directory_path() / "bake_bench").string() + "/";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+
+	bool passed = true;
+	unsigned int pool = ThreadPool::shared().size() + 1;
+
+	std::printf("%-10s %10s %10s %10s %9s %10s %8s %9s %9s %9s %9s\n", "heightmap", "pixels", "1 thread ms",
+		"pool ms", "speedup", "Mpixels/s", "sky", "save ms", "load ms", "file MB", "same");
+	for (size_t i = 0; i < sizes.size(); i++)
+	{
+		int size = sizes[i];
+		std::vector<unsigned char> pixels = generate_image(size, size);
+		HeightmapCore map;
+		map.create_heightmap(&pixels[0], size, size, 1);
+
+		TerrainBake single;
+		single.threads = 1;
+		single.bake(map);
+
+		TerrainBake bake;
+		bake.bake(map);
+		bool same = bake.texels == single.texels;
+
+		// mean open sky
+		double sky = 0.0;
+		for (size_t p = 0; p < (size_t)size * size; p++)
+			sky += bake.texels[p * 4 + 3] / 255.0;
+		sky /= (double)size * size;
+
+		std::string path = root + "bench.bake";
+		double t0 = now_ms();
+		bool saved = bake.save(path, map);
+		double save_ms = now_ms() - t0;
+
+		TerrainBake loaded;
+		bool ok = saved && loaded.load(path, map) && loaded.texels == bake.texels;
+
+		char name[32];
+		snprintf(name, sizeof(name), "%dx%d", size, size);
+		std::printf("%-10s %10zu %10.1f %10.1f %9.2f %10.2f %8.3f %9.1f %9.1f %9.1f %9s\n", name, (size_t)size * size,
+			single.bake_ms, bake.bake_ms, single.bake_ms / bake.bake_ms, size * (double)size / (bake.bake_ms * 1000.0), sky,
+			save_ms, loaded.load_ms, bake.texels.size() / (1024.0 * 1024.0), same && ok ? "yes" : "NO");
+		passed = passed && same && ok;
+	}
+	std::printf("(%u threads, the texels are RGBA8: static light and open sky)\n\n", pool);
+
+	// flat ground: the whole sky, the sun everywhere, and exactly CalcDirLight's ambient + diffuse
+	{
+		std::vector<unsigned char> pixels(64 * 64, 100);
+		HeightmapCore map;
+		map.create_heightmap(&pixels[0], 64, 64, 1);
+		TerrainBake bake;
+		bake.lights = sun_only();
+		bake.bake(map);
+
+		glm::vec3 to_sun = glm::normalize(-bake.lights.direction);
+		int expected = (int)((0.05f + 0.5f * to_sun.y) * 255.0f + 0.5f);
+		bool ok = true;
+		for (int r = 0; r < 64; r++)
+			for (int c = 0; c < 64; c++)
+				ok = ok && texel(bake, r, c, 0) == expected && texel(bake, r, c, 3) == 255;
+		passed = report("flat ground lit like the shader", ok) && passed;
+	}
+
+	// a wall across the rows: the sun comes from lower columns, so the shadow falls on the higher ones
+	{
+		std::vector<unsigned char> pixels(200 * 200, 0);
+		for (int r = 0; r < 200; r++)
+			for (int c = 100; c < 104; c++)
+				pixels[r * 200 + c] = 255;
+		HeightmapCore map;
+		map.create_heightmap(&pixels[0], 200, 200, 1);
+		TerrainBake bake;
+		bake.lights = sun_only();
+		bake.bake(map);
+
+		int ambient = (int)(0.05f * 255.0f + 0.5f);
+		bool shadow = texel(bake, 100, 110, 0) <= ambient && texel(bake, 100, 150, 0) <= ambient;
+		glm::vec3 to_sun = glm::normalize(-bake.lights.direction);
+		int flat = (int)((0.05f + 0.5f * to_sun.y) * 255.0f + 0.5f);
+		bool sun = texel(bake, 100, 20, 0) == flat && texel(bake, 100, 80, 0) > 3 * ambient;
+		bool sky = texel(bake, 100, 106, 3) < texel(bake, 100, 190, 3) && texel(bake, 100, 96, 3) < texel(bake, 100, 20, 3)
+			&& texel(bake, 100, 20, 3) == 255;
+		passed = report("wall casts its shadow away from the sun", shadow && sun) && passed;
+		passed = report("wall hides part of the sky next to it", sky) && passed;
+	}
+
+	// both modes see the same heights, so they bake the same and share the file
+	{
+		std::vector<unsigned char> pixels = generate_image(300, 200);
+		HeightmapCore mesh, displaced;
+		mesh.create_heightmap(&pixels[0], 300, 200, 1);
+		displaced.create_displaced(&pixels[0], 300, 200, 1);
+		TerrainBake a, b;
+		a.bake(mesh);
+		b.bake(displaced);
+		passed = report("displaced heightmap bakes the same", a.texels == b.texels && a.key(mesh) == b.key(displaced)) && passed;
+	}
+
+	// the file is only taken for the heights and lights it was baked with
+	{
+		std::vector<unsigned char> pixels = generate_image(128, 128);
+		HeightmapCore map;
+		map.create_heightmap(&pixels[0], 128, 128, 1);
+		std::string path = root + "cached.bake";
+
+		TerrainBake first;
+		first.bake_cached(map, path);
+		TerrainBake second;
+		second.bake_cached(map, path);
+		bool cached = !first.from_cache && second.from_cache && second.texels == first.texels;
+		passed = report("second start loads the bake file", cached) && passed;
+
+		TerrainBake moved;
+		moved.lights.point_position[2] = glm::vec3(-4.0f, 2.0f, -11.0f);
+		bool lights = !moved.load(path, map);
+
+		pixels[64 * 128 + 64] ^= 1;
+		HeightmapCore edited;
+		edited.create_heightmap(&pixels[0], 128, 128, 1);
+		TerrainBake other;
+		bool heights = !other.load(path, edited);
+
+		std::filesystem::resize_file(path, 100);
+		bool truncated = !other.load(path, map);
+		passed = report("bake file ignored for other lights", lights) && passed;
+		passed = report("bake file ignored for other heights", heights) && passed;
+		passed = report("truncated bake file ignored", truncated) && passed;
+
+		// and baked again over it
+		TerrainBake again;
+		again.bake_cached(map, path);
+		TerrainBake last;
+		passed = report("stale bake file replaced", !again.from_cache && last.load(path, map) && last.texels == first.texels) && passed;
+	}
+
+	std::filesystem::remove_all(root);
+
+	if (!passed)
+		std::printf("\nFAILED\n");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,1082 @@
+/*** @file heightmap_bench.cpp
+*
+*   @brief Headless benchmark for the GL-free heightmap code (HeightmapCore)
+*
+*   Times building the heights, vertices, normals and chunks of large generated
+*   heightmaps (4k and 8k by default) and compares it with the original single threaded
+*   loop that grew the buffers with push_back and scattered face normals into the vertices.
+*   The original only runs up to 4k, at 8k the two copies don't fit in memory together.
+*   The viewer never builds the whole grid's index list, it is made after the timing and
+*   only where the original is there to compare with.
+*
+*   Also checks that the mesh is the same as the original one on a square image apart
+*   from the normals, that the normals are closer to the exact normals of the generated
+*   terrain than the original ones (the "err" columns, mean degrees), that the channel count doesn't change the mesh, that a wide image keeps its
+*   aspect ratio, and that every thread count gives the same bytes.
+*
+*   The chunk table flies a camera over each heightmap and the shipped 200x200 size and
+*   counts what select_chunks() leaves to draw per frame. It checks that every index
+*   pattern covers its chunk exactly and that neighbouring chunks share their edges.
+*
+*   The topology table compares the triangle list with triangle strips along whole rows and
+*   in blocks of columns: index buffer size and how often the vertex shader runs with a first in,
+*   first out post-transform cache of 16 and 32 vertices (per triangle, the ACMR). The strips have
+*   to draw exactly the triangles of the list, and the chunk table is repeated with strip patterns.
+*
+*   The ground table asks for the height and normal under a million points one at a time and
+*   in batches with and without SIMD. The batches have to give the same bits as single queries,
+*   and the ground at every pixel has to be its vertex through the model matrix.
+*
+*   The displaced table compares the memory of the mesh with MODE_DISPLACED, which only keeps
+*   the 8 bit heights and one flat patch. It checks that the vertex the displacement shader makes
+*   (HeightmapCore::displaced_vertex, the same code on the CPU) is the mesh's vertex for every
+*   patch, that the patches cover the grid exactly once, and that the ground is the same.
+*
+*   The normal map table times building the normal texture on the pool and on one thread and
+*   compares what the terrain shaders decode from it with normal_at() at every pixel, next to
+*   the error of the normals the coarsest chunk level would interpolate without it.
+*   The exit code is 1 if any check fails.
+*
+*   usage: heightmap_bench [image sizes ...]
+*   e.g.   heightmap_bench 2048 4096
+**/
+
+#include <heightmap_core.hpp>
+#include <thread_pool.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+
+// peak resident memory of the process so far, in MB
+static double peak_memory_mb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+	return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+#endif
+}
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// rolling hills plus a little high frequency detail, x and z in [0, 1), height in [0.05, 0.95]
+static float terrain(float x, float z)
+{
+	return 0.5f + 0.25f * sin(6.0f * x + 1.0f) * cos(5.0f * z) + 0.15f * sin(17.0f * (x + z))
+		+ 0.05f * sin(61.0f * x) * sin(53.0f * z);
+}
+
+// exact unit normal of the terrain() surface at (row, column) in the heightmap's model space
+static glm::vec3 terrain_normal(int row, int column, int width, int height)
+{
+	float x = float(row) / float(height), z = float(column) / float(width);
+	float slope_x = 1.5f * cos(6.0f * x + 1.0f) * cos(5.0f * z) + 2.55f * cos(17.0f * (x + z))
+		+ 3.05f * cos(61.0f * x) * sin(53.0f * z);
+	float slope_z = -1.25f * sin(6.0f * x + 1.0f) * sin(5.0f * z) + 2.55f * cos(17.0f * (x + z))
+		+ 2.65f * sin(61.0f * x) * cos(53.0f * z);
+
+	// rows span [-1, 1] in model space on a square image, so x moves by height / (2 (height - 1)) per unit
+	slope_x *= float(height) / (2.0f * float(height - 1));
+	slope_z *= float(width) / (2.0f * float(width - 1));
+	return glm::normalize(glm::vec3(-slope_x, 1.0f, -slope_z));
+}
+
+// terrain() quantized to 8 bits, the same height in every channel like a grey image saved as RGB
+static std::vector<unsigned char> generate_image(int width, int height, int channels)
+{
+	std::vector<unsigned char> pixels((size_t)width * height * channels);
+	for (int row = 0; row < height; row++)
+	{
+		for (int column = 0; column < width; column++)
+		{
+			float h = terrain(float(row) / float(height), float(column) / float(width));
+			unsigned char value = (unsigned char)std::min(255.0f, std::max(0.0f, h * 255.0f + 0.5f));
+			for (int channel = 0; channel < channels; channel++)
+				pixels[((size_t)row * width + column) * channels + channel] = value;
+		}
+	}
+	return pixels;
+}
+
+// angle between two unit vectors in degrees
+static double angle_between(const glm::vec3& a, const glm::vec3& b)
+{
+	return acos(std::min(1.0f, std::max(-1.0f, glm::dot(a, b)))) * 180.0 / 3.14159265358979;
+}
+
+// the original Heightmap constructor, square single channel images only
+// (it indexed data[x*width + y] and ignored the channel count)
+static void original_heightmap(const unsigned char* data, int width, int height,
+	std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	for (int x = 0; x < width; x++)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			Vertex v;
+			v.Position.x = 2.0f*(float(x) / float(width - 1)) - 1.0f;
+			v.Position.y = float(data[x*width + y]) / 255.0f;
+			v.Position.z = 2.0f*(float(y) / float(height - 1)) - 1.0f;
+			v.Normal = glm::vec3(0.0f, 0.0f, 0.0f);
+			v.TexCoords.x = float(x) / float(width - 1);
+			v.TexCoords.y = float(y) / float(height - 1);
+			vertices.push_back(v);
+		}
+	}
+
+	for (int x = 0; x < width - 1; x++)
+	{
+		for (int y = 0; y < height - 1; y++)
+		{
+			unsigned int a = x*width + y, b = x*width + y + 1, c = (x + 1)*width + y, d = (x + 1)*width + y + 1;
+			Vertex* triangles[2][3] = { { &vertices[a], &vertices[b], &vertices[c] }, { &vertices[b], &vertices[d], &vertices[c] } };
+			unsigned int corners[6] = { a, b, c, b, d, c };
+			for (int i = 0; i < 6; i++)
+				indices.push_back(corners[i]);
+
+			for (int t = 0; t < 2; t++)
+			{
+				glm::vec3 normal = glm::cross(triangles[t][1]->Position - triangles[t][0]->Position,
+					triangles[t][2]->Position - triangles[t][0]->Position);
+				triangles[t][0]->Normal += normal;
+				triangles[t][1]->Normal += normal;
+				triangles[t][2]->Normal += normal;
+			}
+		}
+	}
+}
+
+// Same positions, texture coordinates and indices as the original? If so, the mean angle in degrees of the
+// new and the original (normalized) normals inside the grid from the exact normal of the generated terrain.
+// The 8 bit heights make both of them noisy, central differences should be the better estimate.
+static bool compare_original(const HeightmapCore& map, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+	double& error, double& original_error)
+{
+	if (map.vertices.size() != vertices.size() || map.indices.size() != indices.size()
+		|| memcmp(&map.indices[0], &indices[0], indices.size() * sizeof(unsigned int)) != 0)
+		return false;
+
+	double total = 0.0, original_total = 0.0;
+	for (int row = 0; row < map.height; row++)
+	{
+		for (int column = 0; column < map.width; column++)
+		{
+			const Vertex& a = map.vertices[(size_t)row * map.width + column];
+			const Vertex& b = vertices[(size_t)row * map.width + column];
+			if (memcmp(&a.Position, &b.Position, sizeof(a.Position)) != 0
+				|| memcmp(&a.TexCoords, &b.TexCoords, sizeof(a.TexCoords)) != 0)
+				return false;
+
+			if (row == 0 || column == 0 || row == map.height - 1 || column == map.width - 1)
+				continue;
+
+			glm::vec3 exact = terrain_normal(row, column, map.width, map.height);
+			total += angle_between(a.Normal, exact);
+			original_total += angle_between(glm::normalize(b.Normal), exact);
+		}
+	}
+
+	double inside = double(map.width - 2) * double(map.height - 2);
+	error = total / inside;
+	original_error = original_total / inside;
+	return true;
+}
+
+static bool same_mesh(const HeightmapCore& a, const HeightmapCore& b)
+{
+	return a.vertices.size() == b.vertices.size()
+		&& memcmp(&a.vertices[0], &b.vertices[0], a.vertices.size() * sizeof(Vertex)) == 0
+		&& a.indices == b.indices && a.chunk_indices == b.chunk_indices && a.normal_texels == b.normal_texels;
+}
+
+// 1 to 4 channels give the same mesh, and a wide image keeps its aspect ratio with
+// every pixel's height in the right vertex
+static bool check_layouts()
+{
+	bool passed = true;
+
+	const int width = 640, height = 360;
+	HeightmapCore grey;
+	std::vector<unsigned char> grey_pixels = generate_image(width, height, 1);
+	grey.create_heightmap(&grey_pixels[0], width, height, 1);
+	bool skipped = grey.indices.empty();
+	grey.create_indices();
+
+	bool heights_ok = grey.vertices.size() == (size_t)width * height;
+	for (int row = 0; heights_ok && row < height; row++)
+		for (int column = 0; column < width; column++)
+			heights_ok = heights_ok && grey.vertices[(size_t)row * width + column].Position.y == float(grey_pixels[(size_t)row * width + column]) / 255.0f;
+
+	const Vertex& corner = grey.vertices.back();
+	bool aspect_ok = fabs(corner.Position.z - 1.0f) < 1.0e-6f
+		&& fabs(corner.Position.x - float(height - 1) / float(width - 1)) < 1.0e-6f
+		&& fabs(grey.vertices[0].Position.x + corner.Position.x) < 1.0e-6f;
+
+	bool indices_ok = grey.indices.size() == (size_t)(width - 1) * (height - 1) * 6;
+	for (size_t i = 0; indices_ok && i < grey.indices.size(); i++)
+		indices_ok = grey.indices[i] < grey.vertices.size();
+
+	std::printf("%-30s %s\n", "640x360 heights", heights_ok ? "ok" : "WRONG");
+	std::printf("%-30s %s\n", "640x360 aspect ratio", aspect_ok ? "ok" : "WRONG");
+	std::printf("%-30s %s\n", "640x360 indices in range", indices_ok ? "ok" : "WRONG");
+	std::printf("%-30s %s\n", "640x360 no full index list", skipped ? "ok" : "WRONG");
+	passed = heights_ok && aspect_ok && indices_ok && skipped;
+	grey.indices = std::vector<unsigned int>();
+
+	for (int channels = 2; channels <= 4; channels++)
+	{
+		HeightmapCore map;
+		std::vector<unsigned char> pixels = generate_image(width, height, channels);
+		map.create_heightmap(&pixels[0], width, height, channels);
+
+		bool same = same_mesh(map, grey);
+		std::printf("%-27s %d  %s\n", "640x360 same mesh, channels", channels, same ? "ok" : "WRONG");
+		passed = passed && same;
+	}
+
+	return passed;
+}
+
+// create_heightmap() on 1 .. max_threads threads, the output has to be the same
+// bytes as with one thread. Returns false if it isn't.
+static bool bench_scaling(const std::vector<unsigned char>& pixels, int size, unsigned int max_threads)
+{
+	std::printf("\n%-8s %9s %9s %9s\n", "threads", "build ms", "speedup", "identical");
+
+	HeightmapCore one;
+	double one_ms = 0.0;
+	bool identical = true;
+
+	for (unsigned int threads = 1; threads <= max_threads; threads++)
+	{
+		HeightmapCore map;
+		map.threads = threads;
+
+		double t0 = now_ms();
+		map.create_heightmap(&pixels[0], size, size, 1);
+		double t1 = now_ms();
+
+		bool same = true;
+		if (threads == 1)
+		{
+			one_ms = t1 - t0;
+			one = map;
+		}
+		else
+		{
+			same = same_mesh(map, one);
+			identical = identical && same;
+		}
+
+		std::printf("%-8u %9.2f %9.2f %9s\n", threads, t1 - t0, one_ms / (t1 - t0), same ? "yes" : "NO");
+	}
+
+	return identical;
+}
+
+// The triangles an index range draws, each turned so its smallest index comes first (keeping its
+// winding), degenerate ones left out. A strip's odd triangles are (v[i + 1], v[i], v[i + 2]).
+static std::vector<unsigned int> decode_triangles(const unsigned int* index, size_t count, HeightmapCore::Topology topology)
+{
+	std::vector<unsigned int> out;
+	size_t strip_start = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int t[3];
+		if (topology == HeightmapCore::TOPOLOGY_TRIANGLES)
+		{
+			if (i % 3 != 2) continue;
+			t[0] = index[i - 2]; t[1] = index[i - 1]; t[2] = index[i];
+		}
+		else
+		{
+			if (index[i] == HeightmapCore::RESTART_INDEX)
+			{
+				strip_start = i + 1;
+				continue;
+			}
+			if (i < strip_start + 2) continue;
+			size_t k = i - strip_start - 2;
+			t[0] = index[k % 2 ? i - 1 : i - 2]; t[1] = index[k % 2 ? i - 2 : i - 1]; t[2] = index[i];
+		}
+		if (t[0] == t[1] || t[1] == t[2] || t[0] == t[2]) continue;
+
+		int smallest = t[0] < t[1] ? (t[0] < t[2] ? 0 : 2) : (t[1] < t[2] ? 1 : 2);
+		for (int corner = 0; corner < 3; corner++)
+			out.push_back(t[(smallest + corner) % 3]);
+	}
+	return out;
+}
+
+// the triangles sorted, to compare two index buffers that list them in a different order
+static std::vector<unsigned long long> sorted_triangles(const std::vector<unsigned int>& triangles, unsigned int vertices)
+{
+	std::vector<unsigned long long> keys;
+	for (size_t t = 0; t < triangles.size(); t += 3)
+		keys.push_back(((unsigned long long)triangles[t] * vertices + triangles[t + 1]) * vertices + triangles[t + 2]);
+	std::sort(keys.begin(), keys.end());
+	return keys;
+}
+
+// times the vertex shader runs for an index buffer with a first in, first out post-transform
+// cache of entries vertices, the restart index doesn't run it or clear the cache
+static size_t vertex_shader_runs(const std::vector<unsigned int>& indices, size_t vertices, size_t entries)
+{
+	// the run that put each vertex in the cache, it drops out entries runs later
+	std::vector<size_t> loaded(vertices, (size_t)-1);
+	size_t runs = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int vertex = indices[i];
+		if (vertex == HeightmapCore::RESTART_INDEX) continue;
+		if (loaded[vertex] == (size_t)-1 || runs - loaded[vertex] >= entries)
+			loaded[vertex] = runs++;
+	}
+	return runs;
+}
+
+// the strips of a wide image (its 639 columns of cells don't fill the last block) draw exactly the
+// triangles of the list, facing the same way, for strips along whole rows and in blocks
+static bool check_strips()
+{
+	const int width = 640, height = 360;
+	std::vector<unsigned char> pixels = generate_image(width, height, 1);
+	HeightmapCore map;
+	map.create_heightmap(&pixels[0], width, height, 1);
+	map.create_indices();
+	std::vector<unsigned long long> list = sorted_triangles(
+		decode_triangles(&map.indices[0], map.indices.size(), HeightmapCore::TOPOLOGY_TRIANGLES), width * height);
+
+	bool passed = true;
+	int blocks[3] = { 0, 16, 7 };
+	for (int b = 0; b < 3; b++)
+	{
+		map.topology = HeightmapCore::TOPOLOGY_STRIPS;
+		map.strip_block = blocks[b];
+		map.create_indices();
+		bool same = sorted_triangles(decode_triangles(&map.indices[0], map.indices.size(), map.topology), width * height) == list;
+		std::printf("%-27s %2d %s\n", "640x360 strips = list, block", blocks[b], same ? "ok" : "WRONG");
+		passed = passed && same;
+	}
+	return passed;
+}
+
+// index buffer size and vertex shader runs of the whole grid as a list and as strips, and the
+// vertex shader runs per triangle of a full detail chunk (the first pattern) laid out the same way
+static void bench_topology(const char* name, HeightmapCore& map)
+{
+	struct Layout { const char* name; HeightmapCore::Topology topology; int strip_block; };
+	const Layout layouts[] = {
+		{ "list", HeightmapCore::TOPOLOGY_TRIANGLES, 0 },
+		{ "strips rows", HeightmapCore::TOPOLOGY_STRIPS, 0 },
+		{ "strips 32", HeightmapCore::TOPOLOGY_STRIPS, 32 },
+		{ "strips 16", HeightmapCore::TOPOLOGY_STRIPS, 16 },
+		{ "strips 8", HeightmapCore::TOPOLOGY_STRIPS, 8 },
+	};
+
+	HeightmapCore::Topology topology = map.topology;
+	int strip_block = map.strip_block;
+	double triangles = 2.0 * (map.width - 1) * (map.height - 1);
+	double list_bytes = 0.0;
+
+	for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++)
+	{
+		map.topology = layouts[l].topology;
+		map.strip_block = layouts[l].strip_block;
+		double t0 = now_ms();
+		map.create_indices();
+		double build_ms = now_ms() - t0;
+
+		double bytes = map.indices.size() * sizeof(unsigned int);
+		if (l == 0) list_bytes = bytes;
+		size_t runs16 = vertex_shader_runs(map.indices, map.vertices.size(), 16);
+		size_t runs32 = vertex_shader_runs(map.indices, map.vertices.size(), 32);
+
+		map.build_chunks();
+		std::vector<unsigned int> chunk(map.chunk_indices.begin() + map.pattern_first[0],
+			map.chunk_indices.begin() + map.pattern_first[0] + map.pattern_count[0]);
+		double chunk16 = vertex_shader_runs(chunk, map.vertices.size(), 16) / double(map.pattern_triangles[0]);
+		double chunk32 = vertex_shader_runs(chunk, map.vertices.size(), 32) / double(map.pattern_triangles[0]);
+
+		std::printf("%-12s %-12s %12zu %9.1f %8.2f %9.1f %12zu %7.3f %12zu %7.3f %9.3f %9.3f\n", name, layouts[l].name,
+			map.indices.size(), bytes / (1024.0 * 1024.0), bytes / list_bytes, build_ms, runs16, runs16 / triangles,
+			runs32, runs32 / triangles, chunk16, chunk32);
+	}
+
+	map.topology = topology;
+	map.strip_block = strip_block;
+	map.create_indices();
+	map.build_chunks();
+}
+
+// every index pattern covers its chunk exactly once with triangles facing up:
+// all of them turn the right way and their areas add up to the chunk's
+static bool check_patterns(const HeightmapCore& map)
+{
+	for (int shape = 0; shape < 4; shape++)
+	{
+		// a chunk of this shape, if there is one
+		const HeightmapCore::Chunk* chunk = NULL;
+		for (size_t k = 0; k < map.chunks.size() && chunk == NULL; k++)
+			if (map.chunks[k].shape == shape) chunk = &map.chunks[k];
+		if (chunk == NULL) continue;
+
+		for (int level = 0; level < HeightmapCore::LOD_LEVELS; level++)
+		{
+			for (int stitch = 0; stitch < HeightmapCore::STITCH_MASKS; stitch++)
+			{
+				size_t pattern = ((size_t)shape * HeightmapCore::LOD_LEVELS + level) * HeightmapCore::STITCH_MASKS + stitch;
+				std::vector<unsigned int> index = decode_triangles(&map.chunk_indices[map.pattern_first[pattern]],
+					map.pattern_count[pattern], map.topology);
+				if (index.size() != 3 * (size_t)map.pattern_triangles[pattern]) return false;
+
+				long long area = 0;
+				for (size_t t = 0; t < index.size(); t += 3)
+				{
+					int r[3], c[3];
+					for (int corner = 0; corner < 3; corner++)
+					{
+						r[corner] = index[t + corner] / map.width;
+						c[corner] = index[t + corner] % map.width;
+						if (r[corner] > chunk->rows || c[corner] > chunk->columns) return false;
+					}
+					long long turn = (long long)(c[1] - c[0]) * (r[2] - r[0]) - (long long)(r[1] - r[0]) * (c[2] - c[0]);
+					if (turn <= 0) return false;
+					area += turn;
+				}
+				if (area != 2LL * chunk->rows * chunk->columns) return false;
+			}
+		}
+	}
+	return true;
+}
+
+// the vertices a chunk's draw call puts on one of its sides, by grid index
+static std::vector<unsigned int> side_vertices(const HeightmapCore& map, size_t k, int side)
+{
+	const HeightmapCore::Chunk& chunk = map.chunks[k];
+	HeightmapCore::ChunkDraw draw = map.chunk_draw(k);
+
+	std::vector<unsigned int> found;
+	for (unsigned int i = 0; i < draw.count; i++)
+	{
+		if (map.chunk_indices[draw.first + i] == HeightmapCore::RESTART_INDEX) continue;
+		unsigned int vertex = map.chunk_indices[draw.first + i] + draw.base_vertex;
+		int row = vertex / map.width, column = vertex % map.width;
+		bool on_side = side == HeightmapCore::STITCH_TOP ? row == chunk.row
+			: side == HeightmapCore::STITCH_BOTTOM ? row == chunk.row + chunk.rows
+			: side == HeightmapCore::STITCH_LEFT ? column == chunk.column
+			: column == chunk.column + chunk.columns;
+		if (on_side) found.push_back(vertex);
+	}
+	std::sort(found.begin(), found.end());
+	found.erase(std::unique(found.begin(), found.end()), found.end());
+	return found;
+}
+
+// no cracks: every pair of neighbouring chunks uses the same vertices on the side they share,
+// at the levels select_chunks() picked. Checked for all chunks, culled or not.
+static bool check_seams(const HeightmapCore& map)
+{
+	for (int i = 0; i < map.chunk_rows; i++)
+		for (int j = 0; j < map.chunk_columns; j++)
+		{
+			size_t k = (size_t)i * map.chunk_columns + j;
+			if (i + 1 < map.chunk_rows && side_vertices(map, k, HeightmapCore::STITCH_BOTTOM)
+				!= side_vertices(map, k + map.chunk_columns, HeightmapCore::STITCH_TOP))
+				return false;
+			if (j + 1 < map.chunk_columns && side_vertices(map, k, HeightmapCore::STITCH_RIGHT)
+				!= side_vertices(map, k + 1, HeightmapCore::STITCH_LEFT))
+				return false;
+		}
+	return true;
+}
+
+// what select_chunks() leaves to draw along a flight over the terrain
+struct ChunkStats
+{
+	std::string name;
+	size_t chunks, pattern_indices;
+	double chunk_ms, select_us;
+	double triangles, max_triangles, draws;
+	bool patterns_ok, seams_ok;
+};
+
+// The viewer's camera on frame of frames: in a circle around the terrain looking at its middle for the
+// first half, then low across it looking ahead
+static glm::mat4 flight_view(int frame, int frames)
+{
+	float angle = 2.0f * 3.14159265f * frame / (frames / 2);
+	glm::vec3 eye, target;
+	if (frame < frames / 2)
+	{
+		eye = glm::vec3(35.0f * cos(angle), -5.0f, 35.0f * sin(angle));
+		target = glm::vec3(0.0f, -20.0f, 0.0f);
+	}
+	else
+	{
+		eye = glm::vec3(-28.0f + 56.0f * (frame - frames / 2) / (frames / 2), -12.0f, 5.0f * sin(angle));
+		target = eye + glm::vec3(10.0f, -3.0f, 2.0f * cos(angle));
+	}
+	return glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// the viewer's projection, 45 degrees at 1280x720
+static glm::mat4 flight_projection()
+{
+	return glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+}
+
+// fly the viewer's camera along flight_view() and select the chunks on every frame
+static ChunkStats bench_chunks(const char* name, HeightmapCore& map)
+{
+	ChunkStats stats;
+	stats.name = name;
+
+	double t0 = now_ms();
+	map.build_chunks();
+	stats.chunk_ms = now_ms() - t0;
+
+	stats.chunks = map.chunks.size();
+	stats.pattern_indices = map.chunk_indices.size();
+	stats.patterns_ok = check_patterns(map);
+	stats.seams_ok = true;
+	stats.triangles = stats.max_triangles = stats.draws = 0.0;
+
+	glm::mat4 model = map.model_matrix();
+	glm::mat4 projection = flight_projection();
+
+	const int FRAMES = 64;
+	double select_ms = 0.0;
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		glm::mat4 view = flight_view(frame, FRAMES);
+
+		double t1 = now_ms();
+		map.select_chunks(model, view, projection, 720.0f);
+		select_ms += now_ms() - t1;
+
+		stats.triangles += map.chunk_triangles;
+		stats.max_triangles = std::max(stats.max_triangles, (double)map.chunk_triangles);
+		stats.draws += map.chunk_draws.size();
+		if (frame % 8 == 0)
+			stats.seams_ok = stats.seams_ok && check_seams(map);
+	}
+
+	stats.select_us = select_ms * 1000.0 / FRAMES;
+	stats.triangles /= FRAMES;
+	stats.draws /= FRAMES;
+	return stats;
+}
+
+// the ground under points spread over the terrain and a little beyond
+struct GroundStats
+{
+	std::string name;
+	size_t points;
+	double single_ns, batch_ns, simd_ns, simd_heights_ns;
+	bool same_bits, pixels_ok, between_ok;
+};
+
+static GroundStats bench_ground(const char* name, const HeightmapCore& map)
+{
+	GroundStats stats;
+	stats.name = name;
+	stats.points = 1 << 20;
+
+	// the same pseudo random points every run, 10% off the grid on each side
+	std::vector<glm::vec2> points(stats.points);
+	unsigned int seed = 12345;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		float x = float(seed >> 8) / 16777216.0f;
+		seed = seed * 1664525u + 1013904223u;
+		float z = float(seed >> 8) / 16777216.0f;
+		points[i] = glm::vec2(66.0f * x - 33.0f, 66.0f * z - 33.0f);
+	}
+
+	std::vector<float> single(points.size()), batch(points.size()), simd(points.size()), simd_heights(points.size());
+	std::vector<glm::vec3> single_normals(points.size()), batch_normals(points.size()), simd_normals(points.size());
+
+	double t0 = now_ms();
+	for (size_t i = 0; i < points.size(); i++)
+		single[i] = map.ground_height(points[i], &single_normals[i]);
+	double t1 = now_ms();
+	map.ground_heights(&points[0], points.size(), &batch[0], &batch_normals[0], false);
+	double t2 = now_ms();
+	map.ground_heights(&points[0], points.size(), &simd[0], &simd_normals[0], true);
+	double t3 = now_ms();
+	map.ground_heights(&points[0], points.size(), &simd_heights[0], NULL, true);
+	double t4 = now_ms();
+
+	double per_point = 1.0e6 / points.size();
+	stats.single_ns = (t1 - t0) * per_point;
+	stats.batch_ns = (t2 - t1) * per_point;
+	stats.simd_ns = (t3 - t2) * per_point;
+	stats.simd_heights_ns = (t4 - t3) * per_point;
+
+	size_t float_bytes = points.size() * sizeof(float), normal_bytes = points.size() * sizeof(glm::vec3);
+	stats.same_bits = memcmp(&single[0], &batch[0], float_bytes) == 0 && memcmp(&single[0], &simd[0], float_bytes) == 0
+		&& memcmp(&single[0], &simd_heights[0], float_bytes) == 0
+		&& memcmp(&single_normals[0], &batch_normals[0], normal_bytes) == 0
+		&& memcmp(&single_normals[0], &simd_normals[0], normal_bytes) == 0;
+
+	// Every pixel (every 7th row and column on big maps) is its vertex through the model matrix. A vertex
+	// through the model matrix and back misses its pixel by up to 1e-4 pixels on an 8k map, enough to
+	// move the normal by 1e-3 where the normals change quickly.
+	glm::mat4 model = map.model_matrix();
+	glm::vec3 normal_scale(1.0f / model[0][0], 1.0f / model[1][1], 1.0f / model[2][2]);
+	int step = map.width > 1024 ? 7 : 1;
+	stats.pixels_ok = stats.between_ok = true;
+	for (int row = 0; row < map.height; row += step)
+	{
+		for (int column = 0; column < map.width; column += step)
+		{
+			const Vertex& vertex = map.vertices[(size_t)row * map.width + column];
+			glm::vec3 world = glm::vec3(model * glm::vec4(vertex.Position, 1.0f));
+			glm::vec3 normal;
+			float height = map.ground_height(glm::vec2(world.x, world.z), &normal);
+			stats.pixels_ok = stats.pixels_ok && fabs(height - world.y) < 1.0e-3f
+				&& glm::length(normal - glm::normalize(vertex.Normal * normal_scale)) < 1.0e-2f;
+
+			// halfway to the next pixel along z is their mean
+			if (column + 1 < map.width)
+			{
+				const Vertex& next = map.vertices[(size_t)row * map.width + column + 1];
+				glm::vec3 next_world = glm::vec3(model * glm::vec4(next.Position, 1.0f));
+				float between = map.ground_height(0.5f * (glm::vec2(world.x, world.z) + glm::vec2(next_world.x, next_world.z)));
+				stats.between_ok = stats.between_ok && fabs(between - 0.5f * (world.y + next_world.y)) < 1.0e-3f;
+			}
+		}
+	}
+	return stats;
+}
+
+static bool print_ground(const std::vector<GroundStats>& results)
+{
+	std::printf("\n%-12s %8s %10s %10s %10s %10s %8s %9s %8s %8s\n", "ground", "points", "single ns", "batch ns",
+		HeightmapCore::ground_simd() ? "SIMD ns" : "(no SIMD)", "heights ns", "speedup",
+		"same bits", "pixels", "between");
+
+	bool passed = true;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const GroundStats& stats = results[i];
+		std::printf("%-12s %8zu %10.1f %10.1f %10.1f %10.1f %8.2f %9s %8s %8s\n", stats.name.c_str(), stats.points,
+			stats.single_ns, stats.batch_ns, stats.simd_ns, stats.simd_heights_ns, stats.single_ns / stats.simd_ns,
+			stats.same_bits ? "yes" : "NO", stats.pixels_ok ? "ok" : "WRONG", stats.between_ok ? "ok" : "WRONG");
+		passed = passed && stats.same_bits && stats.pixels_ok && stats.between_ok;
+	}
+	return passed;
+}
+
+// the normal map of one heightmap
+struct NormalMapStats
+{
+	std::string name;
+	double mb, build_ms, one_ms;
+	// mean and largest angle between the normal map and the exact normal of every pixel, and the mean angle
+	// of the normals the coarsest chunk level interpolates, in degrees
+	double mean_error, max_error, coarse_error;
+	bool ok;
+};
+
+static double angle_degrees(const glm::vec3& a, const glm::vec3& b)
+{
+	return acos(std::min(1.0f, std::max(-1.0f, glm::dot(a, b)))) * 180.0 / 3.14159265358979;
+}
+
+// time create_normal_map() on the pool and on one thread, and compare what the shaders get with normal_at()
+static NormalMapStats bench_normal_map(const char* name, HeightmapCore& map)
+{
+	NormalMapStats stats;
+	stats.name = name;
+	stats.mb = map.normal_texels.size() / (1024.0 * 1024.0);
+
+	std::vector<unsigned char> built = map.normal_texels;
+	double t0 = now_ms();
+	map.create_normal_map();
+	stats.build_ms = now_ms() - t0;
+	bool same = map.normal_texels == built;
+
+	map.threads = 1;
+	t0 = now_ms();
+	map.create_normal_map();
+	stats.one_ms = now_ms() - t0;
+	map.threads = 0;
+	same = same && map.normal_texels == built;
+
+	// Every pixel (every 7th row and column on big maps). The coarsest level keeps every 2^(LOD_LEVELS - 1)th
+	// vertex, between them the normal is about the bilinear mean of its four corners' normals.
+	int coarse = 1 << (HeightmapCore::LOD_LEVELS - 1);
+	int step = map.width > 1024 ? 7 : 1;
+	double sum = 0.0, coarse_sum = 0.0;
+	size_t count = 0;
+	stats.max_error = 0.0;
+	bool within = true;
+	for (int row = 0; row < map.height; row += step)
+	{
+		for (int column = 0; column < map.width; column += step)
+		{
+			glm::vec3 exact = map.normal_at(row, column);
+			glm::vec3 texel = map.normal_texel(row, column);
+			double error = angle_degrees(texel, exact);
+			sum += error;
+
+			// x and z are stored, each at most half a step of 2/255 off before normalizing
+			const unsigned char* stored = &map.normal_texels[((size_t)row * map.width + column) * 2];
+			within = within && fabs(stored[0] / 127.5f - 1.0f - exact.x) <= 1.0f / 255.0f + 1.0e-6f
+				&& fabs(stored[1] / 127.5f - 1.0f - exact.z) <= 1.0f / 255.0f + 1.0e-6f && texel.y >= 0.0f;
+			stats.max_error = std::max(stats.max_error, error);
+
+			int r0 = std::min(row / coarse * coarse, map.height - 1), c0 = std::min(column / coarse * coarse, map.width - 1);
+			int r1 = std::min(r0 + coarse, map.height - 1), c1 = std::min(c0 + coarse, map.width - 1);
+			float u = r1 > r0 ? float(row - r0) / float(r1 - r0) : 0.0f, v = c1 > c0 ? float(column - c0) / float(c1 - c0) : 0.0f;
+			glm::vec3 between = (1.0f - u) * ((1.0f - v) * map.normal_at(r0, c0) + v * map.normal_at(r0, c1))
+				+ u * ((1.0f - v) * map.normal_at(r1, c0) + v * map.normal_at(r1, c1));
+			coarse_sum += angle_degrees(glm::normalize(between), exact);
+			count++;
+		}
+	}
+	stats.mean_error = sum / count;
+	stats.coarse_error = coarse_sum / count;
+
+	stats.ok = same && within && map.normal_texels.size() == (size_t)map.width * map.height * 2;
+	return stats;
+}
+
+static bool print_normal_maps(const std::vector<NormalMapStats>& results)
+{
+	std::printf("\n%-12s %9s %9s %9s %9s %10s %10s %11s %9s\n", "normal map", "MB", "build ms", "1 thr ms", "speedup",
+		"mean err", "max err", "coarse err", "checks");
+
+	bool passed = true;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const NormalMapStats& stats = results[i];
+		std::printf("%-12s %9.1f %9.1f %9.1f %9.2f %10.3f %10.3f %11.3f %9s\n", stats.name.c_str(), stats.mb, stats.build_ms,
+			stats.one_ms, stats.one_ms / stats.build_ms, stats.mean_error, stats.max_error, stats.coarse_error,
+			stats.ok ? "ok" : "WRONG");
+		passed = passed && stats.ok;
+	}
+	std::printf("(errors in degrees against normal_at(), coarse = what the coarsest chunk level interpolates without the map)\n");
+	return passed;
+}
+
+// the mesh against MODE_DISPLACED for the same image
+struct DisplacedStats
+{
+	std::string name;
+	double image_mb, mesh_cpu_mb, mesh_gpu_mb, cpu_mb, gpu_mb;
+	double mesh_ms, build_ms;
+	size_t patches;
+	double visible, triangles;
+	bool vertices_ok, coverage_ok, ground_ok;
+};
+
+static DisplacedStats bench_displaced(const char* name, const std::vector<unsigned char>& pixels, const HeightmapCore& mesh, double mesh_ms)
+{
+	DisplacedStats stats;
+	stats.name = name;
+	stats.mesh_ms = mesh_ms;
+
+	HeightmapCore map;
+	map.topology = mesh.topology;
+	double t0 = now_ms();
+	map.create_displaced(&pixels[0], mesh.width, mesh.height, 1);
+	stats.build_ms = now_ms() - t0;
+
+	const double MB = 1024.0 * 1024.0;
+	stats.image_mb = pixels.size() / MB;
+	stats.mesh_cpu_mb = (mesh.heights.size() * sizeof(float) + mesh.vertices.size() * sizeof(Vertex)
+		+ mesh.indices.size() * sizeof(unsigned int) + mesh.chunk_indices.size() * sizeof(unsigned int)
+		+ mesh.chunks.size() * sizeof(HeightmapCore::Chunk) + mesh.normal_texels.size()) / MB;
+	stats.mesh_gpu_mb = (mesh.vertices.size() * sizeof(Vertex) + mesh.chunk_indices.size() * sizeof(unsigned int)
+		+ mesh.normal_texels.size()) / MB;
+	stats.cpu_mb = (map.height_pixels.size() + map.patch_heights.size() * sizeof(glm::vec2) + map.patch_vertices.size()
+		+ map.patch_indices.size() * sizeof(unsigned int) + map.patch_draws.size() * sizeof(int) + map.normal_texels.size()) / MB;
+	// the height and normal textures, the flat patch and the patch numbers
+	stats.gpu_mb = (map.height_pixels.size() + map.normal_texels.size() + map.patch_vertices.size()
+		+ map.patch_indices.size() * sizeof(unsigned int) + map.patch_heights.size() * sizeof(int)) / MB;
+	stats.patches = map.patch_heights.size();
+
+	// every vertex of every patch (every 5th patch on big maps) is the mesh's vertex, bit for bit
+	size_t patch_vertices = map.patch_vertices.size() / 2;
+	size_t patch_step = map.width > 4096 ? 5 : 1;
+	stats.vertices_ok = true;
+	for (size_t patch = 0; patch < stats.patches && stats.vertices_ok; patch += patch_step)
+	{
+		int patch_row = (int)(patch / map.patch_columns) * HeightmapCore::PATCH_SIZE;
+		int patch_column = (int)(patch % map.patch_columns) * HeightmapCore::PATCH_SIZE;
+		for (size_t v = 0; v < patch_vertices; v++)
+		{
+			int r = map.patch_vertices[2 * v], c = map.patch_vertices[2 * v + 1];
+			Vertex displaced = map.displaced_vertex((int)patch, r, c);
+			int row = std::min(patch_row + r, map.height - 1), column = std::min(patch_column + c, map.width - 1);
+			if (memcmp(&displaced, &mesh.vertices[(size_t)row * mesh.width + column], sizeof(Vertex)) != 0)
+			{
+				stats.vertices_ok = false;
+				break;
+			}
+		}
+	}
+
+	// the patches' triangles, folded onto the grid, face up and add up to its area
+	std::vector<unsigned int> triangles = decode_triangles(&map.patch_indices[0], map.patch_indices.size(), map.topology);
+	long long area = 0;
+	stats.coverage_ok = true;
+	for (size_t patch = 0; patch < stats.patches && stats.coverage_ok; patch++)
+	{
+		for (size_t t = 0; t < triangles.size(); t += 3)
+		{
+			int r[3], c[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int v = triangles[t + corner];
+				r[corner] = std::min((int)(patch / map.patch_columns) * HeightmapCore::PATCH_SIZE + map.patch_vertices[2 * v], map.height - 1);
+				c[corner] = std::min((int)(patch % map.patch_columns) * HeightmapCore::PATCH_SIZE + map.patch_vertices[2 * v + 1], map.width - 1);
+			}
+			long long turn = (long long)(c[1] - c[0]) * (r[2] - r[0]) - (long long)(r[1] - r[0]) * (c[2] - c[0]);
+			stats.coverage_ok = stats.coverage_ok && turn >= 0;
+			area += turn;
+		}
+	}
+	stats.coverage_ok = stats.coverage_ok && area == 2LL * (map.width - 1) * (map.height - 1);
+
+	// the ground from the pixels is the ground from the mesh
+	std::vector<glm::vec2> points(65536);
+	for (size_t i = 0; i < points.size(); i++)
+		points[i] = glm::vec2(-31.0f + 62.0f * (i % 256) / 255.0f, -31.0f + 62.0f * (i / 256) / 255.0f);
+	std::vector<float> mesh_heights(points.size()), heights(points.size());
+	std::vector<glm::vec3> mesh_normals(points.size()), normals(points.size());
+	mesh.ground_heights(&points[0], points.size(), &mesh_heights[0], &mesh_normals[0], false);
+	map.ground_heights(&points[0], points.size(), &heights[0], &normals[0]);
+	stats.ground_ok = memcmp(&mesh_heights[0], &heights[0], heights.size() * sizeof(float)) == 0
+		&& memcmp(&mesh_normals[0], &normals[0], normals.size() * sizeof(glm::vec3)) == 0
+		&& map.normal_texels == mesh.normal_texels;
+
+	// patches left to draw along the flight
+	const int FRAMES = 64;
+	stats.visible = 0.0;
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		map.select_patches(map.model_matrix(), flight_view(frame, FRAMES), flight_projection());
+		stats.visible += map.patch_draws.size();
+	}
+	stats.visible /= FRAMES;
+	stats.triangles = stats.visible * triangles.size() / 3;
+	return stats;
+}
+
+static bool print_displaced(const std::vector<DisplacedStats>& results)
+{
+	std::printf("\n%-12s %9s %11s %11s %10s %10s %8s %9s %8s %9s %10s %9s %9s %7s\n", "displaced", "image MB", "mesh CPU MB",
+		"mesh GPU MB", "CPU MB", "GPU MB", "mesh ms", "build ms", "patches", "in view", "avg tris", "vertices", "coverage", "ground");
+
+	bool passed = true;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const DisplacedStats& stats = results[i];
+		std::printf("%-12s %9.1f %11.1f %11.1f %10.1f %10.1f %8.1f %9.1f %8zu %9.1f %10.0f %9s %9s %7s\n", stats.name.c_str(),
+			stats.image_mb, stats.mesh_cpu_mb, stats.mesh_gpu_mb, stats.cpu_mb, stats.gpu_mb, stats.mesh_ms, stats.build_ms,
+			stats.patches, stats.visible, stats.triangles, stats.vertices_ok ? "same" : "WRONG", stats.coverage_ok ? "ok" : "WRONG",
+			stats.ground_ok ? "same" : "WRONG");
+		passed = passed && stats.vertices_ok && stats.coverage_ok && stats.ground_ok;
+	}
+	return passed;
+}
+
+static bool print_chunks(const std::vector<ChunkStats>& results)
+{
+	// the shipped hflab4.jpg drawn whole, what a frame cost before
+	const double shipped_triangles = 2.0 * 199.0 * 199.0;
+
+	std::printf("\n%-18s %8s %10s %9s %10s %10s %10s %9s %10s %9s %7s\n",
+		"chunks", "chunks", "pattern MB", "chunk ms", "select us", "avg tris", "max tris", "draws", "vs 200x200", "patterns", "seams");
+
+	bool passed = true;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const ChunkStats& stats = results[i];
+		std::printf("%-18s %8zu %10.2f %9.1f %10.1f %10.0f %10.0f %9.1f %10.2f %9s %7s\n", stats.name.c_str(), stats.chunks,
+			stats.pattern_indices * sizeof(unsigned int) / (1024.0 * 1024.0), stats.chunk_ms, stats.select_us,
+			stats.triangles, stats.max_triangles, stats.draws, stats.triangles / shipped_triangles,
+			stats.patterns_ok ? "ok" : "WRONG", stats.seams_ok ? "ok" : "CRACKS");
+		passed = passed && stats.patterns_ok && stats.seams_ok;
+	}
+	return passed;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> sizes;
+	for (int i = 1; i < argc; i++)
+		sizes.push_back(atoi(argv[i]));
+	if (sizes.empty())
+	{
+		sizes.push_back(4096);
+		sizes.push_back(8192);
+	}
+
+	bool passed = check_layouts();
+	passed = check_strips() && passed;
+
+	// the size of the shipped heightmap, for the chunk table
+	std::vector<ChunkStats> chunk_results;
+	std::vector<int> topology_sizes(1, 200);
+	std::vector<GroundStats> ground_results;
+	std::vector<DisplacedStats> displaced_results;
+	std::vector<NormalMapStats> normal_results;
+	{
+		HeightmapCore shipped;
+		std::vector<unsigned char> pixels = generate_image(200, 200, 1);
+		double t0 = now_ms();
+		shipped.create_heightmap(&pixels[0], 200, 200, 1);
+		displaced_results.push_back(bench_displaced("200x200", pixels, shipped, now_ms() - t0));
+		chunk_results.push_back(bench_chunks("200x200", shipped));
+		ground_results.push_back(bench_ground("200x200", shipped));
+		normal_results.push_back(bench_normal_map("200x200", shipped));
+		shipped.topology = HeightmapCore::TOPOLOGY_STRIPS;
+		chunk_results.push_back(bench_chunks("200x200 strips", shipped));
+	}
+
+	std::printf("\n%-12s %10s %12s %12s %11s %9s %9s %12s %9s %11s %9s\n",
+		"heightmap", "vertices", "indices", "original ms", "orig peak", "build ms", "speedup", "vertices/s", "peak MB", "normal err", "orig err");
+
+	for (size_t i = 0; i < sizes.size(); i++)
+	{
+		int size = sizes[i];
+		std::vector<unsigned char> pixels = generate_image(size, size, 1);
+
+		// the original first, its buffers are gone again before the new one is built
+		double original_ms = 0.0, original_peak = 0.0;
+		std::vector<Vertex> original_vertices;
+		std::vector<unsigned int> original_indices;
+		if (size <= 4096)
+		{
+			double t0 = now_ms();
+			original_heightmap(&pixels[0], size, size, original_vertices, original_indices);
+			original_ms = now_ms() - t0;
+			original_peak = peak_memory_mb();
+		}
+
+		HeightmapCore map;
+		double t0 = now_ms();
+		map.create_heightmap(&pixels[0], size, size, 1);
+		double build_ms = now_ms() - t0;
+		double peak_mb = peak_memory_mb();
+
+		// the full grid's indices only to compare with the original, the viewer never builds them
+		if (!original_vertices.empty())
+			map.create_indices();
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "%dx%d", size, size);
+		std::printf("%-12s %10zu ", name, map.vertices.size());
+		if (!map.indices.empty())
+			std::printf("%12zu ", map.indices.size());
+		else
+			std::printf("%12s ", "-");
+		if (original_ms > 0.0)
+			std::printf("%12.1f %11.1f ", original_ms, original_peak);
+		else
+			std::printf("%12s %11s ", "-", "-");
+		std::printf("%9.1f ", build_ms);
+		if (original_ms > 0.0)
+			std::printf("%9.2f ", original_ms / build_ms);
+		else
+			std::printf("%9s ", "-");
+		std::printf("%12.3g %9.1f ", map.vertices.size() / (build_ms / 1000.0), peak_mb);
+
+		if (!original_vertices.empty())
+		{
+			double error = 0.0, original_error = 0.0;
+			bool ok = compare_original(map, original_vertices, original_indices, error, original_error)
+				&& error <= original_error;
+			if (error == 0.0 && original_error == 0.0)
+				std::printf("%11s %9s\n", "MISMATCH", "-");
+			else
+				std::printf("%11.3f %9.3f%s\n", error, original_error, ok ? "" : "!");
+			passed = passed && ok;
+		}
+		else
+			std::printf("%11s %9s\n", "-", "-");
+
+		original_vertices = std::vector<Vertex>();
+		original_indices = std::vector<unsigned int>();
+		map.indices = std::vector<unsigned int>();
+		chunk_results.push_back(bench_chunks(name, map));
+		ground_results.push_back(bench_ground(name, map));
+		normal_results.push_back(bench_normal_map(name, map));
+		displaced_results.push_back(bench_displaced(name, pixels, map, build_ms));
+
+		// the same chunks as strips, and the whole grid in every layout (the extra copy of the indices doesn't fit at 8k)
+		map.topology = HeightmapCore::TOPOLOGY_STRIPS;
+		chunk_results.push_back(bench_chunks((std::string(name) + " strips").c_str(), map));
+		if (size <= 4096)
+			topology_sizes.push_back(size);
+	}
+
+	passed = print_chunks(chunk_results) && passed;
+	passed = print_ground(ground_results) && passed;
+	passed = print_displaced(displaced_results) && passed;
+	passed = print_normal_maps(normal_results) && passed;
+
+	std::printf("\n%-12s %-12s %12s %9s %8s %9s %12s %7s %12s %7s %9s %9s\n", "topology", "layout", "indices", "index MB", "vs list",
+		"build ms", "VS runs 16", "ACMR", "VS runs 32", "ACMR", "chunk 16", "chunk 32");
+	for (size_t i = 0; i < topology_sizes.size(); i++)
+	{
+		int size = topology_sizes[i];
+		std::vector<unsigned char> pixels = generate_image(size, size, 1);
+		HeightmapCore map;
+		map.create_heightmap(&pixels[0], size, size, 1);
+		map.create_indices();
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "%dx%d", size, size);
+		bench_topology(name, map);
+	}
+
+	// build scaling on the smallest size, at least 4 threads so the
+	// split is exercised even on a machine with fewer cores
+	int smallest = *std::min_element(sizes.begin(), sizes.end());
+	unsigned int max_threads = std::max(4u, ThreadPool::shared().size() + 1);
+	if (!bench_scaling(generate_image(smallest, smallest, 1), smallest, max_threads))
+	{
+		std::printf("different mesh on more than one thread\n");
+		passed = false;
+	}
+
+	if (!passed)
+		std::printf("\nFAILED\n");
+	return passed ? 0 : 1;
+}
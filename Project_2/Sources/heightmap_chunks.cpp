@@ -0,0 +1,500 @@
+/*** @file heightmap_chunks.cpp
+*
+*   @brief Geomipmapped heightmap: chunks, their levels of detail and per frame selection
+*
+*   The grid is split into chunks of CHUNK_SIZE x CHUNK_SIZE cells. Level l of a chunk keeps
+*   every 2^l-th row and column plus its last one, so every level of every chunk shares the
+*   vertex buffer of the full grid and only the indices change. The indices of a chunk only
+*   depend on its size, so they are made once per chunk shape and drawn with the chunk's
+*   first vertex as base vertex.
+*
+*   Each level has 16 patterns, one for every combination of sides that meet a chunk one
+*   level coarser. On such a side the outer ring of triangles uses the coarser level's vertices,
+*   so both chunks have the same edge and no cracks open up between them. select_chunks()
+*   keeps neighbouring levels at most one apart so these patterns are all it needs.
+**/
+
+#include <heightmap_core.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+
+// rows (or columns) of a chunk that are left at a level: every 2^level-th one and the last one,
+// always at least the first, one in the middle and the last so there is an inside to stitch to
+static std::vector<int> level_positions(int cells, int level)
+{
+	int step = std::max(1, std::min(1 << level, cells / 2));
+
+	std::vector<int> positions;
+	for (int position = 0; position < cells; position += step)
+		positions.push_back(position);
+	positions.push_back(cells);
+	return positions;
+}
+
+// triangle between three (row, column) points of a chunk, turned to face up like the full grid
+static void add_triangle(std::vector<unsigned int>& out, int width, glm::ivec2 a, glm::ivec2 b, glm::ivec2 c)
+{
+	// rows run along x and columns along z, so the triangle faces +y when this is positive
+	int turn = (b.y - a.y) * (c.x - a.x) - (b.x - a.x) * (c.y - a.y);
+	if (turn == 0) return;
+	if (turn < 0) std::swap(b, c);
+
+	out.push_back(a.x * width + a.y);
+	out.push_back(b.x * width + b.y);
+	out.push_back(c.x * width + c.y);
+}
+
+// Triangles between one side of a chunk and the first line of vertices inside it. The two lines
+// can have different spacing, so walk along both and always step the one whose next vertex is nearer.
+// along is 1 when the side runs along a row (the points differ in column), 0 when it runs along a column.
+static void stitch_side(std::vector<unsigned int>& out, int width, const std::vector<glm::ivec2>& edge,
+	const std::vector<glm::ivec2>& inner, int along)
+{
+	size_t i = 0, j = 0;
+	while (i + 1 < edge.size() || j + 1 < inner.size())
+	{
+		bool step_edge = j + 1 == inner.size()
+			|| (i + 1 < edge.size() && edge[i + 1][along] <= inner[j + 1][along]);
+
+		if (step_edge)
+		{
+			add_triangle(out, width, edge[i], inner[j], edge[i + 1]);
+			i++;
+		}
+		else
+		{
+			add_triangle(out, width, edge[i], inner[j], inner[j + 1]);
+			j++;
+		}
+	}
+}
+
+// The triangles of a chunk of rows x columns cells at a level, with the sides in stitch using level + 1.
+// With strips the inside goes there as strips, like HeightmapCore::build_strips() makes them for the whole
+// grid, and only the ring is left in out. Returns the number of triangles in strips.
+static size_t build_pattern(std::vector<unsigned int>& out, std::vector<unsigned int>* strips, int width,
+	int rows, int columns, int level, int stitch, int strip_block)
+{
+	std::vector<int> R = level_positions(rows, level);
+	std::vector<int> C = level_positions(columns, level);
+
+	// a single cell across, nothing to stitch to
+	if (R.size() < 3 || C.size() < 3)
+	{
+		for (size_t i = 0; i + 1 < R.size(); i++)
+			for (size_t j = 0; j + 1 < C.size(); j++)
+			{
+				add_triangle(out, width, glm::ivec2(R[i], C[j]), glm::ivec2(R[i], C[j + 1]), glm::ivec2(R[i + 1], C[j]));
+				add_triangle(out, width, glm::ivec2(R[i], C[j + 1]), glm::ivec2(R[i + 1], C[j + 1]), glm::ivec2(R[i + 1], C[j]));
+			}
+		return 0;
+	}
+
+	// the inside is a regular grid split like the full one, in blocks of strip_block columns done row after row
+	size_t block = strip_block > 0 ? (size_t)strip_block : C.size();
+	size_t stripped = 0;
+	for (size_t start = 1; start + 2 < C.size(); start += block)
+	{
+		size_t end = std::min(start + block, C.size() - 2);
+		if (strips == NULL)
+		{
+			for (size_t i = 1; i + 2 < R.size(); i++)
+				for (size_t j = start; j < end; j++)
+				{
+					add_triangle(out, width, glm::ivec2(R[i], C[j]), glm::ivec2(R[i], C[j + 1]), glm::ivec2(R[i + 1], C[j]));
+					add_triangle(out, width, glm::ivec2(R[i], C[j + 1]), glm::ivec2(R[i + 1], C[j + 1]), glm::ivec2(R[i + 1], C[j]));
+				}
+			continue;
+		}
+
+		// the block's first row loaded into the cache, then a strip per row starting on an odd triangle
+		if (strip_block > 0)
+		{
+			for (size_t j = start; j <= end; j++)
+			{
+				strips->push_back(R[1] * width + C[j]);
+				strips->push_back(R[1] * width + C[j]);
+			}
+			strips->push_back(HeightmapCore::RESTART_INDEX);
+		}
+		for (size_t i = 1; i + 2 < R.size(); i++)
+		{
+			strips->push_back(R[i] * width + C[start]);
+			for (size_t j = start; j <= end; j++)
+			{
+				strips->push_back(R[i] * width + C[j]);
+				strips->push_back(R[i + 1] * width + C[j]);
+			}
+			strips->push_back(HeightmapCore::RESTART_INDEX);
+			stripped += 2 * (end - start);
+		}
+	}
+
+	// the ring around it, four trapezoids that meet on the diagonals of the corner cells
+	std::vector<int> top = level_positions(columns, stitch & HeightmapCore::STITCH_TOP ? level + 1 : level);
+	std::vector<int> bottom = level_positions(columns, stitch & HeightmapCore::STITCH_BOTTOM ? level + 1 : level);
+	std::vector<int> left = level_positions(rows, stitch & HeightmapCore::STITCH_LEFT ? level + 1 : level);
+	std::vector<int> right = level_positions(rows, stitch & HeightmapCore::STITCH_RIGHT ? level + 1 : level);
+
+	std::vector<glm::ivec2> edge, inner;
+
+	edge.clear(); inner.clear();
+	for (size_t j = 0; j < top.size(); j++) edge.push_back(glm::ivec2(0, top[j]));
+	for (size_t j = 1; j + 1 < C.size(); j++) inner.push_back(glm::ivec2(R[1], C[j]));
+	stitch_side(out, width, edge, inner, 1);
+
+	edge.clear(); inner.clear();
+	for (size_t j = 0; j < bottom.size(); j++) edge.push_back(glm::ivec2(rows, bottom[j]));
+	for (size_t j = 1; j + 1 < C.size(); j++) inner.push_back(glm::ivec2(R[R.size() - 2], C[j]));
+	stitch_side(out, width, edge, inner, 1);
+
+	edge.clear(); inner.clear();
+	for (size_t i = 0; i < left.size(); i++) edge.push_back(glm::ivec2(left[i], 0));
+	for (size_t i = 1; i + 1 < R.size(); i++) inner.push_back(glm::ivec2(R[i], C[1]));
+	stitch_side(out, width, edge, inner, 0);
+
+	edge.clear(); inner.clear();
+	for (size_t i = 0; i < right.size(); i++) edge.push_back(glm::ivec2(right[i], columns));
+	for (size_t i = 1; i + 1 < R.size(); i++) inner.push_back(glm::ivec2(R[i], C[C.size() - 2]));
+	stitch_side(out, width, edge, inner, 0);
+	return stripped;
+}
+
+// true if the triangle has the edge p -> q in its turn, and its third vertex in third
+static bool find_edge(const unsigned int* triangle, unsigned int p, unsigned int q, unsigned int& third)
+{
+	for (int k = 0; k < 3; k++)
+	{
+		if (triangle[k] == p && triangle[(k + 1) % 3] == q)
+		{
+			third = triangle[(k + 2) % 3];
+			return true;
+		}
+	}
+	return false;
+}
+
+// One strip from triangles[t], [t + 1], ... for as long as each next triangle continues it, and how many it took.
+// A strip turns every other triangle around, so triangle i is (v[i], v[i + 1], v[i + 2]) when i is even and
+// (v[i + 1], v[i], v[i + 2]) when it is odd. Starting odd costs one more index, a degenerate first triangle,
+// but is the only way to follow a row of cells split along the same diagonal.
+static size_t grow_strip(const std::vector<unsigned int>& triangles, size_t t, bool odd, std::vector<unsigned int>& strip)
+{
+	// the edge shared with the next triangle, first[k] -> first[k + 1], has to be the last two vertices
+	const unsigned int* first = &triangles[t];
+	int k = 0;
+	unsigned int third;
+	for (int e = 0; e < 3 && t + 3 < triangles.size(); e++)
+		if (find_edge(&triangles[t + 3], first[(e + 1) % 3], first[e], third))
+			k = e;
+
+	unsigned int a = first[k], b = first[(k + 1) % 3], c = first[(k + 2) % 3];
+	strip.clear();
+	if (odd)
+	{
+		// (c, c, b, a): triangle 1 is (b, c, a)
+		strip.push_back(c); strip.push_back(c); strip.push_back(b); strip.push_back(a);
+	}
+	else
+	{
+		strip.push_back(c); strip.push_back(a); strip.push_back(b);
+	}
+
+	size_t taken = 1;
+	for (size_t next = t + 3; next < triangles.size(); next += 3, taken++)
+	{
+		size_t n = strip.size();
+		unsigned int p = strip[n - 2], q = strip[n - 1];
+		if ((n - 2) % 2 == 1) std::swap(p, q);
+		if (!find_edge(&triangles[next], p, q, third)) break;
+		strip.push_back(third);
+	}
+	return taken;
+}
+
+// a triangle list as strips separated by the restart index, greedily in the order the triangles come
+static void append_strips(std::vector<unsigned int>& out, const std::vector<unsigned int>& triangles)
+{
+	std::vector<unsigned int> even, odd;
+	for (size_t t = 0; t < triangles.size();)
+	{
+		size_t taken_even = grow_strip(triangles, t, false, even);
+		size_t taken_odd = grow_strip(triangles, t, true, odd);
+		const std::vector<unsigned int>& strip = taken_odd > taken_even ? odd : even;
+
+		if (t > 0) out.push_back(HeightmapCore::RESTART_INDEX);
+		out.insert(out.end(), strip.begin(), strip.end());
+		t += 3 * std::max(taken_even, taken_odd);
+	}
+}
+
+void HeightmapCore::build_chunks()
+{
+	chunks.clear();
+	chunk_indices.clear();
+	pattern_first.clear();
+	pattern_count.clear();
+	pattern_triangles.clear();
+	chunk_level.clear();
+	chunk_draws.clear();
+	chunk_triangles = 0;
+	if (heights.empty()) return;
+
+	// the last chunk of a row or column takes the cells left over, so none is smaller than CHUNK_SIZE
+	int cell_rows = height - 1, cell_columns = width - 1;
+	chunk_rows = std::max(1, cell_rows / CHUNK_SIZE);
+	chunk_columns = std::max(1, cell_columns / CHUNK_SIZE);
+
+	// shape bit 1: last row of chunks, bit 2: last column
+	int shape_rows[2] = { std::min(CHUNK_SIZE, cell_rows), cell_rows - CHUNK_SIZE * (chunk_rows - 1) };
+	int shape_columns[2] = { std::min(CHUNK_SIZE, cell_columns), cell_columns - CHUNK_SIZE * (chunk_columns - 1) };
+
+	std::vector<unsigned int> triangles;
+	for (int shape = 0; shape < 4; shape++)
+		for (int level = 0; level < LOD_LEVELS; level++)
+			for (int stitch = 0; stitch < STITCH_MASKS; stitch++)
+			{
+				pattern_first.push_back((unsigned int)chunk_indices.size());
+
+				// the strips go straight to the end of chunk_indices, the rest comes after them
+				triangles.clear();
+				size_t stripped = build_pattern(triangles, topology == TOPOLOGY_STRIPS ? &chunk_indices : NULL, width,
+					shape_rows[shape & 1], shape_columns[shape >> 1], level, stitch, strip_block);
+				if (topology == TOPOLOGY_STRIPS)
+					append_strips(chunk_indices, triangles);
+				else
+					chunk_indices.insert(chunk_indices.end(), triangles.begin(), triangles.end());
+
+				pattern_count.push_back((unsigned int)chunk_indices.size() - pattern_first.back());
+				pattern_triangles.push_back((unsigned int)(stripped + triangles.size() / 3));
+			}
+
+	chunks.resize((size_t)chunk_rows * chunk_columns);
+	for (int i = 0; i < chunk_rows; i++)
+		for (int j = 0; j < chunk_columns; j++)
+		{
+			Chunk& chunk = chunks[(size_t)i * chunk_columns + j];
+			chunk.shape = (i == chunk_rows - 1 ? 1 : 0) | (j == chunk_columns - 1 ? 2 : 0);
+			chunk.row = i * CHUNK_SIZE;
+			chunk.column = j * CHUNK_SIZE;
+			chunk.rows = shape_rows[chunk.shape & 1];
+			chunk.columns = shape_columns[chunk.shape >> 1];
+		}
+
+	// bounds and the error of every level, each chunk on its own
+	ThreadPool::shared().parallel_for(0, chunks.size(), [this](size_t first, size_t last)
+	{
+		for (size_t k = first; k < last; k++)
+		{
+			Chunk& chunk = chunks[k];
+
+			float low = 1.0f, high = 0.0f;
+			for (int r = 0; r <= chunk.rows; r++)
+				for (int c = 0; c <= chunk.columns; c++)
+				{
+					float h = heights[(size_t)(chunk.row + r) * width + chunk.column + c];
+					low = std::min(low, h);
+					high = std::max(high, h);
+				}
+			chunk.lower = vertices[(size_t)chunk.row * width + chunk.column].Position;
+			chunk.upper = vertices[(size_t)(chunk.row + chunk.rows) * width + chunk.column + chunk.columns].Position;
+			chunk.lower.y = low;
+			chunk.upper.y = high;
+
+			// how far every vertex is from the triangles of the level, the same split as the full grid
+			// (the outer ring is triangulated differently, close enough to pick a level by)
+			chunk.error[0] = 0.0f;
+			for (int level = 1; level < LOD_LEVELS; level++)
+			{
+				std::vector<int> R = level_positions(chunk.rows, level);
+				std::vector<int> C = level_positions(chunk.columns, level);
+
+				float error = 0.0f;
+				for (size_t i = 0; i + 1 < R.size(); i++)
+					for (size_t j = 0; j + 1 < C.size(); j++)
+					{
+						float h00 = height_at(chunk.row + R[i], chunk.column + C[j]);
+						float h01 = height_at(chunk.row + R[i], chunk.column + C[j + 1]);
+						float h10 = height_at(chunk.row + R[i + 1], chunk.column + C[j]);
+						float h11 = height_at(chunk.row + R[i + 1], chunk.column + C[j + 1]);
+
+						for (int r = R[i]; r <= R[i + 1]; r++)
+							for (int c = C[j]; c <= C[j + 1]; c++)
+							{
+								float u = float(r - R[i]) / float(R[i + 1] - R[i]);
+								float v = float(c - C[j]) / float(C[j + 1] - C[j]);
+								float flat = u + v <= 1.0f ? h00 + v * (h01 - h00) + u * (h10 - h00)
+									: h11 + (1.0f - v) * (h10 - h11) + (1.0f - u) * (h01 - h11);
+								error = std::max(error, std::fabs(heights[(size_t)(chunk.row + r) * width + chunk.column + c] - flat));
+							}
+					}
+
+				// a coarser level never looks better than a finer one
+				chunk.error[level] = std::max(error, chunk.error[level - 1]);
+			}
+		}
+	}, threads);
+
+	// everything at full detail until the first select_chunks()
+	chunk_level.assign(chunks.size(), 0);
+	for (size_t k = 0; k < chunks.size(); k++)
+	{
+		chunk_draws.push_back(chunk_draw(k));
+		chunk_triangles += chunk_draws.back().triangles;
+	}
+}
+
+void HeightmapCore::build_patch()
+{
+	patch_indices.clear();
+
+	// a chunk of PATCH_SIZE cells at full detail in a grid PATCH_SIZE + 1 vertices wide
+	std::vector<unsigned int> triangles;
+	build_pattern(triangles, topology == TOPOLOGY_STRIPS ? &patch_indices : NULL, PATCH_SIZE + 1, PATCH_SIZE, PATCH_SIZE, 0, 0, strip_block);
+	if (topology == TOPOLOGY_STRIPS)
+		append_strips(patch_indices, triangles);
+	else
+		patch_indices.insert(patch_indices.end(), triangles.begin(), triangles.end());
+}
+
+HeightmapCore::ChunkDraw HeightmapCore::chunk_draw(size_t k) const
+{
+	const Chunk& chunk = chunks[k];
+	int i = (int)(k / chunk_columns), j = (int)(k % chunk_columns);
+	int level = chunk_level[k];
+
+	// sides that meet a coarser neighbour use its vertices
+	int stitch = 0;
+	if (i > 0 && chunk_level[k - chunk_columns] > level) stitch |= STITCH_TOP;
+	if (i + 1 < chunk_rows && chunk_level[k + chunk_columns] > level) stitch |= STITCH_BOTTOM;
+	if (j > 0 && chunk_level[k - 1] > level) stitch |= STITCH_LEFT;
+	if (j + 1 < chunk_columns && chunk_level[k + 1] > level) stitch |= STITCH_RIGHT;
+
+	size_t pattern = ((size_t)chunk.shape * LOD_LEVELS + level) * STITCH_MASKS + stitch;
+
+	ChunkDraw draw;
+	draw.first = pattern_first[pattern];
+	draw.count = pattern_count[pattern];
+	draw.base_vertex = chunk.row * width + chunk.column;
+	draw.triangles = pattern_triangles[pattern];
+	return draw;
+}
+
+// the view frustum's planes in model space (Gribb & Hartmann), inside where dot(plane, (p, 1)) >= 0
+static void frustum_planes(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, glm::vec4 planes[6])
+{
+	glm::mat4 clip = projection * view * model;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (int side = 0; side < 2; side++)
+		{
+			float sign = side == 0 ? 1.0f : -1.0f;
+			glm::vec4& plane = planes[axis * 2 + side];
+			for (int column = 0; column < 4; column++)
+				plane[column] = clip[column][3] + sign * clip[column][axis];
+		}
+	}
+}
+
+// a box isn't completely behind one of the planes, the corner farthest along a plane's normal decides
+static bool in_frustum(const glm::vec4 planes[6], const glm::vec3& lower, const glm::vec3& upper)
+{
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = planes[p];
+		glm::vec3 farthest(plane.x > 0.0f ? upper.x : lower.x, plane.y > 0.0f ? upper.y : lower.y,
+			plane.z > 0.0f ? upper.z : lower.z);
+		if (plane.x * farthest.x + plane.y * farthest.y + plane.z * farthest.z + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void HeightmapCore::select_patches(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+	patch_draws.clear();
+	glm::vec4 planes[6];
+	frustum_planes(model, view, projection, planes);
+
+	for (int i = 0; i < patch_rows; i++)
+		for (int j = 0; j < patch_columns; j++)
+		{
+			size_t patch = (size_t)i * patch_columns + j;
+			glm::vec3 lower(row_x(i * PATCH_SIZE), patch_heights[patch].x, column_z(j * PATCH_SIZE));
+			glm::vec3 upper(row_x(std::min((i + 1) * PATCH_SIZE, height - 1)), patch_heights[patch].y,
+				column_z(std::min((j + 1) * PATCH_SIZE, width - 1)));
+			if (in_frustum(planes, lower, upper))
+				patch_draws.push_back((int)patch);
+		}
+}
+
+void HeightmapCore::select_chunks(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, float viewport_height)
+{
+	chunk_draws.clear();
+	chunk_triangles = 0;
+	if (chunks.empty()) return;
+
+	// camera position in world space, and how many pixels one unit covers one unit away
+	glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+	float pixels_per_unit = 0.5f * viewport_height * projection[1][1];
+	float vertical_scale = glm::length(glm::vec3(model[1]));
+
+	glm::vec4 planes[6];
+	frustum_planes(model, view, projection, planes);
+
+	// the coarsest level whose error stays under pixel_error at the chunk's nearest point
+	for (size_t k = 0; k < chunks.size(); k++)
+	{
+		const Chunk& chunk = chunks[k];
+
+		glm::vec3 lower(1.0e30f), upper(-1.0e30f);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 point(corner & 1 ? chunk.upper.x : chunk.lower.x, corner & 2 ? chunk.upper.y : chunk.lower.y,
+				corner & 4 ? chunk.upper.z : chunk.lower.z);
+			glm::vec3 world = glm::vec3(model * glm::vec4(point, 1.0f));
+			lower = glm::min(lower, world);
+			upper = glm::max(upper, world);
+		}
+		glm::vec3 outside = glm::max(glm::max(lower - eye, eye - upper), glm::vec3(0.0f));
+		float distance = glm::length(outside);
+
+		int level = 0;
+		while (level + 1 < LOD_LEVELS && chunk.error[level + 1] * vertical_scale * pixels_per_unit <= pixel_error * distance)
+			level++;
+		chunk_level[k] = level;
+	}
+
+	// neighbours at most one level apart, only ever lowers a level so it settles quickly
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (int i = 0; i < chunk_rows; i++)
+			for (int j = 0; j < chunk_columns; j++)
+			{
+				size_t k = (size_t)i * chunk_columns + j;
+				int level = chunk_level[k];
+				if (i > 0) level = std::min(level, chunk_level[k - chunk_columns] + 1);
+				if (i + 1 < chunk_rows) level = std::min(level, chunk_level[k + chunk_columns] + 1);
+				if (j > 0) level = std::min(level, chunk_level[k - 1] + 1);
+				if (j + 1 < chunk_columns) level = std::min(level, chunk_level[k + 1] + 1);
+				if (level != chunk_level[k])
+				{
+					chunk_level[k] = level;
+					changed = true;
+				}
+			}
+	}
+
+	// draw the chunks inside the frustum
+	for (size_t k = 0; k < chunks.size(); k++)
+	{
+		if (!in_frustum(planes, chunks[k].lower, chunks[k].upper)) continue;
+
+		chunk_draws.push_back(chunk_draw(k));
+		chunk_triangles += chunk_draws.back().triangles;
+	}
+}
@@ -0,0 +1,345 @@
+/*** @file heightmap_core.cpp
+*
+*   @brief GL-free part of the heightmap: height grid, terrain mesh and normals
+**/
+
+#include <heightmap_core.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+
+void HeightmapCore::reset(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	heights.clear();
+	vertices.clear();
+	indices.clear();
+	chunks.clear();
+	chunk_indices.clear();
+	chunk_draws.clear();
+	chunk_triangles = 0;
+	height_pixels.clear();
+	patch_heights.clear();
+	patch_vertices.clear();
+	patch_indices.clear();
+	patch_draws.clear();
+	patch_rows = patch_columns = 0;
+	normal_texels.clear();
+
+	// the longer side spans [-1, 1]
+	int longest = std::max(std::max(width, height) - 1, 1);
+	extent_x = float(height - 1) / float(longest);
+	extent_z = float(width - 1) / float(longest);
+}
+
+void HeightmapCore::create_heightmap(const unsigned char* pixels, int width, int height, int channels)
+{
+	mode = MODE_MESH;
+	reset(width, height);
+	if (pixels == NULL || width < 2 || height < 2 || channels < 1)
+		return;
+
+	// every buffer at its final size, the bands below only write into their own part
+	size_t count = (size_t)width * (size_t)height;
+	heights.resize(count);
+	vertices.resize(count);
+
+	// the normals of a row need the heights of its neighbours, so all heights go first
+	ThreadPool::shared().parallel_for(0, height, [this, pixels, channels](size_t first, size_t last)
+	{
+		build_heights(pixels, channels, (int)first, (int)last);
+	}, threads);
+
+	ThreadPool::shared().parallel_for(0, height, [this](size_t first, size_t last)
+	{
+		build_vertices((int)first, (int)last);
+	}, threads);
+
+	// the viewer only draws the chunk patterns, the whole grid as one list is left to create_indices()
+	build_chunks();
+	create_normal_map();
+}
+
+void HeightmapCore::create_displaced(const unsigned char* pixels, int width, int height, int channels)
+{
+	mode = MODE_DISPLACED;
+	reset(width, height);
+	if (pixels == NULL || width < 2 || height < 2 || channels < 1)
+		return;
+
+	height_pixels.resize((size_t)width * height);
+	ThreadPool::shared().parallel_for(0, height, [this, pixels, channels](size_t first, size_t last)
+	{
+		for (size_t row = first; row < last; row++)
+		{
+			const unsigned char* pixel = pixels + row * this->width * channels;
+			unsigned char* out = &height_pixels[row * this->width];
+			for (int column = 0; column < this->width; column++, pixel += channels)
+				out[column] = *pixel;
+		}
+	}, threads);
+
+	// the height range of every patch for culling, a patch includes its last row and column
+	patch_rows = (height - 2) / PATCH_SIZE + 1;
+	patch_columns = (width - 2) / PATCH_SIZE + 1;
+	patch_heights.resize((size_t)patch_rows * patch_columns);
+	ThreadPool::shared().parallel_for(0, patch_heights.size(), [this](size_t first, size_t last)
+	{
+		for (size_t patch = first; patch < last; patch++)
+		{
+			int row = (int)(patch / patch_columns) * PATCH_SIZE, column = (int)(patch % patch_columns) * PATCH_SIZE;
+			int last_row = std::min(row + PATCH_SIZE, this->height - 1), last_column = std::min(column + PATCH_SIZE, this->width - 1);
+
+			unsigned char low = 255, high = 0;
+			for (int r = row; r <= last_row; r++)
+				for (int c = column; c <= last_column; c++)
+				{
+					low = std::min(low, height_pixels[(size_t)r * this->width + c]);
+					high = std::max(high, height_pixels[(size_t)r * this->width + c]);
+				}
+			patch_heights[patch] = glm::vec2(low / 255.0f, high / 255.0f);
+		}
+	}, threads);
+
+	// (row, column) of every vertex of the flat patch
+	for (int r = 0; r <= PATCH_SIZE; r++)
+		for (int c = 0; c <= PATCH_SIZE; c++)
+		{
+			patch_vertices.push_back((unsigned char)r);
+			patch_vertices.push_back((unsigned char)c);
+		}
+	build_patch();
+
+	patch_draws.resize(patch_heights.size());
+	for (size_t patch = 0; patch < patch_draws.size(); patch++)
+		patch_draws[patch] = (int)patch;
+
+	create_normal_map();
+}
+
+void HeightmapCore::create_normal_map()
+{
+	normal_texels.resize((size_t)width * height * 2);
+	ThreadPool::shared().parallel_for(0, height, [this](size_t first, size_t last)
+	{
+		build_normal_map((int)first, (int)last);
+	}, threads);
+}
+
+Vertex HeightmapCore::displaced_vertex(int patch, int row, int column) const
+{
+	// the parts of the patches on the last row and column that stick out of the grid fold onto its edge
+	row = std::min(patch / patch_columns * PATCH_SIZE + row, height - 1);
+	column = std::min(patch % patch_columns * PATCH_SIZE + column, width - 1);
+
+	Vertex v;
+	v.Position = glm::vec3(row_x(row), height_at(row, column), column_z(column));
+	v.Normal = normal_at(row, column);
+	v.TexCoords = glm::vec2(float(row) / float(height - 1), float(column) / float(width - 1));
+	return v;
+}
+
+void HeightmapCore::create_indices()
+{
+	indices.clear();
+	if (heights.empty()) return;
+
+	if (topology == TOPOLOGY_TRIANGLES)
+	{
+		indices.resize((size_t)(width - 1) * (size_t)(height - 1) * 6);
+		ThreadPool::shared().parallel_for(0, height - 1, [this](size_t first, size_t last)
+		{
+			build_indices((int)first, (int)last);
+		}, threads);
+		return;
+	}
+
+	int block = strip_block > 0 ? std::min(strip_block, width - 1) : width - 1;
+	int blocks = (width - 2) / block + 1;
+	indices.resize((size_t)(blocks - 1) * strip_block_size(block) + strip_block_size(width - 1 - (blocks - 1) * block));
+
+	ThreadPool::shared().parallel_for(0, blocks, [this](size_t first, size_t last)
+	{
+		build_strips((int)first, (int)last);
+	}, threads);
+}
+
+void HeightmapCore::build_heights(const unsigned char* pixels, int channels, int first, int last)
+{
+	for (int row = first; row < last; row++)
+	{
+		const unsigned char* pixel = pixels + (size_t)row * width * channels;
+		float* out = &heights[(size_t)row * width];
+		for (int column = 0; column < width; column++, pixel += channels)
+			out[column] = float(*pixel) / 255.0f;
+	}
+}
+
+glm::mat4 HeightmapCore::model_matrix() const
+{
+	glm::mat4 model;
+	model = glm::translate(model, glm::vec3(0.0f, -25.0f, 0.0f));
+	model = glm::scale(model, glm::vec3(30.0f, 10.0f, 30.0f));
+	return model;
+}
+
+float HeightmapCore::row_x(int row) const
+{
+	return (2.0f*(float(row) / float(height - 1)) - 1.0f) * extent_x;
+}
+
+float HeightmapCore::column_z(int column) const
+{
+	return (2.0f*(float(column) / float(width - 1)) - 1.0f) * extent_z;
+}
+
+float HeightmapCore::height_at(int row, int column) const
+{
+	row = std::min(std::max(row, 0), height - 1);
+	column = std::min(std::max(column, 0), width - 1);
+	if (mode == MODE_DISPLACED)
+		return height_pixels[(size_t)row * width + column] / 255.0f;
+	return heights[(size_t)row * width + column];
+}
+
+glm::vec3 HeightmapCore::normal_at(int row, int column) const
+{
+	// central differences, one sided on the border. Each one is the 1-2-1 weighted mean of the
+	// differences across the neighbouring rows/columns too (a Sobel filter), a single difference of
+	// 8 bit heights only has a few possible values and the lighting shows every step
+	int up = std::min(row + 1, height - 1), down = std::max(row - 1, 0);
+	int right = std::min(column + 1, width - 1), left = std::max(column - 1, 0);
+
+	float step_x = 2.0f * extent_x / float(height - 1);
+	float step_z = 2.0f * extent_z / float(width - 1);
+
+	float rise_x = (height_at(up, left) + 2.0f * height_at(up, column) + height_at(up, right))
+		- (height_at(down, left) + 2.0f * height_at(down, column) + height_at(down, right));
+	float rise_z = (height_at(down, right) + 2.0f * height_at(row, right) + height_at(up, right))
+		- (height_at(down, left) + 2.0f * height_at(row, left) + height_at(up, left));
+
+	float slope_x = rise_x / (4.0f * float(up - down) * step_x);
+	float slope_z = rise_z / (4.0f * float(right - left) * step_z);
+
+	// surface y = h(x, z) has the normal (-dh/dx, 1, -dh/dz)
+	return glm::normalize(glm::vec3(-slope_x, 1.0f, -slope_z));
+}
+
+void HeightmapCore::build_normal_map(int first, int last)
+{
+	for (int row = first; row < last; row++)
+	{
+		unsigned char* out = &normal_texels[(size_t)row * width * 2];
+		for (int column = 0; column < width; column++, out += 2)
+		{
+			glm::vec3 normal = normal_at(row, column);
+			out[0] = (unsigned char)((normal.x + 1.0f) * 127.5f + 0.5f);
+			out[1] = (unsigned char)((normal.z + 1.0f) * 127.5f + 0.5f);
+		}
+	}
+}
+
+glm::vec3 HeightmapCore::normal_texel(int row, int column) const
+{
+	const unsigned char* texel = &normal_texels[((size_t)row * width + column) * 2];
+	float x = texel[0] / 255.0f * 2.0f - 1.0f, z = texel[1] / 255.0f * 2.0f - 1.0f;
+	return glm::normalize(glm::vec3(x, std::sqrt(std::max(1.0f - x * x - z * z, 0.0f)), z));
+}
+
+void HeightmapCore::build_vertices(int first, int last)
+{
+	for (int row = first; row < last; row++)
+	{
+		Vertex* out = &vertices[(size_t)row * width];
+		for (int column = 0; column < width; column++)
+		{
+			Vertex& v = out[column];
+			//XYZ coords
+			v.Position.x = row_x(row);
+			v.Position.y = heights[(size_t)row * width + column];
+			v.Position.z = column_z(column);
+
+			v.Normal = normal_at(row, column);
+
+			//Texture Coords
+			v.TexCoords.x = float(row) / float(height - 1);
+			v.TexCoords.y = float(column) / float(width - 1);
+		}
+	}
+}
+
+void HeightmapCore::build_indices(int first, int last)
+{
+	for (int row = first; row < last; row++)
+	{
+		unsigned int* out = &indices[(size_t)row * (width - 1) * 6];
+		for (int column = 0; column < width - 1; column++)
+		{
+			unsigned int a, b, c, d;
+			a = row*width + column;
+			b = a + 1;
+			c = a + width;
+			d = c + 1;
+
+			// Triangle 1
+			*out++ = a;
+			*out++ = b;
+			*out++ = c;
+
+			// Triangle 2
+			*out++ = b;
+			*out++ = d;
+			*out++ = c;
+		}
+	}
+}
+
+size_t HeightmapCore::strip_block_size(int columns) const
+{
+	// a strip per row: the first vertex twice, two vertices per column and the restart index,
+	// and in blocks the first row once more to load the cache
+	size_t size = (size_t)(height - 1) * (2 * columns + 4);
+	if (strip_block > 0)
+		size += 2 * (columns + 1) + 1;
+	return size;
+}
+
+void HeightmapCore::build_strips(int first, int last)
+{
+	int block = strip_block > 0 ? std::min(strip_block, width - 1) : width - 1;
+	for (int b = first; b < last; b++)
+	{
+		int start = b * block, end = std::min(start + block, width - 1);
+		unsigned int* out = &indices[(size_t)b * strip_block_size(block)];
+
+		// Every vertex of the first row twice, degenerate triangles only. Each strip reuses the row the one
+		// before it loaded, but the first strip of a block loads two rows, enough to push its own first
+		// vertices out of a cache that holds a row or two before the next strip gets to them.
+		if (strip_block > 0)
+		{
+			for (int column = start; column <= end; column++)
+			{
+				*out++ = column;
+				*out++ = column;
+			}
+			*out++ = RESTART_INDEX;
+		}
+
+		for (int row = 0; row < height - 1; row++)
+		{
+			// The strip zigzags between this row and the next, (a, c, b, d) of every cell, which splits the
+			// cells along b-c like the triangle list. Repeating the first vertex makes a degenerate triangle
+			// so the real ones start on an odd triangle and face up like the list's.
+			*out++ = row * width + start;
+			for (int column = start; column <= end; column++)
+			{
+				*out++ = row * width + column;
+				*out++ = (row + 1) * width + column;
+			}
+			*out++ = RESTART_INDEX;
+		}
+	}
+}
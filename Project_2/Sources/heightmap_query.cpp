@@ -0,0 +1,260 @@
+/*** @file heightmap_query.cpp
+*
+*   @brief Ground height and normal of the heightmap under world space points
+*
+*   A point's x and z go through the inverse of model_matrix() to a position between the pixels,
+*   and the height and the vertex normal are bilinearly filtered from the four pixels around it.
+*   The batch version does four points at a time with SSE2 when the compiler has it: the transform,
+*   the clamping, the weights and the filtering in registers, only the pixel reads one at a time.
+**/
+
+#include <heightmap_core.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEIGHTMAP_SSE2 1
+#endif
+
+
+// world to pixel space and back, model_matrix() only scales and moves the grid
+struct GroundMapping
+{
+	// row = x * row_scale + row_offset, column = z * column_scale + column_offset
+	float row_scale, row_offset, column_scale, column_offset;
+	// world height = height * height_scale + height_offset
+	float height_scale, height_offset;
+	// a model space normal times this, normalized, is the world space normal
+	glm::vec3 normal_scale;
+	// largest row and column of the pixels
+	float last_row, last_column;
+};
+
+static GroundMapping ground_mapping(const HeightmapCore& map)
+{
+	glm::mat4 model = map.model_matrix();
+
+	// model x = (2 row / (height - 1) - 1) extent_x, world x = model x * model[0][0] + model[3][0]
+	GroundMapping m;
+	m.row_scale = float(map.height - 1) / (2.0f * map.extent_x * model[0][0]);
+	m.row_offset = 0.5f * float(map.height - 1) - model[3][0] * m.row_scale;
+	m.column_scale = float(map.width - 1) / (2.0f * map.extent_z * model[2][2]);
+	m.column_offset = 0.5f * float(map.width - 1) - model[3][2] * m.column_scale;
+	m.height_scale = model[1][1];
+	m.height_offset = model[3][1];
+	m.normal_scale = glm::vec3(1.0f / model[0][0], 1.0f / model[1][1], 1.0f / model[2][2]);
+	m.last_row = float(map.height - 1);
+	m.last_column = float(map.width - 1);
+	return m;
+}
+
+// the cell a point is in and where in it, the last row and column belong to the cell before them
+static void ground_cell(const GroundMapping& m, glm::vec2 point, float& row0, float& column0, float& u, float& v)
+{
+	float row = std::min(std::max(point.x * m.row_scale + m.row_offset, 0.0f), m.last_row);
+	float column = std::min(std::max(point.y * m.column_scale + m.column_offset, 0.0f), m.last_column);
+	row0 = std::min(float(int(row)), m.last_row - 1.0f);
+	column0 = std::min(float(int(column)), m.last_column - 1.0f);
+	u = row - row0;
+	v = column - column0;
+}
+
+// one point, the order of the operations is the same as the four wide version so both give the same bits
+static void ground_point(const HeightmapCore& map, const GroundMapping& m, glm::vec2 point, float& height, glm::vec3* normal)
+{
+	float row0, column0, u, v;
+	ground_cell(m, point, row0, column0, u, v);
+
+	size_t i00 = (size_t)row0 * map.width + (size_t)column0, i01 = i00 + 1;
+	size_t i10 = i00 + map.width, i11 = i10 + 1;
+
+	const float* h = &map.heights[0];
+	float top = h[i00] + v * (h[i01] - h[i00]);
+	float bottom = h[i10] + v * (h[i11] - h[i10]);
+	height = (top + u * (bottom - top)) * m.height_scale + m.height_offset;
+
+	if (normal != NULL)
+	{
+		const Vertex* p = &map.vertices[0];
+		glm::vec3 n;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float n_top = p[i00].Normal[axis] + v * (p[i01].Normal[axis] - p[i00].Normal[axis]);
+			float n_bottom = p[i10].Normal[axis] + v * (p[i11].Normal[axis] - p[i10].Normal[axis]);
+			n[axis] = (n_top + u * (n_bottom - n_top)) * m.normal_scale[axis];
+		}
+		float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		*normal = n / length;
+	}
+}
+
+// MODE_DISPLACED keeps neither float heights nor vertex normals, the same from the pixels
+static void ground_point_displaced(const HeightmapCore& map, const GroundMapping& m, glm::vec2 point, float& height, glm::vec3* normal)
+{
+	float row0, column0, u, v;
+	ground_cell(m, point, row0, column0, u, v);
+	int r = (int)row0, c = (int)column0;
+
+	float h00 = map.height_at(r, c), h01 = map.height_at(r, c + 1), h10 = map.height_at(r + 1, c), h11 = map.height_at(r + 1, c + 1);
+	float top = h00 + v * (h01 - h00);
+	float bottom = h10 + v * (h11 - h10);
+	height = (top + u * (bottom - top)) * m.height_scale + m.height_offset;
+
+	if (normal != NULL)
+	{
+		glm::vec3 n00 = map.normal_at(r, c), n01 = map.normal_at(r, c + 1), n10 = map.normal_at(r + 1, c), n11 = map.normal_at(r + 1, c + 1);
+		glm::vec3 n;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float n_top = n00[axis] + v * (n01[axis] - n00[axis]);
+			float n_bottom = n10[axis] + v * (n11[axis] - n10[axis]);
+			n[axis] = (n_top + u * (n_bottom - n_top)) * m.normal_scale[axis];
+		}
+		float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		*normal = n / length;
+	}
+}
+
+// points [first, last) one at a time
+static void ground_points(const HeightmapCore& map, const GroundMapping& m, const glm::vec2* points, size_t first, size_t last,
+	float* heights, glm::vec3* normals)
+{
+	for (size_t i = first; i < last; i++)
+	{
+		if (map.mode == HeightmapCore::MODE_DISPLACED)
+			ground_point_displaced(map, m, points[i], heights[i], normals != NULL ? &normals[i] : NULL);
+		else
+			ground_point(map, m, points[i], heights[i], normals != NULL ? &normals[i] : NULL);
+	}
+}
+
+#ifdef HEIGHTMAP_SSE2
+// points [first, last) four at a time, the rest one at a time
+static void ground_points_sse2(const HeightmapCore& map, const GroundMapping& m, const glm::vec2* points, size_t first, size_t last,
+	float* heights, glm::vec3* normals)
+{
+	const __m128 row_scale = _mm_set1_ps(m.row_scale), row_offset = _mm_set1_ps(m.row_offset);
+	const __m128 column_scale = _mm_set1_ps(m.column_scale), column_offset = _mm_set1_ps(m.column_offset);
+	const __m128 last_row = _mm_set1_ps(m.last_row), last_column = _mm_set1_ps(m.last_column);
+	const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+	const __m128 height_scale = _mm_set1_ps(m.height_scale), height_offset = _mm_set1_ps(m.height_offset);
+
+	const float* h = &map.heights[0];
+	const Vertex* p = &map.vertices[0];
+
+	size_t i = first;
+	for (; i + 4 <= last; i += 4)
+	{
+		// x0 z0 x1 z1 and x2 z2 x3 z3 to four x and four z
+		__m128 a = _mm_loadu_ps(&points[i].x), b = _mm_loadu_ps(&points[i + 2].x);
+		__m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		__m128 z = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+		__m128 row = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(x, row_scale), row_offset), zero), last_row);
+		__m128 column = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(z, column_scale), column_offset), zero), last_column);
+		__m128 row0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(row)), _mm_sub_ps(last_row, one));
+		__m128 column0 = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(column)), _mm_sub_ps(last_column, one));
+		__m128 u = _mm_sub_ps(row, row0), v = _mm_sub_ps(column, column0);
+
+		// the corners one point at a time, the first pixel's index doesn't fit in a float on big maps
+		alignas(16) int rows[4], columns[4];
+		_mm_store_si128((__m128i*)rows, _mm_cvttps_epi32(row0));
+		_mm_store_si128((__m128i*)columns, _mm_cvttps_epi32(column0));
+		size_t index[4];
+		alignas(16) float h00[4], h01[4], h10[4], h11[4];
+		for (int k = 0; k < 4; k++)
+		{
+			index[k] = (size_t)rows[k] * map.width + (size_t)columns[k];
+			h00[k] = h[index[k]];
+			h01[k] = h[index[k] + 1];
+			h10[k] = h[index[k] + map.width];
+			h11[k] = h[index[k] + map.width + 1];
+		}
+
+		__m128 c00 = _mm_load_ps(h00), c01 = _mm_load_ps(h01), c10 = _mm_load_ps(h10), c11 = _mm_load_ps(h11);
+		__m128 top = _mm_add_ps(c00, _mm_mul_ps(v, _mm_sub_ps(c01, c00)));
+		__m128 bottom = _mm_add_ps(c10, _mm_mul_ps(v, _mm_sub_ps(c11, c10)));
+		__m128 height = _mm_add_ps(_mm_mul_ps(_mm_add_ps(top, _mm_mul_ps(u, _mm_sub_ps(bottom, top))), height_scale), height_offset);
+		_mm_storeu_ps(&heights[i], height);
+
+		if (normals == NULL) continue;
+
+		__m128 n[3];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			alignas(16) float n00[4], n01[4], n10[4], n11[4];
+			for (int k = 0; k < 4; k++)
+			{
+				n00[k] = p[index[k]].Normal[axis];
+				n01[k] = p[index[k] + 1].Normal[axis];
+				n10[k] = p[index[k] + map.width].Normal[axis];
+				n11[k] = p[index[k] + map.width + 1].Normal[axis];
+			}
+			c00 = _mm_load_ps(n00); c01 = _mm_load_ps(n01); c10 = _mm_load_ps(n10); c11 = _mm_load_ps(n11);
+			top = _mm_add_ps(c00, _mm_mul_ps(v, _mm_sub_ps(c01, c00)));
+			bottom = _mm_add_ps(c10, _mm_mul_ps(v, _mm_sub_ps(c11, c10)));
+			n[axis] = _mm_mul_ps(_mm_add_ps(top, _mm_mul_ps(u, _mm_sub_ps(bottom, top))), _mm_set1_ps(m.normal_scale[axis]));
+		}
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], n[0]), _mm_mul_ps(n[1], n[1])), _mm_mul_ps(n[2], n[2])));
+
+		alignas(16) float out[3][4];
+		for (int axis = 0; axis < 3; axis++)
+			_mm_store_ps(out[axis], _mm_div_ps(n[axis], length));
+		for (int k = 0; k < 4; k++)
+			normals[i + k] = glm::vec3(out[0][k], out[1][k], out[2][k]);
+	}
+
+	ground_points(map, m, points, i, last, heights, normals);
+}
+#endif
+
+float HeightmapCore::ground_height(glm::vec2 point, glm::vec3* normal) const
+{
+	float height;
+	ground_heights(&point, 1, &height, normal, false);
+	return height;
+}
+
+void HeightmapCore::ground_heights(const glm::vec2* points, size_t count, float* heights, glm::vec3* normals, bool simd) const
+{
+	if (mode == MODE_MESH ? this->heights.empty() : height_pixels.empty())
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			heights[i] = 0.0f;
+			if (normals != NULL) normals[i] = glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+		return;
+	}
+
+	GroundMapping m = ground_mapping(*this);
+	auto body = [this, &m, points, heights, normals, simd](size_t first, size_t last)
+	{
+#ifdef HEIGHTMAP_SSE2
+		if (simd && mode == MODE_MESH)
+		{
+			ground_points_sse2(*this, m, points, first, last, heights, normals);
+			return;
+		}
+#endif
+		ground_points(*this, m, points, first, last, heights, normals);
+	};
+
+	// a few thousand points take less time than waking the pool
+	if (count < 16384)
+		body(0, count);
+	else
+		ThreadPool::shared().parallel_for(0, count, body, threads);
+}
+
+bool HeightmapCore::ground_simd()
+{
+#ifdef HEIGHTMAP_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
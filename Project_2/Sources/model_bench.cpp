@@ -0,0 +1,485 @@
+/*** @file model_bench.cpp
+*
+*   @brief Headless benchmark for the model cache files (ModelCore)
+*
+*   Assimp isn't part of the headless build, so the meshes are generated with the sizes the
+*   shipped models import to (three vertices per triangle of the .obj, as Assimp makes them
+*   without aiProcess_JoinIdenticalVertices), next to copies of the shipped .obj and .mtl files.
+*   Times writing the cache and mapping it back, which is what the viewer does instead of
+*   Assimp on every start after the first; the viewer prints the Assimp time next to it.
+*
+*   Checks that the meshes come back byte for byte with their texture names, read where they
+*   are in the mapping, that the cache depends on the .obj and the material libraries it
+*   names, and that it is ignored once one of them changes, when it is truncated, from
+*   another version or has an index past its vertices. The exit code is 1 if any check fails.
+*
+*   The packing table shows what VertexPacked saves on the same meshes and how long packing
+*   takes at load. Checks that every half float comes back from a round trip, and that random
+*   tangent frames keep their normal and tangent within a fraction of a degree, the side of
+*   their bitangent, and their texture coordinates to half float precision.
+*
+*   The optimization table welds and reorders grids imported the way Assimp does it (every
+*   triangle its own vertices), in row order and shuffled, and shows the average cache miss
+*   ratio (ACMR) with a 16 entry FIFO before and after. Checks that the same triangles come
+*   out with the grid's vertices once each, in the order they are first used, and that the
+*   cache keeps the optimized meshes and their statistics.
+*
+*   usage: model_bench [media folder]
+*   e.g.   model_bench ../Project_2/Media/
+**/
+
+#include <model_core.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool report(const char* name, bool ok)
+{
+	std::printf("%-40s %s\n", name, ok ? "ok" : "WRONG");
+	return ok;
+}
+
+// triangles the faces of an .obj make once Assimp triangulates them, and the meshes (usemtl) they are in
+static size_t count_triangles(const std::string& path, size_t& meshes)
+{
+	std::ifstream file(path);
+	std::string line;
+	size_t triangles = 0;
+	meshes = 0;
+	while (std::getline(file, line))
+	{
+		if (line.compare(0, 2, "f ") == 0)
+		{
+			size_t corners = 0;
+			for (size_t i = 1; i < line.size(); i++)
+				if (line[i - 1] == ' ' && line[i] != ' ' && line[i] != '\r')
+					corners++;
+			if (corners >= 3)
+				triangles += corners - 2;
+		}
+		else if (line.compare(0, 7, "usemtl ") == 0)
+			meshes++;
+	}
+	meshes = std::max(meshes, (size_t)1);
+	return triangles;
+}
+
+// triangles split over meshes, three vertices each with every attribute set to something
+static void generate_meshes(ModelCore& model, size_t triangles, size_t meshes)
+{
+	model.mesh_data.assign(meshes, ModelCore::MeshData());
+	for (size_t m = 0; m < meshes; m++)
+	{
+		ModelCore::MeshData& mesh = model.mesh_data[m];
+		size_t count = triangles / meshes + (m < triangles % meshes ? 1 : 0);
+		mesh.vertices.resize(count * 3);
+		mesh.indices.resize(count * 3);
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+		{
+			float t = float(v + m * 7919);
+			VertexModel& vertex = mesh.vertices[v];
+			vertex.Position = glm::vec3(sin(t), cos(t * 0.7f), sin(t * 1.3f));
+			vertex.Normal = glm::normalize(vertex.Position + glm::vec3(0.1f));
+			vertex.TexCoords = glm::vec2(fmod(t * 0.01f, 1.0f), fmod(t * 0.017f, 1.0f));
+			vertex.Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+			vertex.Bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
+			mesh.indices[v] = (unsigned int)v;
+		}
+		ModelCore::TextureName diffuse = { "texture_diffuse", "mesh" + std::to_string(m) + "_dif.png" };
+		ModelCore::TextureName normal = { "texture_normal", "mesh" + std::to_string(m) + "_ddn.png" };
+		mesh.textures.push_back(diffuse);
+		mesh.textures.push_back(normal);
+	}
+}
+
+static bool same_meshes(const ModelCore& a, const ModelCore& b)
+{
+	if (a.mesh_data.size() != b.mesh_data.size()) return false;
+	for (size_t m = 0; m < a.mesh_data.size(); m++)
+	{
+		const ModelCore::MeshData& x = a.mesh_data[m];
+		const ModelCore::MeshData& y = b.mesh_data[m];
+		if (x.vertex_count() != y.vertex_count() || x.index_count() != y.index_count() || x.textures.size() != y.textures.size())
+			return false;
+		if (x.index_count() > 0 && memcmp(x.index_data(), y.index_data(), x.index_count() * sizeof(unsigned int)) != 0)
+			return false;
+		if (x.vertex_count() > 0 && memcmp(x.vertex_data(), y.vertex_data(), x.vertex_count() * sizeof(VertexModel)) != 0)
+			return false;
+		for (size_t t = 0; t < x.textures.size(); t++)
+			if (x.textures[t].type != y.textures[t].type || x.textures[t].path != y.textures[t].path)
+				return false;
+	}
+	return true;
+}
+
+// an n x n quad grid over a bumpy surface the way Assimp imports it, every triangle its own three
+// vertices (the same corner always gives the same bytes), the rows in order or the triangles shuffled
+static void generate_grid(ModelCore::MeshData& mesh, size_t n, bool shuffled)
+{
+	auto corner = [n](size_t x, size_t y) {
+		VertexModel vertex;
+		float fx = float(x), fy = float(y);
+		vertex.Position = glm::vec3(fx, sin(fx * 0.3f) * cos(fy * 0.2f), fy);
+		vertex.Normal = glm::normalize(glm::vec3(-0.3f * cos(fx * 0.3f) * cos(fy * 0.2f), 1.0f, 0.2f * sin(fx * 0.3f) * sin(fy * 0.2f)));
+		vertex.TexCoords = glm::vec2(fx / n, fy / n);
+		vertex.Tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+		vertex.Bitangent = glm::vec3(0.0f, 0.0f, 1.0f);
+		return vertex;
+	};
+
+	std::vector<size_t> order(n * n * 2);
+	for (size_t t = 0; t < order.size(); t++)
+		order[t] = t;
+	if (shuffled)
+	{
+		srand(7);
+		for (size_t t = order.size(); t > 1; t--)
+			std::swap(order[t - 1], order[(size_t)rand() % t]);
+	}
+
+	mesh = ModelCore::MeshData();
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		size_t x = order[i] / 2 % n, y = order[i] / 2 / n;
+		if (order[i] % 2 == 0)
+		{
+			mesh.vertices.push_back(corner(x, y));
+			mesh.vertices.push_back(corner(x, y + 1));
+			mesh.vertices.push_back(corner(x + 1, y));
+		}
+		else
+		{
+			mesh.vertices.push_back(corner(x + 1, y));
+			mesh.vertices.push_back(corner(x, y + 1));
+			mesh.vertices.push_back(corner(x + 1, y + 1));
+		}
+	}
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+		mesh.indices.push_back((unsigned int)v);
+}
+
+// the triangles of mesh as the bytes of their corners, each started at its smallest corner (winding
+// kept) and sorted, so two meshes with the same triangles in any order and indexing compare equal
+static std::vector<std::string> triangle_set(const ModelCore::MeshData& mesh)
+{
+	std::vector<std::string> triangles;
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		std::string corners[3];
+		for (int c = 0; c < 3; c++)
+			corners[c].assign((const char*)&mesh.vertices[mesh.indices[i + c]], sizeof(VertexModel));
+		int first = 0;
+		for (int c = 1; c < 3; c++)
+			if (corners[c] < corners[first]) first = c;
+		triangles.push_back(corners[first] + corners[(first + 1) % 3] + corners[(first + 2) % 3]);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// every index is one the indices before it used or the next new one
+static bool in_first_use_order(const ModelCore::MeshData& mesh)
+{
+	unsigned int next = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		if (mesh.indices[i] > next) return false;
+		if (mesh.indices[i] == next) next++;
+	}
+	return next == mesh.vertices.size();
+}
+
+// angle between two directions in degrees
+static double degrees_between(const glm::vec3& a, const glm::vec3& b)
+{
+	double c = glm::dot(glm::normalize(a), glm::normalize(b));
+	return std::acos(std::min(1.0, std::max(-1.0, c))) * 180.0 / 3.14159265358979323846;
+}
+
+// every half that isn't a NaN survives half -> float -> half, and the rounding at the edges
+static bool check_halves()
+{
+	for (uint32_t h = 0; h < 0x10000; h++)
+	{
+		bool nan = (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+		if (!nan && ModelCore::float_to_half(ModelCore::half_to_float((uint16_t)h)) != h)
+			return false;
+	}
+	return ModelCore::float_to_half(1.0f) == 0x3c00 && ModelCore::float_to_half(65504.0f) == 0x7bff
+		&& ModelCore::float_to_half(65520.0f) == 0x7c00 && ModelCore::float_to_half(ldexpf(1.0f, -24)) == 0x0001
+		&& ModelCore::float_to_half(ldexpf(1.0f, -25)) == 0x0000 && ModelCore::float_to_half(ldexpf(1.5f, -25)) == 0x0001
+		&& ModelCore::float_to_half(-2.0f) == 0xc000 && ModelCore::float_to_half(1.0f + ldexpf(1.0f, -11)) == 0x3c00;
+}
+
+// random tangent frames, half of them mirrored, with texture coordinates up to 8 (tiled)
+static bool check_packed_frames(size_t count, double& normal_error, double& tangent_error, double& uv_error)
+{
+	normal_error = tangent_error = uv_error = 0.0;
+	bool sides = true;
+	srand(1);
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 n(rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f);
+		glm::vec3 t(rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f);
+		if (glm::length(n) < 1e-3f || glm::length(glm::cross(n, t)) < 1e-3f) continue;
+		n = glm::normalize(n);
+		t = glm::normalize(t - glm::dot(t, n) * n);
+
+		VertexModel vertex;
+		vertex.Position = glm::vec3(float(i), 0.5f, -2.0f);
+		vertex.Normal = n;
+		vertex.Tangent = t;
+		vertex.Bitangent = glm::cross(n, t) * (i % 2 == 0 ? 1.0f : -1.0f);
+		vertex.TexCoords = glm::vec2(rand() / (float)RAND_MAX * 8.0f, rand() / (float)RAND_MAX);
+
+		VertexModel unpacked = ModelCore::unpack_vertex(ModelCore::pack_vertex(vertex));
+		normal_error = std::max(normal_error, degrees_between(unpacked.Normal, vertex.Normal));
+		tangent_error = std::max(tangent_error, degrees_between(unpacked.Tangent, vertex.Tangent));
+		sides = sides && glm::dot(unpacked.Bitangent, vertex.Bitangent) > 0.9f && unpacked.Position == vertex.Position;
+		for (int c = 0; c < 2; c++)
+		{
+			// half a step of the half float around the coordinate
+			float value = vertex.TexCoords[c];
+			double step = ldexp(1.0, std::max(-14, ilogb(std::max(value, 1e-30f))) - 10);
+			uv_error = std::max(uv_error, std::fabs(unpacked.TexCoords[c] - value) / (0.5 * step));
+		}
+	}
+	return sides;
+}
+
+static void append(const std::string& path, const char* text)
+{
+	std::ofstream file(path, std::ios::app | std::ios::binary);
+	file << text;
+}
+
+int main(int argc, char** argv)
+{
+	std::string media = argc > 1 ? argv[1] : "../Project_2/Media/";
+
+	std::string root = (std::filesystem::temp_directory_path() / "model_bench").string() + "/";
+	std::filesystem::remove_all(root);
+	std::filesystem::create_directories(root);
+
+	const char* shipped[][2] = { { "nanosuit/", "nanosuit" }, { "shell_car/", "bowsershell" } };
+	bool passed = true;
+
+	std::printf("%-14s %8s %10s %10s %9s %9s %9s %9s %9s\n", "model", "meshes", "triangles", "vertices", "cache MB",
+		"write ms", "load ms", "MB/s", "same");
+	for (int i = 0; i < 2; i++)
+	{
+		std::string folder = root + shipped[i][1];
+		std::filesystem::create_directories(folder);
+		std::string obj = folder + "/" + shipped[i][1] + ".obj";
+		std::string mtl = folder + "/" + shipped[i][1] + ".mtl";
+		std::error_code error;
+		std::filesystem::copy_file(media + shipped[i][0] + shipped[i][1] + ".obj", obj, error);
+		std::filesystem::copy_file(media + shipped[i][0] + shipped[i][1] + ".mtl", mtl, error);
+		if (error)
+		{
+			std::printf("can't copy %s%s from %s\n", shipped[i][0], shipped[i][1], media.c_str());
+			return 1;
+		}
+
+		size_t meshes;
+		size_t triangles = count_triangles(obj, meshes);
+		ModelCore model;
+		generate_meshes(model, triangles, meshes);
+		model.optimize_meshes();
+		model.import_ms = 123.0;
+		model.optimize_ms = 45.0;
+
+		std::string cache = ModelCore::cache_path(obj);
+		double t0 = now_ms();
+		bool saved = model.save_cache(cache, obj);
+		double write_ms = now_ms() - t0;
+
+		ModelCore loaded;
+		bool ok = saved && loaded.load_cache(cache, obj) && loaded.from_cache && same_meshes(model, loaded)
+			&& loaded.import_ms == 123.0 && loaded.optimize_ms == 45.0 && loaded.directory == folder;
+		// used where they are in the mapping, the counts stay once it is released
+		for (size_t m = 0; m < loaded.mesh_data.size(); m++)
+			ok = ok && loaded.mesh_data[m].vertices.empty() && loaded.mesh_data[m].indices.empty();
+		size_t loaded_bytes = loaded.mesh_bytes();
+		loaded.release_cache();
+		ok = ok && loaded.mesh_bytes() == loaded_bytes && loaded_bytes == model.mesh_bytes()
+			&& (loaded.mesh_data.empty() || loaded.mesh_data[0].vertex_data() == NULL);
+		double mb = std::filesystem::file_size(cache) / (1024.0 * 1024.0);
+
+		size_t vertices = 0;
+		for (size_t m = 0; m < model.mesh_data.size(); m++)
+			vertices += model.mesh_data[m].vertices.size();
+		std::printf("%-14s %8zu %10zu %10zu %9.2f %9.2f %9.2f %9.0f %9s\n", shipped[i][1], meshes, triangles, vertices, mb,
+			write_ms, loaded.cache_ms, mb / (loaded.cache_ms / 1000.0), ok ? "yes" : "NO");
+		passed = passed && ok;
+	}
+	std::printf("(the viewer prints the Assimp import time of each model next to its cache load)\n\n");
+
+	// what the packed layout saves on the same meshes, and what packing at load costs
+	std::printf("%-14s %10s %10s %10s %10s %8s %9s\n", "model", "vertices", "float MB", "packed MB", "saved MB", "saved", "pack ms");
+	for (int i = 0; i < 2; i++)
+	{
+		std::string obj = root + shipped[i][1] + "/" + shipped[i][1] + ".obj";
+		size_t meshes;
+		size_t triangles = count_triangles(obj, meshes);
+		ModelCore model;
+		generate_meshes(model, triangles, meshes);
+
+		size_t vertices = 0;
+		double t0 = now_ms();
+		std::vector<VertexPacked> packed;
+		for (size_t m = 0; m < model.mesh_data.size(); m++)
+		{
+			ModelCore::pack_vertices(model.mesh_data[m].vertices, packed);
+			vertices += packed.size();
+		}
+		double pack_ms = now_ms() - t0;
+
+		double floats = model.mesh_bytes(ModelCore::LAYOUT_FLOAT) / (1024.0 * 1024.0);
+		double packs = model.mesh_bytes(ModelCore::LAYOUT_PACKED) / (1024.0 * 1024.0);
+		std::printf("%-14s %10zu %10.2f %10.2f %10.2f %7.0f%% %9.2f\n", shipped[i][1], vertices, floats, packs, floats - packs,
+			100.0 * (floats - packs) / floats, pack_ms);
+	}
+	std::printf("(%zu instead of %zu bytes per vertex, the indices stay 4 bytes)\n\n", sizeof(VertexPacked), sizeof(VertexModel));
+
+	{
+		double normal_error, tangent_error, uv_error;
+		bool sides = check_packed_frames(100000, normal_error, tangent_error, uv_error);
+		std::printf("packed frames: normal off by %.3f, tangent by %.3f degrees at most, texture coordinates by %.2f half steps\n\n",
+			normal_error, tangent_error, uv_error);
+		passed = report("packed vertex is 24 bytes", sizeof(VertexPacked) == 24) && passed;
+		passed = report("every half float round trips", check_halves()) && passed;
+		passed = report("packed normals, tangents within 0.2 deg", normal_error < 0.2 && tangent_error < 0.2) && passed;
+		passed = report("packed bitangents keep their side", sides) && passed;
+		passed = report("packed texture coordinates rounded", uv_error <= 1.0) && passed;
+	}
+
+	// welding and reordering for the post-transform cache, on grids in row order and shuffled
+	std::printf("\n");
+	std::printf("%-18s %10s %10s %10s %8s %8s %9s\n", "mesh", "triangles", "vertices", "welded", "ACMR", "ACMR", "ms");
+	std::printf("%-18s %10s %10s %10s %8s %8s %9s\n", "", "", "", "", "before", "after", "");
+	{
+		struct Grid { const char* name; size_t n; bool shuffled; };
+		const Grid grids[] = { { "grid 64 rows", 64, false }, { "grid 256 rows", 256, false }, { "grid 256 shuffled", 256, true } };
+		bool same = true, welded = true, ordered = true, reused = true;
+		for (const Grid& grid : grids)
+		{
+			ModelCore::MeshData mesh;
+			generate_grid(mesh, grid.n, grid.shuffled);
+			std::vector<std::string> before = triangle_set(mesh);
+
+			double t0 = now_ms();
+			ModelCore::optimize_mesh(mesh);
+			double ms = now_ms() - t0;
+
+			std::printf("%-18s %10zu %10zu %10zu %8.2f %8.2f %9.2f\n", grid.name, mesh.indices.size() / 3, mesh.source_vertices,
+				mesh.vertices.size(), mesh.acmr_before, mesh.acmr_after, ms);
+			same = same && triangle_set(mesh) == before;
+			welded = welded && mesh.vertices.size() == (grid.n + 1) * (grid.n + 1) && mesh.source_vertices == before.size() * 3;
+			ordered = ordered && in_first_use_order(mesh);
+			reused = reused && mesh.acmr_before == 3.0f && mesh.acmr_after < 0.8f
+				&& mesh.acmr_after == ModelCore::acmr(mesh.indices, ModelCore::VERTEX_CACHE_SIZE);
+		}
+		std::printf("(%u entry FIFO cache, 3 vertices per triangle without reuse, 0.5 at best)\n\n", ModelCore::VERTEX_CACHE_SIZE);
+
+		ModelCore::MeshData empty;
+		ModelCore::optimize_mesh(empty);
+
+		ModelCore model;
+		model.mesh_data.resize(2);
+		generate_grid(model.mesh_data[0], 32, true);
+		model.optimize_meshes();
+		std::string obj = root + "nanosuit/nanosuit.obj";
+		std::string cache = root + "nanosuit/optimized.model";
+		ModelCore loaded;
+		bool cached = model.save_cache(cache, obj) && loaded.load_cache(cache, obj) && same_meshes(model, loaded)
+			&& loaded.mesh_data[0].acmr_after < loaded.mesh_data[0].acmr_before;
+
+		passed = report("optimized meshes keep their triangles", same) && passed;
+		passed = report("identical vertices welded", welded) && passed;
+		passed = report("vertices in first use order", ordered) && passed;
+		passed = report("ACMR under 0.8 on grids", reused) && passed;
+		passed = report("empty mesh left alone", empty.vertices.empty() && empty.acmr_after == 0.0f) && passed;
+		passed = report("cache keeps optimized meshes and ACMR", cached) && passed;
+		std::printf("\n");
+	}
+
+	// the cache depends on the .obj and its material library, and only on the unchanged ones
+	{
+		std::string folder = root + "nanosuit/";
+		std::string obj = folder + "nanosuit.obj", mtl = folder + "nanosuit.mtl";
+		std::string cache = ModelCore::cache_path(obj);
+
+		std::vector<std::string> sources = ModelCore::source_files(obj);
+		passed = report("sources are the .obj and its mtllib", sources.size() == 2 && sources[0] == "nanosuit.obj"
+			&& sources[1] == "nanosuit.mtl") && passed;
+		passed = report("cache file next to the model", cache == folder + "nanosuit.model") && passed;
+
+		ModelCore original;
+		bool cached = original.load_cache(cache, obj);
+
+		ModelCore other;
+		bool missing = !other.load_cache(folder + "missing.model", obj);
+
+		append(mtl, "\n# edited\n");
+		bool material = !other.load_cache(cache, obj);
+		original.save_cache(cache, obj);
+		bool resaved = other.load_cache(cache, obj) && same_meshes(original, other);
+
+		append(obj, "\n# edited\n");
+		ModelCore stale;
+		bool model = !stale.load_cache(cache, obj) && stale.mesh_data.empty() && !stale.from_cache;
+
+		original.save_cache(cache, obj);
+		std::string bowser = root + "bowsershell/bowsershell.obj";
+		bool moved = !stale.load_cache(cache, bowser);
+
+		std::filesystem::resize_file(cache, std::filesystem::file_size(cache) - 100);
+		bool truncated = !stale.load_cache(cache, obj);
+
+		original.save_cache(cache, obj);
+		{
+			std::fstream file(cache, std::ios::in | std::ios::out | std::ios::binary);
+			file.seekp(8);
+			file.put(99);
+		}
+		bool version = !stale.load_cache(cache, obj);
+
+		// an index past the vertices of its mesh would make the draw read past the buffer
+		ModelCore broken;
+		generate_meshes(broken, 300, 2);
+		broken.mesh_data[1].indices[100] = (unsigned int)broken.mesh_data[1].vertices.size();
+		broken.save_cache(cache, obj);
+		bool range = !stale.load_cache(cache, obj);
+
+		passed = report("second run loads the cache", cached) && passed;
+		passed = report("missing cache is not an error", missing) && passed;
+		passed = report("cache ignored after the .mtl changed", material && resaved) && passed;
+		passed = report("cache ignored after the .obj changed", model) && passed;
+		passed = report("cache ignored for another model", moved) && passed;
+		passed = report("truncated cache ignored", truncated) && passed;
+		passed = report("cache from another version ignored", version) && passed;
+		passed = report("cache with a bad index ignored", range) && passed;
+	}
+
+	std::filesystem::remove_all(root);
+
+	if (!passed)
+		std::printf("\nFAILED\n");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,348 @@
+/*** @file model_cache.cpp
+*
+*   @brief Model cache files: the meshes Model::processMesh() makes, stored so Assimp isn't needed again
+*
+*   Layout (native byte order):
+*     ModelHeader
+*     source list: per source file { uint64 hash, uint32 name length, name bytes }
+*     meshes:      per mesh { MeshRecord (counts, optimize_mesh() statistics), per texture { uint32 length, type, uint32 length, path },
+*                  vertices at the next 16 byte boundary, indices }
+*
+*   The header records the version and the vertex size, a file written with different ones is
+*   ignored. The vertices and indices are used where they are in the mapping, every index is
+*   checked against its mesh's vertex count first. The source list is the model file and its material libraries with a hash of their
+*   contents, if any of them changed the file is stale.
+**/
+
+#ifdef WIN32
+/* get rid of ridiculous warnings */
+#define _CRT_SECURE_NO_WARNINGS 1
+#endif
+
+#include <model_core.hpp>
+#include <mapped_file.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+
+// bump whenever the layout or what Model::processMesh() makes changes
+static const uint32_t MODEL_CACHE_VERSION = 2;
+static const char MODEL_CACHE_MAGIC[8] = { 'R', 'C', 'M', 'O', 'D', 'E', 'L', 0 };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct ModelHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	uint32_t vertex_size;
+	uint32_t mesh_count;
+	uint32_t source_count;
+	uint32_t padding;
+
+	// how long Assimp and optimize_meshes() took when the file was written
+	double import_ms;
+	double optimize_ms;
+};
+
+struct MeshRecord
+{
+	uint64_t vertex_count;
+	uint64_t index_count;
+	uint64_t source_vertices;
+	uint32_t texture_count;
+	// ModelCore::optimize_mesh() statistics
+	float acmr_before, acmr_after;
+	uint32_t padding;
+};
+
+
+// reads the mapping front to back, every read checks it stays inside the file
+struct CacheReader
+{
+	const unsigned char* data;
+	size_t size, position;
+
+	bool read(void* out, size_t bytes)
+	{
+		if (bytes > size - position) return false;
+		memcpy(out, data + position, bytes);
+		position += bytes;
+		return true;
+	}
+
+	bool read_string(std::string& out)
+	{
+		uint32_t length;
+		if (!read(&length, sizeof(length)) || length > size - position) return false;
+		out.assign((const char*)data + position, length);
+		position += length;
+		return true;
+	}
+
+	// count elements of T at the next 16 byte boundary (or right here if align is false), left in the mapping
+	template <typename T>
+	bool view_array(const T*& out, uint64_t count, bool align)
+	{
+		if (align)
+			position = std::min(size, (position + 15) / 16 * 16);
+		if (count > (size - position) / sizeof(T)) return false;
+		out = (const T*)(data + position);
+		position += count * sizeof(T);
+		return true;
+	}
+};
+
+static void write_string(FILE* file, const std::string& text)
+{
+	uint32_t length = (uint32_t)text.size();
+	fwrite(&length, sizeof(length), 1, file);
+	fwrite(text.data(), 1, length, file);
+}
+
+static std::string folder_of(const std::string& modelPath)
+{
+	size_t slash = modelPath.find_last_of('/');
+	return slash == std::string::npos ? std::string(".") : modelPath.substr(0, slash);
+}
+
+
+// nanosuit/nanosuit.obj -> nanosuit/nanosuit.model
+std::string ModelCore::cache_path(const std::string& modelPath)
+{
+	std::string path = modelPath;
+	size_t dot = path.find_last_of('.');
+	if (dot != std::string::npos && (path.find_last_of('/') == std::string::npos || dot > path.find_last_of('/')))
+		path.erase(dot);
+	return path + ".model";
+}
+
+std::vector<std::string> ModelCore::source_files(const std::string& modelPath)
+{
+	std::vector<std::string> sources;
+	size_t slash = modelPath.find_last_of('/');
+	sources.push_back(slash == std::string::npos ? modelPath : modelPath.substr(slash + 1));
+
+	if (modelPath.size() < 4 || modelPath.compare(modelPath.size() - 4, 4, ".obj") != 0)
+		return sources;
+
+	// the lines "mtllib <file>" of the .obj, each name up to the end of its line
+	MappedFile file;
+	if (!file.open(modelPath)) return sources;
+	const char* text = (const char*)file.data();
+	size_t size = file.size();
+	for (size_t line = 0; line < size; )
+	{
+		size_t end = line;
+		while (end < size && text[end] != '\n') end++;
+		if (end - line > 7 && memcmp(text + line, "mtllib ", 7) == 0)
+		{
+			size_t name_end = end;
+			while (name_end > line + 7 && (text[name_end - 1] == '\r' || text[name_end - 1] == ' ' || text[name_end - 1] == '\t'))
+				name_end--;
+			if (name_end > line + 7)
+				sources.push_back(std::string(text + line + 7, name_end - line - 7));
+		}
+		line = end + 1;
+	}
+	return sources;
+}
+
+size_t ModelCore::mesh_bytes(VertexLayout layout) const
+{
+	size_t vertex_size = layout == LAYOUT_PACKED ? sizeof(VertexPacked) : sizeof(VertexModel);
+	size_t bytes = 0;
+	for (size_t i = 0; i < mesh_data.size(); i++)
+		bytes += mesh_data[i].vertex_count() * vertex_size + mesh_data[i].index_count() * sizeof(unsigned int);
+	return bytes;
+}
+
+bool ModelCore::save_cache(const std::string& path, const std::string& modelPath) const
+{
+	// written next to it and renamed over it, so a model still mapping the old file (maybe this one)
+	// keeps reading it, and a crash never leaves half a cache behind
+	std::string temporary = path + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+	if (file == NULL)
+	{
+		printf("can't write file %s\n", temporary.c_str());
+		return false;
+	}
+
+	std::string folder = folder_of(modelPath);
+	std::vector<std::string> sources = source_files(modelPath);
+
+	ModelHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MODEL_CACHE_VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.vertex_size = sizeof(VertexModel);
+	header.mesh_count = (uint32_t)mesh_data.size();
+	header.source_count = (uint32_t)sources.size();
+	header.import_ms = import_ms;
+	header.optimize_ms = optimize_ms;
+	fwrite(&header, sizeof(header), 1, file);
+
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		uint64_t hash = hash_file(folder + "/" + sources[i]);
+		fwrite(&hash, sizeof(hash), 1, file);
+		write_string(file, sources[i]);
+	}
+
+	static const char zeros[16] = { 0 };
+	for (size_t i = 0; i < mesh_data.size(); i++)
+	{
+		const MeshData& mesh = mesh_data[i];
+		MeshRecord record;
+		memset(&record, 0, sizeof(record));
+		record.vertex_count = mesh.vertex_count();
+		record.index_count = mesh.index_count();
+		record.source_vertices = mesh.source_vertices;
+		record.texture_count = (uint32_t)mesh.textures.size();
+		record.acmr_before = mesh.acmr_before;
+		record.acmr_after = mesh.acmr_after;
+		fwrite(&record, sizeof(record), 1, file);
+
+		for (size_t t = 0; t < mesh.textures.size(); t++)
+		{
+			write_string(file, mesh.textures[t].type);
+			write_string(file, mesh.textures[t].path);
+		}
+
+		long position = ftell(file);
+		fwrite(zeros, 1, (16 - position % 16) % 16, file);
+		if (mesh.vertex_count() > 0)
+			fwrite(mesh.vertex_data(), sizeof(VertexModel), mesh.vertex_count(), file);
+		if (mesh.index_count() > 0)
+			fwrite(mesh.index_data(), sizeof(unsigned int), mesh.index_count(), file);
+	}
+
+	bool ok = ferror(file) == 0;
+	fclose(file);
+#ifdef _WIN32
+	// rename doesn't replace a file there
+	remove(path.c_str());
+#endif
+	if (!ok || rename(temporary.c_str(), path.c_str()) != 0)
+	{
+		printf("can't write file %s\n", path.c_str());
+		remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool ModelCore::load_cache(const std::string& path, const std::string& modelPath)
+{
+	auto t0 = std::chrono::steady_clock::now();
+
+	// a missing file is the normal case before the first run, no message for that
+	MappedFile file;
+	if (!file.open(path)) return false;
+
+	CacheReader reader = { file.data(), file.size(), 0 };
+	ModelHeader header;
+	if (!reader.read(&header, sizeof(header)))
+	{
+		printf("model cache %s is truncated, ignoring it\n", path.c_str());
+		return false;
+	}
+	if (memcmp(header.magic, MODEL_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != MODEL_CACHE_VERSION
+		|| header.byte_order != BYTE_ORDER_MARK || header.vertex_size != sizeof(VertexModel))
+	{
+		printf("model cache %s is from another version, ignoring it\n", path.c_str());
+		return false;
+	}
+
+	// the same source files, none of them changed
+	std::string folder = folder_of(modelPath);
+	std::vector<std::string> sources = source_files(modelPath);
+	if (header.source_count != sources.size())
+	{
+		printf("model cache %s is for other files, importing %s instead\n", path.c_str(), modelPath.c_str());
+		return false;
+	}
+	for (uint32_t i = 0; i < header.source_count; i++)
+	{
+		uint64_t hash;
+		std::string name;
+		if (!reader.read(&hash, sizeof(hash)) || !reader.read_string(name))
+		{
+			printf("model cache %s is truncated, ignoring it\n", path.c_str());
+			return false;
+		}
+		if (name != sources[i])
+		{
+			printf("model cache %s is for other files, importing %s instead\n", path.c_str(), modelPath.c_str());
+			return false;
+		}
+		if (hash_file(folder + "/" + name) != hash)
+		{
+			printf("model cache %s is older than %s, importing it instead\n", path.c_str(), name.c_str());
+			return false;
+		}
+	}
+
+	if (header.mesh_count > file.size() / sizeof(MeshRecord))
+	{
+		printf("model cache %s is truncated, ignoring it\n", path.c_str());
+		return false;
+	}
+	std::vector<MeshData> meshes(header.mesh_count);
+	for (uint32_t i = 0; i < header.mesh_count; i++)
+	{
+		MeshRecord record;
+		// every texture takes at least its two lengths
+		bool ok = reader.read(&record, sizeof(record)) && record.texture_count <= (reader.size - reader.position) / 8;
+		meshes[i].textures.resize(ok ? record.texture_count : 0);
+		for (size_t t = 0; ok && t < meshes[i].textures.size(); t++)
+			ok = reader.read_string(meshes[i].textures[t].type) && reader.read_string(meshes[i].textures[t].path);
+		ok = ok && reader.view_array(meshes[i].mapped_vertices, record.vertex_count, true)
+			&& reader.view_array(meshes[i].mapped_indices, record.index_count, false);
+		if (!ok)
+		{
+			printf("model cache %s is truncated, ignoring it\n", path.c_str());
+			return false;
+		}
+		meshes[i].mapped_vertex_count = (size_t)record.vertex_count;
+		meshes[i].mapped_index_count = (size_t)record.index_count;
+
+		// the draw can't be allowed to read past the vertex buffer
+		for (uint64_t k = 0; k < record.index_count; k++)
+			if (meshes[i].mapped_indices[k] >= record.vertex_count)
+			{
+				printf("model cache %s has indices out of range, ignoring it\n", path.c_str());
+				return false;
+			}
+		meshes[i].source_vertices = (size_t)record.source_vertices;
+		meshes[i].acmr_before = record.acmr_before;
+		meshes[i].acmr_after = record.acmr_after;
+	}
+
+	// everything checks out, take it all and keep the file mapped for the upload
+	mesh_data.swap(meshes);
+	cache.swap(file);
+	directory = folder;
+	import_ms = header.import_ms;
+	optimize_ms = header.optimize_ms;
+	from_cache = true;
+	cache_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+	return true;
+}
+
+void ModelCore::release_cache()
+{
+	cache.close();
+	for (size_t i = 0; i < mesh_data.size(); i++)
+	{
+		mesh_data[i].mapped_vertices = NULL;
+		mesh_data[i].mapped_indices = NULL;
+	}
+}
@@ -0,0 +1,201 @@
+/*** @file model_optimize.cpp
+*
+*   @brief Load time mesh optimization: identical vertices welded, triangles reordered for the
+*          post-transform vertex cache (Tipsify), vertices reordered for fetching
+*
+*   Tipsify is from Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and
+*   Reduced Overdraw" (2007): fan around the vertex that is still in the cache and has the fewest
+*   triangles left, fall back to the last emitted vertices that still have some (dead ends). It runs
+*   in linear time and gets close to Forsyth's scoring without its per-vertex scores.
+**/
+
+#include <model_core.hpp>
+#include <mapped_file.hpp>
+
+#include <chrono>
+#include <cstring>
+
+
+const unsigned int ModelCore::VERTEX_CACHE_SIZE;
+
+float ModelCore::acmr(const std::vector<unsigned int>& indices, unsigned int cache_size)
+{
+	if (indices.size() < 3) return 0.0f;
+
+	// FIFO cache: a vertex is in it if it was transformed within the last cache_size misses
+	unsigned int highest = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+		highest = std::max(highest, indices[i]);
+	std::vector<size_t> transformed(highest + 1, 0);
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		size_t& when = transformed[indices[i]];
+		if (when == 0 || misses - (when - 1) >= cache_size)
+		{
+			misses++;
+			when = misses;
+		}
+	}
+	return float(misses) / float(indices.size() / 3);
+}
+
+// identical vertices (every byte the same) become one, indices follow
+static void weld(ModelCore::MeshData& mesh)
+{
+	size_t count = mesh.vertices.size();
+	size_t buckets = 1;
+	while (buckets < 2 * count) buckets <<= 1;
+	// open addressing, index + 1 of the first vertex with those bytes
+	std::vector<unsigned int> table(buckets, 0);
+	std::vector<unsigned int> remap(count);
+	std::vector<VertexModel> welded;
+	welded.reserve(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const VertexModel& vertex = mesh.vertices[i];
+		size_t b = (size_t)hash_bytes(&vertex, sizeof(VertexModel)) & (buckets - 1);
+		while (table[b] != 0 && memcmp(&welded[table[b] - 1], &vertex, sizeof(VertexModel)) != 0)
+			b = (b + 1) & (buckets - 1);
+		if (table[b] == 0)
+		{
+			welded.push_back(vertex);
+			table[b] = (unsigned int)welded.size();
+		}
+		remap[i] = table[b] - 1;
+	}
+
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+		mesh.indices[i] = remap[mesh.indices[i]];
+	mesh.vertices.swap(welded);
+}
+
+// Tipsify: the triangles of indices in an order that reuses the last cache_size vertices
+static std::vector<unsigned int> tipsify(const std::vector<unsigned int>& indices, size_t vertex_count, unsigned int cache_size)
+{
+	size_t triangles = indices.size() / 3;
+
+	// triangles of every vertex, vertex v has adjacent[start[v] .. start[v + 1])
+	std::vector<unsigned int> start(vertex_count + 1, 0), adjacent(triangles * 3);
+	for (size_t i = 0; i < triangles * 3; i++)
+		start[indices[i] + 1]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		start[v + 1] += start[v];
+	{
+		std::vector<unsigned int> fill(start.begin(), start.end() - 1);
+		for (size_t i = 0; i < triangles * 3; i++)
+			adjacent[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	// triangles each vertex still has, when it last went into the cache, triangles emitted
+	std::vector<unsigned int> live(vertex_count);
+	for (size_t v = 0; v < vertex_count; v++)
+		live[v] = start[v + 1] - start[v];
+	std::vector<size_t> cached(vertex_count, 0);
+	std::vector<bool> emitted(triangles, false);
+	std::vector<unsigned int> dead_ends, candidates, output;
+	output.reserve(triangles * 3);
+
+	size_t time = cache_size + 1;
+	size_t cursor = 0;
+	long long fan = vertex_count > 0 ? 0 : -1;
+	while (fan >= 0)
+	{
+		candidates.clear();
+		for (unsigned int k = start[fan]; k < start[fan + 1]; k++)
+		{
+			unsigned int t = adjacent[k];
+			if (emitted[t]) continue;
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				output.push_back(v);
+				dead_ends.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cached[v] > cache_size)
+					cached[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// the candidate that will still be in the cache once its remaining triangles are emitted, the
+		// one that went in first; a dead end when there is none
+		long long next = -1;
+		long long best = -1;
+		for (size_t i = 0; i < candidates.size(); i++)
+		{
+			unsigned int v = candidates[i];
+			if (live[v] == 0) continue;
+			long long priority = 0;
+			if (time - cached[v] + 2 * live[v] <= cache_size)
+				priority = (long long)(time - cached[v]);
+			if (priority > best)
+			{
+				best = priority;
+				next = v;
+			}
+		}
+		if (next < 0)
+		{
+			while (!dead_ends.empty() && next < 0)
+			{
+				unsigned int v = dead_ends.back();
+				dead_ends.pop_back();
+				if (live[v] > 0) next = v;
+			}
+			while (next < 0 && cursor < vertex_count)
+			{
+				if (live[cursor] > 0) next = (long long)cursor;
+				else cursor++;
+			}
+		}
+		fan = next;
+	}
+	return output;
+}
+
+// vertices in the order the indices first use them, unused ones dropped
+static void reorder_vertices(ModelCore::MeshData& mesh)
+{
+	const unsigned int UNUSED = 0xffffffffu;
+	std::vector<unsigned int> remap(mesh.vertices.size(), UNUSED);
+	std::vector<VertexModel> ordered;
+	ordered.reserve(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		unsigned int& index = mesh.indices[i];
+		if (remap[index] == UNUSED)
+		{
+			remap[index] = (unsigned int)ordered.size();
+			ordered.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(ordered);
+}
+
+void ModelCore::optimize_mesh(MeshData& mesh)
+{
+	mesh.source_vertices = mesh.vertices.size();
+	mesh.acmr_before = acmr(mesh.indices);
+	if (mesh.indices.size() < 3 || mesh.vertices.empty())
+	{
+		mesh.acmr_after = mesh.acmr_before;
+		return;
+	}
+
+	weld(mesh);
+	mesh.indices = tipsify(mesh.indices, mesh.vertices.size(), VERTEX_CACHE_SIZE);
+	reorder_vertices(mesh);
+	mesh.acmr_after = acmr(mesh.indices);
+}
+
+void ModelCore::optimize_meshes()
+{
+	auto t0 = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < mesh_data.size(); i++)
+		optimize_mesh(mesh_data[i]);
+	optimize_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
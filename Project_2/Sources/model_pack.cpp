@@ -0,0 +1,145 @@
+/*** @file model_pack.cpp
+*
+*   @brief VertexModel packed into VertexPacked: 10:10:10:2 normal and tangent, half float texture coordinates
+**/
+
+#include <model_core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+// v in [-1, 1] to 10 bit signed normalized per component and w to 2 bits, x in the low bits (GL_INT_2_10_10_10_REV)
+static uint32_t pack_snorm(const glm::vec3& v, int w)
+{
+	uint32_t bits = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		int c = (int)std::lround(std::min(1.0f, std::max(-1.0f, v[i])) * 511.0f);
+		bits |= ((uint32_t)c & 0x3ffu) << (10 * i);
+	}
+	return bits | (((uint32_t)w & 0x3u) << 30);
+}
+
+// the way GL 4.2 and later read them back, max(c / 511, -1)
+static glm::vec4 unpack_snorm(uint32_t bits)
+{
+	glm::vec4 v;
+	for (int i = 0; i < 3; i++)
+	{
+		int c = (int)((bits >> (10 * i)) & 0x3ffu);
+		if (c >= 512) c -= 1024;
+		v[i] = std::max(c / 511.0f, -1.0f);
+	}
+	int w = (int)(bits >> 30);
+	if (w >= 2) w -= 4;
+	v.w = std::max((float)w, -1.0f);
+	return v;
+}
+
+// unit length, or the fallback for a zero vector
+static glm::vec3 unit(const glm::vec3& v, const glm::vec3& fallback)
+{
+	float length = glm::length(v);
+	return length > 1e-20f ? v / length : fallback;
+}
+
+uint16_t ModelCore::float_to_half(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	uint32_t exponent = (bits >> 23) & 0xffu;
+	uint32_t mantissa = bits & 0x7fffffu;
+
+	// infinity and NaN stay what they are
+	if (exponent == 0xff)
+		return (uint16_t)(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+
+	int half_exponent = (int)exponent - 127 + 15;
+	if (half_exponent >= 31)
+		return (uint16_t)(sign | 0x7c00u);
+
+	// too small for a normal half: a subnormal, rounded to nearest even, or 0
+	if (half_exponent <= 0)
+	{
+		if (half_exponent < -10) return (uint16_t)sign;
+		mantissa |= 0x800000u;
+		uint32_t shift = (uint32_t)(14 - half_exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1u))) half++;
+		return (uint16_t)(sign | half);
+	}
+
+	// rounded to nearest even, a carry out of the mantissa goes into the exponent (up to infinity)
+	uint32_t half = sign | ((uint32_t)half_exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fffu;
+	if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) half++;
+	return (uint16_t)half;
+}
+
+float ModelCore::half_to_float(uint16_t half)
+{
+	uint32_t sign = (uint32_t)(half & 0x8000u) << 16;
+	uint32_t exponent = (half >> 10) & 0x1fu;
+	uint32_t mantissa = half & 0x3ffu;
+
+	uint32_t bits;
+	if (exponent == 0)
+	{
+		float value = std::ldexp((float)mantissa, -24);
+		return sign ? -value : value;
+	}
+	if (exponent == 31)
+		bits = sign | 0x7f800000u | (mantissa << 13);
+	else
+		bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+VertexPacked ModelCore::pack_vertex(const VertexModel& vertex)
+{
+	glm::vec3 normal = unit(vertex.Normal, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::vec3 tangent = unit(vertex.Tangent, glm::vec3(1.0f, 0.0f, 0.0f));
+	// mirrored texture coordinates have the bitangent on the other side
+	int handedness = glm::dot(glm::cross(normal, tangent), vertex.Bitangent) < 0.0f ? -1 : 1;
+
+	VertexPacked packed;
+	packed.Position = vertex.Position;
+	packed.Normal = pack_snorm(normal, 0);
+	packed.Tangent = pack_snorm(tangent, handedness);
+	packed.TexCoords[0] = float_to_half(vertex.TexCoords.x);
+	packed.TexCoords[1] = float_to_half(vertex.TexCoords.y);
+	return packed;
+}
+
+VertexModel ModelCore::unpack_vertex(const VertexPacked& packed)
+{
+	glm::vec4 tangent = unpack_snorm(packed.Tangent);
+
+	VertexModel vertex;
+	vertex.Position = packed.Position;
+	vertex.Normal = glm::vec3(unpack_snorm(packed.Normal));
+	vertex.TexCoords = glm::vec2(half_to_float(packed.TexCoords[0]), half_to_float(packed.TexCoords[1]));
+	vertex.Tangent = glm::vec3(tangent);
+	vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent) * (tangent.w < 0.0f ? -1.0f : 1.0f);
+	return vertex;
+}
+
+void ModelCore::pack_vertices(const VertexModel* vertices, size_t count, std::vector<VertexPacked>& packed)
+{
+	packed.resize(count);
+	for (size_t i = 0; i < count; i++)
+		packed[i] = pack_vertex(vertices[i]);
+}
+
+void ModelCore::pack_vertices(const std::vector<VertexModel>& vertices, std::vector<VertexPacked>& packed)
+{
+	pack_vertices(vertices.empty() ? NULL : &vertices[0], vertices.size(), packed);
+}
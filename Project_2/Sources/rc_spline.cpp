@@ -12,66 +12,172 @@
 
 #include "rc_spline.h"
 
+#include <mapped_file.hpp>
 
-/* load a spline segment from a file */
-void rc_Spline::loadSegmentFrom(std::string filename)
-{	
-	filename = folder + filename;
-	FILE* fileSplineSegment = fopen(filename.c_str(), "r");
-	if (fileSplineSegment == NULL) 
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+
+
+/* Walks the whitespace separated words of a file that is mapped in memory,
+   counting lines so errors can say where they are. */
+struct SplineTokens
+{
+	const char* p;
+	const char* end;
+	/* line of the word next() returned last, starting at 1 */
+	int line;
+
+	SplineTokens(const char* begin, const char* stop) : p(begin), end(stop), line(1) {}
+
+	/* find the next word, false at the end of the file */
+	bool next(const char*& first, const char*& last)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+		{
+			if (*p == '\n') line++;
+			p++;
+		}
+		if (p == end) return false;
+
+		first = p;
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+		last = p;
+		return true;
+	}
+};
+
+/* parse a whole word as a number, from_chars doesn't take a leading '+' */
+template <typename T>
+static bool parseNumber(const char* first, const char* last, T& value)
+{
+	if (first < last && *first == '+') first++;
+	std::from_chars_result result = std::from_chars(first, last, value);
+	return result.ec == std::errc() && result.ptr == last;
+}
+
+
+/* parse a spline segment file: the number of points, then x y z for every point */
+bool rc_Spline::parseSegment(const std::string& path, pointVector& points)
+{
+	MappedFile file;
+	if (!file.open(path))
 	{
-		printf ("can't open file %s\n", filename.c_str());
-		exit(1);
+		error = path + ": can't open file";
+		return false;
 	}
 
-	int iLength;
+	const char* text = (const char*)file.data();
+	SplineTokens tokens(text, text + file.size());
+	const char *first, *last;
 
 	/* gets length for spline segment */
-	fscanf(fileSplineSegment, "%d", &iLength);
+	int iLength = 0;
+	if (!tokens.next(first, last) || !parseNumber(first, last, iLength) || iLength < 0)
+	{
+		error = path + ":" + std::to_string(tokens.line) + ": expected the number of points";
+		return false;
+	}
+	/* the count is only a hint, every point takes at least "x y z" and a separator */
+	points.reserve(std::min<size_t>(iLength, file.size() / 6));
 
-	glm::vec3 pt;
+	/* every point is three numbers, possibly spread over lines */
+	while (tokens.next(first, last))
+	{
+		glm::vec3 pt;
+		int line = tokens.line;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (axis > 0 && !tokens.next(first, last))
+			{
+				error = path + ":" + std::to_string(line) + ": point " + std::to_string(points.size() + 1) + " has only " + std::to_string(axis) + " coordinates";
+				return false;
+			}
+			if (!parseNumber(first, last, pt[axis]))
+			{
+				error = path + ":" + std::to_string(tokens.line) + ": '" + std::string(first, last) + "' is not a number";
+				return false;
+			}
+		}
+		points.push_back(pt);
+	}
 
-	/* add it to the control point list */
-	while (fscanf(fileSplineSegment, "%f %f %f", 
-				&pt.x, &pt.y,&pt.z) != EOF) 
+	/* the old loader ignored the declared length, so a wrong one is only worth a warning */
+	if ((int)points.size() != iLength)
+		printf("%s:1: declares %d points but has %d, using all of them\n", path.c_str(), iLength, (int)points.size());
+
+	return true;
+}
+
+/* load a spline segment from a file, or from the cache if it was loaded before */
+bool rc_Spline::loadSegmentFrom(std::string filename)
+{	
+	std::string path = folder + filename;
+
+	std::unordered_map<std::string, pointVector>::iterator cached = m_segmentCache.find(path);
+	if (cached == m_segmentCache.end())
 	{
-		m_vPoints.push_back(pt);
+		pointVector points;
+		if (!parseSegment(path, points)) return false;
+
+		cached = m_segmentCache.insert(std::make_pair(path, std::move(points))).first;
+		files.push_back(filename);
 	}
 
-	/* now close the file */
-	fclose(fileSplineSegment);
+	/* add it to the control point list */
+	m_vPoints.insert(m_vPoints.end(), cached->second.begin(), cached->second.end());
+	return true;
 }
 
 
 /* load a spline from a file */
-void rc_Spline::loadSplineFrom(std::string filename)
+bool rc_Spline::loadSplineFrom(std::string filename)
 {	
+	files.push_back(filename);
 	filename = folder + filename;
+
 	/* load the track file */
-	FILE* fileSpline = fopen(filename.c_str(), "r");
+	MappedFile fileSpline;
+	if (!fileSpline.open(filename))
+	{
+		error = filename + ": can't open file";
+		printf("%s\n", error.c_str());
+		return false;
+	}
 
-	if (fileSpline == NULL) 
+	const char* text = (const char*)fileSpline.data();
+	SplineTokens tokens(text, text + fileSpline.size());
+	const char *first, *last;
+
+	/* the number of segments */
+	int nSegments = 0;
+	if (!tokens.next(first, last) || !parseNumber(first, last, nSegments) || nSegments < 0)
 	{
-		printf ("can't open file %s\n", filename.c_str());
-		exit(1);
+		error = filename + ":" + std::to_string(tokens.line) + ": expected the number of segments";
+		printf("%s\n", error.c_str());
+		return false;
 	}
-  
-	/* stores the number of splines in a global variable */
-	int nSegments;
-	fscanf(fileSpline, "%d", &nSegments);
 
 	/* reads through the spline files */
 	for (int j = 0; j < nSegments; j++) 
 	{
-		/* define a variable of a reasonable size for a filename */
-		char segmentfilename[1024];
-
-		fscanf(fileSpline, "%s", segmentfilename);
-		loadSegmentFrom(segmentfilename);
+		if (!tokens.next(first, last))
+		{
+			error = filename + ":" + std::to_string(tokens.line) + ": declares " + std::to_string(nSegments) + " segments but names " + std::to_string(j);
+			printf("%s\n", error.c_str());
+			return false;
+		}
+
+		/* segment errors get the index line in front, so it's clear which reference failed */
+		int line = tokens.line;
+		if (!loadSegmentFrom(std::string(first, last)))
+		{
+			error = filename + ":" + std::to_string(line) + ": " + error;
+			printf("%s\n", error.c_str());
+			return false;
+		}
 	}
 
-	/* now close the file */
-	fclose(fileSpline);
-
-
-}
\ No newline at end of file
+	return true;
+}
@@ -0,0 +1,175 @@
+/*** @file spline_bench.cpp
+*
+*   @brief Benchmark for the spline file parser in rc_Spline
+*
+*   Writes two temporary tracks into the media folder and loads each with rc_Spline and
+*   with the fscanf loader it replaced:
+*     - an index with 100k references to the shipped spline parts (segment cache)
+*     - one segment with a million points (raw parsing speed)
+*   The points have to come out the same. Then a few broken files are loaded to show
+*   the error messages. The temporary files are removed again.
+*
+*   usage: spline_bench [media folder] [references] [points]
+*   e.g.   spline_bench ../Project_2/Media/ 100000 1000000
+**/
+
+#ifdef WIN32
+/* get rid of ridiculous warnings */
+#define _CRT_SECURE_NO_WARNINGS 1
+#endif
+
+#include <rc_spline.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the loader rc_Spline used before, kept here to compare against (error handling left out)
+static void load_fscanf(const std::string& folder, const std::string& index, pointVector& points)
+{
+	FILE* fileSpline = fopen((folder + index).c_str(), "r");
+	if (fileSpline == NULL) return;
+
+	int nSegments;
+	fscanf(fileSpline, "%d", &nSegments);
+	for (int j = 0; j < nSegments; j++)
+	{
+		char segmentfilename[1024];
+		fscanf(fileSpline, "%s", segmentfilename);
+
+		FILE* fileSplineSegment = fopen((folder + segmentfilename).c_str(), "r");
+		if (fileSplineSegment == NULL) continue;
+
+		int iLength;
+		fscanf(fileSplineSegment, "%d", &iLength);
+
+		glm::vec3 pt;
+		while (fscanf(fileSplineSegment, "%f %f %f", &pt.x, &pt.y, &pt.z) != EOF)
+			points.push_back(pt);
+		fclose(fileSplineSegment);
+	}
+	fclose(fileSpline);
+}
+
+static void write_file(const std::string& path, const std::string& text)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) return;
+	fwrite(text.data(), 1, text.size(), file);
+	fclose(file);
+}
+
+// load the index both ways, print one row and return whether the points match
+static bool bench_index(const std::string& folder, const std::string& index, const char* name)
+{
+	double t0 = now_ms();
+	pointVector old_points;
+	load_fscanf(folder, index, old_points);
+	double t1 = now_ms();
+
+	rc_Spline spline;
+	spline.folder = folder;
+	bool loaded = spline.loadSplineFrom(index);
+	double t2 = now_ms();
+
+	bool same = loaded && spline.points().size() == old_points.size()
+		&& (old_points.empty() || memcmp(&spline.points()[0], &old_points[0], old_points.size() * sizeof(glm::vec3)) == 0);
+
+	std::printf("%-28s %10zu %10zu %10.2f %10.2f %8.1fx %9s\n", name, spline.files.size() - 1, spline.points().size(),
+		t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1), same ? "yes" : "NO");
+	return same;
+}
+
+int main(int argc, char** argv)
+{
+	std::string folder = argc > 1 ? argv[1] : "../Project_2/Media/";
+	int references = argc > 2 ? atoi(argv[2]) : 100000;
+	int point_count = argc > 3 ? atoi(argv[3]) : 1000000;
+
+	bool passed = true;
+	std::printf("%-28s %10s %10s %10s %10s %9s %9s\n", "index", "files", "points", "fscanf ms", "parser ms", "speedup", "identical");
+
+	// the shipped tracks
+	passed = bench_index(folder, "spline/custom_track.sp", "spline/custom_track.sp") && passed;
+	passed = bench_index(folder, "spline/track.sp", "spline/track.sp") && passed;
+
+	// many references to a few small files
+	const char* parts[] = { "x.sp", "y.sp", "z.sp", "negx.sp", "negy.sp", "negz.sp", "turn-x-y.sp", "turn-x-z.sp", "turn-y-negx.sp" };
+	std::string index = std::to_string(references) + "\n";
+	for (int i = 0; i < references; i++)
+		index += std::string("spline_parts/") + parts[i % 9] + "\n";
+	write_file(folder + "spline/bench_references.sp", index);
+
+	std::string name = std::to_string(references) + " references";
+	passed = bench_index(folder, "spline/bench_references.sp", name.c_str()) && passed;
+
+	// one large segment
+	std::mt19937 rng(458u);
+	std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+	std::string segment = std::to_string(point_count) + "\r\n";
+	char line[128];
+	for (int i = 0; i < point_count; i++)
+	{
+		std::snprintf(line, sizeof(line), "%f %f %f\r\n", offset(rng), offset(rng), offset(rng));
+		segment += line;
+	}
+	write_file(folder + "spline_parts/bench_points.sp", segment);
+	write_file(folder + "spline/bench_points.sp", "1\nspline_parts/bench_points.sp\n");
+
+	name = std::to_string(point_count) + " points";
+	passed = bench_index(folder, "spline/bench_points.sp", name.c_str()) && passed;
+
+	// broken files, each has to be rejected with a message
+	std::printf("\nerrors:\n");
+	write_file(folder + "spline_parts/bench_broken.sp", "3\n1 0 0\n1 zero 0\n1 0 0\n");
+	write_file(folder + "spline_parts/bench_short.sp", "2\n1 0 0\n1 0\n");
+	write_file(folder + "spline/bench_broken.sp", "2\nspline_parts/x.sp\nspline_parts/bench_broken.sp\n");
+	write_file(folder + "spline/bench_short.sp", "1\nspline_parts/bench_short.sp\n");
+	write_file(folder + "spline/bench_missing.sp", "3\nspline_parts/x.sp\nspline_parts/no_such_part.sp\n");
+	write_file(folder + "spline/bench_count.sp", "4\nspline_parts/x.sp\n");
+
+	const char* broken[] = { "spline/bench_broken.sp", "spline/bench_short.sp", "spline/bench_missing.sp", "spline/bench_count.sp" };
+	for (int i = 0; i < 4; i++)
+	{
+		rc_Spline spline;
+		spline.folder = folder;
+		if (spline.loadSplineFrom(broken[i]))
+		{
+			std::printf("%s loaded without an error\n", broken[i]);
+			passed = false;
+		}
+	}
+
+	// a count far beyond what the file holds is only a warning, nothing that large gets allocated
+	write_file(folder + "spline_parts/bench_huge.sp", "2147483647\n1 0 0\n");
+	write_file(folder + "spline/bench_huge.sp", "1\nspline_parts/bench_huge.sp\n");
+	{
+		rc_Spline spline;
+		spline.folder = folder;
+		if (!spline.loadSplineFrom("spline/bench_huge.sp") || spline.points().size() != 1)
+		{
+			std::printf("spline/bench_huge.sp didn't load its one point\n");
+			passed = false;
+		}
+	}
+
+	const char* written[] = { "spline/bench_references.sp", "spline_parts/bench_points.sp", "spline/bench_points.sp",
+		"spline_parts/bench_broken.sp", "spline_parts/bench_short.sp", "spline/bench_broken.sp", "spline/bench_short.sp",
+		"spline/bench_missing.sp", "spline/bench_count.sp", "spline_parts/bench_huge.sp", "spline/bench_huge.sp" };
+	for (int i = 0; i < 11; i++)
+		std::remove((folder + written[i]).c_str());
+
+	std::printf(passed ? "\nall checks passed\n" : "\ncheck FAILED\n");
+	return passed ? 0 : 1;
+}
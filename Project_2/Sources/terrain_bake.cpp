@@ -0,0 +1,348 @@
+/*** @file terrain_bake.cpp
+*
+*   @brief Static lighting of the heightmap: sun with terrain shadows, horizon ambient occlusion, point lights
+*
+*   Bake file layout (native byte order):
+*     BakeHeader
+*     texels: width * height RGBA8, row major
+*
+*   The header carries the key of the heights, model matrix, lights and settings the texels
+*   were baked with (TerrainBake::key), a file with another key is stale.
+**/
+
+#ifdef WIN32
+/* get rid of ridiculous warnings */
+#define _CRT_SECURE_NO_WARNINGS 1
+#endif
+
+#include <terrain_bake.hpp>
+#include <thread_pool.hpp>
+#include <mapped_file.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+
+// bump whenever the layout or the way the light is worked out changes
+static const uint32_t BAKE_VERSION = 1;
+static const char BAKE_MAGIC[8] = { 'R', 'C', 'B', 'A', 'K', 'E', 0, 0 };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+struct BakeHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	int32_t width, height;
+	uint64_t key;
+};
+
+// pixels along each side of a block of block_highest
+static const int SHADOW_BLOCK = 8;
+
+// the 8 directions the horizon is searched along, (rows, columns)
+static const int HORIZON_DIRECTIONS[8][2] = {
+	{ 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }
+};
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+std::string TerrainBake::cache_path(const std::string& imagePath)
+{
+	size_t dot = imagePath.find_last_of('.');
+	size_t slash = imagePath.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return imagePath + ".bake";
+	return imagePath.substr(0, dot) + ".bake";
+}
+
+unsigned long long TerrainBake::key(const HeightmapCore& map) const
+{
+	unsigned long long hash = hash_bytes(&BAKE_VERSION, sizeof(BAKE_VERSION));
+	hash = hash_bytes(&map.width, sizeof(map.width), hash);
+	hash = hash_bytes(&map.height, sizeof(map.height), hash);
+
+	// the heights as both modes see them, a row at a time
+	std::vector<float> row(map.width);
+	for (int r = 0; r < map.height; r++)
+	{
+		for (int c = 0; c < map.width; c++)
+			row[c] = map.height_at(r, c);
+		if (!row.empty())
+			hash = hash_bytes(&row[0], row.size() * sizeof(float), hash);
+	}
+
+	glm::mat4 model = map.model_matrix();
+	hash = hash_bytes(&model, sizeof(model), hash);
+	hash = hash_bytes(&lights, sizeof(lights), hash);
+	hash = hash_bytes(&ao_radius, sizeof(ao_radius), hash);
+	hash = hash_bytes(&shadow_distance, sizeof(shadow_distance), hash);
+	return hash;
+}
+
+void TerrainBake::bake(const HeightmapCore& map)
+{
+	double t0 = now_ms();
+	width = map.width;
+	height = map.height;
+	texels.clear();
+	world_height.clear();
+	if (width < 2 || height < 2)
+		return;
+
+	// the model matrix only scales and moves the grid, so one distance per row and per column
+	glm::mat4 model = map.model_matrix();
+	step_x = fabs(model[0][0] * (map.row_x(1) - map.row_x(0)));
+	step_z = fabs(model[2][2] * (map.column_z(1) - map.column_z(0)));
+
+	world_height.resize((size_t)width * height);
+	texels.resize(world_height.size() * 4);
+	ThreadPool::shared().parallel_for(0, height, [this, &map, &model](size_t first, size_t last)
+	{
+		for (int r = (int)first; r < (int)last; r++)
+			for (int c = 0; c < width; c++)
+				world_height[(size_t)r * width + c] = (model * glm::vec4(0.0f, map.height_at(r, c), 0.0f, 1.0f)).y;
+	}, threads);
+	highest = *std::max_element(world_height.begin(), world_height.end());
+
+	// the horizon is searched at every pixel close by and fewer further out
+	horizon_steps.clear();
+	for (int step = 1; step <= ao_radius; step += std::max(1, step / 4))
+		horizon_steps.push_back(step);
+	horizon_inverse.resize(horizon_steps.size() * 8);
+	for (int direction = 0; direction < 8; direction++)
+	{
+		float dx = HORIZON_DIRECTIONS[direction][0] * step_x, dz = HORIZON_DIRECTIONS[direction][1] * step_z;
+		for (size_t i = 0; i < horizon_steps.size(); i++)
+			horizon_inverse[direction * horizon_steps.size() + i] = 1.0f / (horizon_steps[i] * sqrt(dx * dx + dz * dz));
+	}
+
+	// the bilinear samples in a block also read the row and column after it, one more for rounding
+	int block_rows = (height + SHADOW_BLOCK - 1) / SHADOW_BLOCK;
+	block_columns = (width + SHADOW_BLOCK - 1) / SHADOW_BLOCK;
+	block_highest.assign((size_t)block_rows * block_columns, 0.0f);
+	ThreadPool::shared().parallel_for(0, block_rows, [this](size_t first, size_t last)
+	{
+		for (int block = (int)first; block < (int)last; block++)
+		{
+			int last_row = std::min((block + 1) * SHADOW_BLOCK + 2, height);
+			for (int column = 0; column < block_columns; column++)
+			{
+				int last_column = std::min((column + 1) * SHADOW_BLOCK + 2, width);
+				float top = world_height[(size_t)block * SHADOW_BLOCK * width + column * SHADOW_BLOCK];
+				for (int r = block * SHADOW_BLOCK; r < last_row; r++)
+					for (int c = column * SHADOW_BLOCK; c < last_column; c++)
+						top = std::max(top, world_height[(size_t)r * width + c]);
+				block_highest[(size_t)block * block_columns + column] = top;
+			}
+		}
+	}, threads);
+
+	ThreadPool::shared().parallel_for(0, height, [this, &map](size_t first, size_t last)
+	{
+		bake_rows(map, (int)first, (int)last);
+	}, threads);
+
+	std::vector<float>().swap(world_height);
+	std::vector<float>().swap(block_highest);
+	bake_ms = now_ms() - t0;
+}
+
+void TerrainBake::bake_rows(const HeightmapCore& map, int first, int last)
+{
+	glm::mat4 model = map.model_matrix();
+	glm::mat3 normal_matrix = glm::mat3(glm::transpose(glm::inverse(model)));
+	glm::vec3 to_sun = glm::normalize(-lights.direction);
+
+	for (int r = first; r < last; r++)
+	{
+		for (int c = 0; c < width; c++)
+		{
+			glm::vec3 position = glm::vec3(model * glm::vec4(map.row_x(r), map.height_at(r, c), map.column_z(c), 1.0f));
+			glm::vec3 normal = glm::normalize(normal_matrix * map.normal_at(r, c));
+			float sky = open_sky(r, c);
+
+			// the sun only where the ground faces it and nothing is in the way
+			float facing = std::max(glm::dot(normal, to_sun), 0.0f);
+			glm::vec3 light = lights.ambient * sky;
+			if (facing > 0.0f)
+				light += lights.diffuse * facing * sun_visible(r, c);
+
+			// the point lights' ambient and diffuse parts like CalcPointLight, without shadows
+			for (int i = 0; i < 4; i++)
+			{
+				glm::vec3 to_light = lights.point_position[i] - position;
+				float distance = glm::length(to_light);
+				float attenuation = 1.0f / (lights.constant + lights.linear * distance + lights.quadratic * distance * distance);
+				float diffuse = distance > 0.0f ? std::max(glm::dot(normal, to_light / distance), 0.0f) : 0.0f;
+				light += attenuation * (lights.point_ambient[i] * sky + lights.point_diffuse[i] * diffuse);
+			}
+
+			unsigned char* texel = &texels[((size_t)r * width + c) * 4];
+			for (int channel = 0; channel < 3; channel++)
+				texel[channel] = (unsigned char)(std::min(std::max(light[channel], 0.0f), 1.0f) * 255.0f + 0.5f);
+			texel[3] = (unsigned char)(sky * 255.0f + 0.5f);
+		}
+	}
+}
+
+float TerrainBake::world_height_at(float row, float column) const
+{
+	int r = std::min((int)row, height - 2), c = std::min((int)column, width - 2);
+	float fr = row - r, fc = column - c;
+	const float* top = &world_height[(size_t)r * width + c];
+	const float* bottom = top + width;
+	return (top[0] * (1.0f - fc) + top[1] * fc) * (1.0f - fr) + (bottom[0] * (1.0f - fc) + bottom[1] * fc) * fr;
+}
+
+float TerrainBake::sun_visible(int row, int column) const
+{
+	glm::vec3 to_sun = glm::normalize(-lights.direction);
+	if (to_sun.y <= 0.0f) return 0.0f;
+
+	// one pixel along the longer of the two directions per step, and how much the ray rises meanwhile
+	float rows = to_sun.x / step_x, columns = to_sun.z / step_z;
+	float longest = std::max(fabs(rows), fabs(columns));
+	if (longest < 1.0e-6f) return 1.0f;
+	rows /= longest;
+	columns /= longest;
+	float rise = to_sun.y / longest;
+	float per_row = rows != 0.0f ? 1.0f / rows : 0.0f, per_column = columns != 0.0f ? 1.0f / columns : 0.0f;
+
+	// a hair above the ground so a pixel doesn't shade itself
+	float start = world_height[(size_t)row * width + column] + 1.0e-3f;
+	for (int step = 1; step <= shadow_distance; step++)
+	{
+		float r = row + step * rows, c = column + step * columns;
+		float ray = start + step * rise;
+		if (r < 0.0f || c < 0.0f || r > float(height - 1) || c > float(width - 1) || ray > highest)
+			return 1.0f;
+
+		// the ray only climbs, so above the whole block it stays above it until the last step inside
+		int block_row = (int)r / SHADOW_BLOCK, block_column = (int)c / SHADOW_BLOCK;
+		if (ray > block_highest[(size_t)block_row * block_columns + block_column])
+		{
+			float to_row = rows > 0.0f ? ((block_row + 1) * SHADOW_BLOCK - r) * per_row : rows < 0.0f ? (block_row * SHADOW_BLOCK - r) * per_row : 1.0e9f;
+			float to_column = columns > 0.0f ? ((block_column + 1) * SHADOW_BLOCK - c) * per_column : columns < 0.0f ? (block_column * SHADOW_BLOCK - c) * per_column : 1.0e9f;
+			step += std::max((int)ceil(std::min(to_row, to_column)) - 1, 0);
+			continue;
+		}
+		if (world_height_at(r, c) > ray)
+			return 0.0f;
+	}
+	return 1.0f;
+}
+
+float TerrainBake::open_sky(int row, int column) const
+{
+	float ground = world_height[(size_t)row * width + column];
+	float occluded = 0.0f;
+	for (int direction = 0; direction < 8; direction++)
+	{
+		int dr = HORIZON_DIRECTIONS[direction][0], dc = HORIZON_DIRECTIONS[direction][1];
+		const float* inverse = &horizon_inverse[direction * horizon_steps.size()];
+
+		// the steepest rise to the horizon
+		float horizon = 0.0f;
+		for (size_t i = 0; i < horizon_steps.size(); i++)
+		{
+			int r = row + horizon_steps[i] * dr, c = column + horizon_steps[i] * dc;
+			if (r < 0 || c < 0 || r >= height || c >= width) break;
+			horizon = std::max(horizon, (world_height[(size_t)r * width + c] - ground) * inverse[i]);
+		}
+		// sine of the horizon's elevation
+		occluded += horizon / sqrt(1.0f + horizon * horizon);
+	}
+	return 1.0f - occluded / 8.0f;
+}
+
+bool TerrainBake::save(const std::string& path, const HeightmapCore& map) const
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+	{
+		printf("can't write file %s\n", path.c_str());
+		return false;
+	}
+
+	BakeHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BAKE_MAGIC, sizeof(header.magic));
+	header.version = BAKE_VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.width = width;
+	header.height = height;
+	header.key = key(map);
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (!texels.empty())
+		ok = ok && fwrite(&texels[0], 1, texels.size(), file) == texels.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+		printf("can't write file %s\n", path.c_str());
+	return ok;
+}
+
+bool TerrainBake::load(const std::string& path, const HeightmapCore& map)
+{
+	double t0 = now_ms();
+
+	// a missing file is the normal case before the first bake, no message for that
+	MappedFile file;
+	if (!file.open(path)) return false;
+
+	BakeHeader header;
+	if (file.size() < sizeof(header))
+	{
+		printf("baked lighting %s is truncated, baking again\n", path.c_str());
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+
+	size_t bytes = (size_t)map.width * map.height * 4;
+	if (memcmp(header.magic, BAKE_MAGIC, sizeof(header.magic)) != 0 || header.version != BAKE_VERSION
+		|| header.byte_order != BYTE_ORDER_MARK)
+	{
+		printf("baked lighting %s is from another version, baking again\n", path.c_str());
+		return false;
+	}
+	if (header.width != map.width || header.height != map.height)
+	{
+		printf("baked lighting %s is for another heightmap, baking again\n", path.c_str());
+		return false;
+	}
+	if (file.size() != sizeof(header) + bytes)
+	{
+		printf("baked lighting %s is truncated, baking again\n", path.c_str());
+		return false;
+	}
+	if (header.key != key(map))
+	{
+		printf("baked lighting %s is for other heights or lights, baking again\n", path.c_str());
+		return false;
+	}
+
+	width = map.width;
+	height = map.height;
+	texels.assign(file.data() + sizeof(header), file.data() + sizeof(header) + bytes);
+	load_ms = now_ms() - t0;
+	return true;
+}
+
+void TerrainBake::bake_cached(const HeightmapCore& map, const std::string& path)
+{
+	from_cache = load(path, map);
+	if (from_cache) return;
+
+	bake(map);
+	save(path, map);
+}
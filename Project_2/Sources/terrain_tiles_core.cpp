@@ -0,0 +1,337 @@
+/*** @file terrain_tiles_core.cpp
+*
+*   @brief Streamed terrain tiles: tile set file, background loading and the least recently used cache
+**/
+
+#ifdef WIN32
+/* get rid of ridiculous warnings */
+#define _CRT_SECURE_NO_WARNINGS 1
+#endif
+
+#include <terrain_tiles_core.hpp>
+#include <mapped_file.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+
+TerrainTilesCore::~TerrainTilesCore()
+{
+	close();
+}
+
+void TerrainTilesCore::close()
+{
+	closing = true;
+	wait();
+}
+
+bool TerrainTilesCore::open(const std::string& path)
+{
+	clear();
+	error.clear();
+
+	std::ifstream file(path.c_str());
+	if (!file)
+	{
+		error = "can't open " + path;
+		return false;
+	}
+
+	size_t slash = path.find_last_of("/\\");
+	folder = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+	bool have_tiles = false, have_samples = false;
+	std::string line;
+	for (int number = 1; std::getline(file, line); number++)
+	{
+		// everything after # is a comment
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream words(line);
+		std::string key;
+		if (!(words >> key)) continue;
+
+		bool ok = true;
+		if (key == "tiles") { ok = (bool)(words >> tile_rows >> tile_columns) && tile_rows > 0 && tile_columns > 0; have_tiles = ok; }
+		else if (key == "samples") { ok = (bool)(words >> sample_rows >> sample_columns) && sample_rows > 1 && sample_columns > 1; have_samples = ok; }
+		else if (key == "spacing") ok = (bool)(words >> spacing) && spacing > 0.0f;
+		else if (key == "scale") ok = (bool)(words >> scale);
+		else if (key == "offset") ok = (bool)(words >> offset);
+		else if (key == "origin") ok = (bool)(words >> origin.x >> origin.y);
+		else if (key == "format")
+		{
+			std::string name;
+			ok = (bool)(words >> name) && (name == "u16" || name == "f32");
+			format = name == "f32" ? FORMAT_F32 : FORMAT_U16;
+		}
+		else ok = false;
+
+		if (!ok)
+		{
+			std::ostringstream message;
+			message << path << ":" << number << ": can't read '" << line << "'";
+			error = message.str();
+			return false;
+		}
+	}
+
+	if (!have_tiles || !have_samples)
+	{
+		error = path + ": needs a tiles and a samples line";
+		return false;
+	}
+
+	tiles.assign((size_t)tile_rows * tile_columns, Tile());
+	for (size_t id = 0; id < tiles.size(); id++)
+	{
+		tiles[id].row = (int)(id / tile_columns);
+		tiles[id].column = (int)(id % tile_columns);
+		tiles[id].state = TILE_EMPTY;
+		tiles[id].low = tiles[id].high = 0.0f;
+	}
+	wanted_frame.assign(tiles.size(), 0);
+	used.clear();
+
+	// two triangles per cell, split like the heightmap
+	indices.clear();
+	for (int r = 0; r < sample_rows - 1; r++)
+	{
+		for (int c = 0; c < sample_columns - 1; c++)
+		{
+			unsigned int a = r * sample_columns + c, b = a + 1, d = a + sample_columns, e = d + 1;
+			indices.push_back(a); indices.push_back(b); indices.push_back(d);
+			indices.push_back(b); indices.push_back(e); indices.push_back(d);
+		}
+	}
+
+	hits = misses = evictions = failures = 0;
+	resident_bytes = peak_resident_bytes = 0;
+	build_ms = 0.0;
+	return true;
+}
+
+size_t TerrainTilesCore::tile_bytes() const
+{
+	return (size_t)sample_rows * sample_columns * sizeof(Vertex);
+}
+
+glm::vec3 TerrainTilesCore::tile_origin(size_t id) const
+{
+	return glm::vec3(origin.x + tiles[id].row * (sample_rows - 1) * spacing, 0.0f,
+		origin.y + tiles[id].column * (sample_columns - 1) * spacing);
+}
+
+std::string TerrainTilesCore::tile_path(int row, int column) const
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%d_%d.raw", row, column);
+	return folder + name;
+}
+
+bool TerrainTilesCore::build_tile(size_t id, std::vector<Vertex>& out, float& low, float& high) const
+{
+	const Tile& tile = tiles[id];
+	size_t count = (size_t)sample_rows * sample_columns;
+	size_t sample_size = format == FORMAT_F32 ? 4 : 2;
+
+	MappedFile file;
+	if (!file.open(tile_path(tile.row, tile.column)) || file.size() != count * sample_size)
+		return false;
+
+	// world heights first, the normals need the neighbours
+	std::vector<float> heights(count);
+	const unsigned char* data = file.data();
+	for (size_t i = 0; i < count; i++)
+	{
+		float sample;
+		if (format == FORMAT_F32)
+			memcpy(&sample, data + i * 4, 4);
+		else
+		{
+			uint16_t value;
+			memcpy(&value, data + i * 2, 2);
+			sample = float(value);
+		}
+		heights[i] = offset + sample * scale;
+	}
+
+	low = *std::min_element(heights.begin(), heights.end());
+	high = *std::max_element(heights.begin(), heights.end());
+
+	out.resize(count);
+	for (int r = 0; r < sample_rows; r++)
+	{
+		for (int c = 0; c < sample_columns; c++)
+		{
+			// central differences, one sided on the border of the tile
+			int up = std::min(r + 1, sample_rows - 1), down = std::max(r - 1, 0);
+			int right = std::min(c + 1, sample_columns - 1), left = std::max(c - 1, 0);
+			float slope_x = (heights[(size_t)up * sample_columns + c] - heights[(size_t)down * sample_columns + c]) / (float(up - down) * spacing);
+			float slope_z = (heights[(size_t)r * sample_columns + right] - heights[(size_t)r * sample_columns + left]) / (float(right - left) * spacing);
+
+			Vertex& v = out[(size_t)r * sample_columns + c];
+			v.Position = glm::vec3(r * spacing, heights[(size_t)r * sample_columns + c], c * spacing);
+			v.Normal = glm::normalize(glm::vec3(-slope_x, 1.0f, -slope_z));
+			v.TexCoords = glm::vec2(float(r) / float(sample_rows - 1), float(c) / float(sample_columns - 1));
+		}
+	}
+	return true;
+}
+
+void TerrainTilesCore::collect()
+{
+	std::vector<Finished> done;
+	{
+		std::unique_lock<std::mutex> lock(finished_mutex);
+		done.swap(finished);
+	}
+
+	for (size_t i = 0; i < done.size(); i++)
+	{
+		Tile& tile = tiles[done[i].id];
+		loading--;
+		build_ms += done[i].ms;
+
+		if (done[i].ok)
+			tile.state = TILE_LOADED;
+		else
+		{
+			// a broken tile is left out for good, its room in the budget is free again
+			tile.state = TILE_FAILED;
+			std::vector<Vertex>().swap(tile.vertices);
+			resident_bytes -= tile_bytes();
+			failures++;
+		}
+	}
+}
+
+void TerrainTilesCore::wait()
+{
+	while (loading > 0)
+	{
+		collect();
+		if (loading > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+void TerrainTilesCore::clear()
+{
+	wait();
+	while (!used.empty())
+		evict(used.back());
+	for (size_t id = 0; id < tiles.size(); id++)
+	{
+		if (tiles[id].state == TILE_LOADED)
+		{
+			std::vector<Vertex>().swap(tiles[id].vertices);
+			tiles[id].state = TILE_EMPTY;
+			resident_bytes -= tile_bytes();
+		}
+	}
+}
+
+void TerrainTilesCore::evict(size_t id)
+{
+	Tile& tile = tiles[id];
+	release_tile(id);
+	std::vector<Vertex>().swap(tile.vertices);
+	used.erase(tile.used);
+	tile.state = TILE_EMPTY;
+	resident_bytes -= tile_bytes();
+	evictions++;
+}
+
+void TerrainTilesCore::update(glm::vec3 camera)
+{
+	if (tiles.empty()) return;
+	frame++;
+
+	// the loader's results, and a few of them uploaded
+	collect();
+	int uploads = 0;
+	for (size_t id = 0; id < tiles.size() && uploads < uploads_per_frame; id++)
+	{
+		Tile& tile = tiles[id];
+		if (tile.state != TILE_LOADED) continue;
+
+		upload_tile(id);
+		tile.state = TILE_RESIDENT;
+		used.push_front(id);
+		tile.used = used.begin();
+		uploads++;
+	}
+
+	// tiles within view_distance of the camera, nearest first
+	std::vector<std::pair<float, size_t> > wanted;
+	float tile_x = (sample_rows - 1) * spacing, tile_z = (sample_columns - 1) * spacing;
+	for (size_t id = 0; id < tiles.size(); id++)
+	{
+		glm::vec3 lower = tile_origin(id);
+		float dx = std::max(0.0f, std::max(lower.x - camera.x, camera.x - (lower.x + tile_x)));
+		float dz = std::max(0.0f, std::max(lower.z - camera.z, camera.z - (lower.z + tile_z)));
+		float distance = sqrt(dx * dx + dz * dz);
+		if (distance <= view_distance)
+		{
+			wanted.push_back(std::make_pair(distance, id));
+			wanted_frame[id] = frame;
+		}
+	}
+	std::sort(wanted.begin(), wanted.end());
+
+	for (size_t i = 0; i < wanted.size(); i++)
+	{
+		size_t id = wanted[i].second;
+		Tile& tile = tiles[id];
+
+		if (tile.state == TILE_RESIDENT)
+		{
+			// most recently used goes to the front
+			hits++;
+			used.splice(used.begin(), used, tile.used);
+			continue;
+		}
+		if (tile.state != TILE_EMPTY) continue;
+
+		// make room by dropping the least recently used tiles nobody wants this frame
+		while (resident_bytes + tile_bytes() > memory_budget && !used.empty() && wanted_frame[used.back()] != frame)
+			evict(used.back());
+
+		// the nearer tiles fill the budget, the rest has to wait until the camera moves
+		if (resident_bytes + tile_bytes() > memory_budget)
+			break;
+
+		misses++;
+		tile.state = TILE_LOADING;
+		resident_bytes += tile_bytes();
+		peak_resident_bytes = std::max(peak_resident_bytes, resident_bytes);
+		loading++;
+
+		loader.enqueue([this, id]()
+		{
+			Finished result;
+			result.id = id;
+			result.ok = false;
+			result.ms = 0.0;
+
+			if (!closing)
+			{
+				auto start = std::chrono::steady_clock::now();
+				Tile& tile = tiles[id];
+				result.ok = build_tile(id, tile.vertices, tile.low, tile.high);
+				result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			std::unique_lock<std::mutex> lock(finished_mutex);
+			finished.push_back(result);
+		});
+	}
+}
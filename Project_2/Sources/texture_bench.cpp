@@ -0,0 +1,420 @@
+/*** @file texture_bench.cpp
+*
+*   @brief Headless benchmark for the texture decode threads (TextureLoaderCore)
+*
+*   stb_image isn't part of the headless build, so the shipped textures are "decoded" by a
+*   stand-in that reads the whole file and expands it to the size and channels in its PNG
+*   or JPEG header with one pass over the pixels. That leaves out the inflate and the IDCT,
+*   the viewer prints the real decode times and the time to its first frame with and without
+*   parallelTextureDecode. Times the textures the viewer loads decoded one after another on
+*   this thread against the decode threads, both with their mip levels.
+*
+*   Checks that both ways give the same pixels and mip levels, that the images are handed
+*   back in the order they were asked for whichever finishes first, that upload_ready()
+*   never waits or skips one, that a missing file comes back failed in its place, that the
+*   mip levels have the sizes GL expects and average the level above them, and that every
+*   decoded image is released.
+*
+*   The texture registry is timed against the linear search of every texture loaded so far
+*   that Model used to do, and checked to share a texture between spellings of one path but
+*   not between sRGB and linear, and to give back its memory with the last reference.
+*   The exit code is 1 if any check fails.
+*
+*   usage: texture_bench [media folder]
+*   e.g.   texture_bench ../Project_2/Media/
+**/
+
+#include <texture_loader_core.hpp>
+#include <texture_registry_core.hpp>
+#include <mapped_file.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool report(const char* name, bool ok)
+{
+	std::printf("%-44s %s\n", name, ok ? "ok" : "WRONG");
+	return ok;
+}
+
+static std::atomic<size_t> decoded_images(0), released_images(0);
+
+// size and channels from the IHDR of a PNG or the SOF of a JPEG
+static bool image_header(const unsigned char* data, size_t size, int* width, int* height, int* channels)
+{
+	if (size > 26 && memcmp(data, "\x89PNG", 4) == 0)
+	{
+		*width = (data[16] << 24) | (data[17] << 16) | (data[18] << 8) | data[19];
+		*height = (data[20] << 24) | (data[21] << 16) | (data[22] << 8) | data[23];
+		int color_type = data[25];
+		*channels = color_type == 0 ? 1 : color_type == 4 ? 2 : color_type == 2 ? 3 : 4;
+		return true;
+	}
+	if (size > 4 && data[0] == 0xFF && data[1] == 0xD8)
+	{
+		for (size_t i = 2; i + 9 < size; )
+		{
+			if (data[i] != 0xFF) return false;
+			unsigned char marker = data[i + 1];
+			size_t length = (data[i + 2] << 8) | data[i + 3];
+			if (marker >= 0xC0 && marker <= 0xC2)
+			{
+				*height = (data[i + 5] << 8) | data[i + 6];
+				*width = (data[i + 7] << 8) | data[i + 8];
+				*channels = data[i + 9];
+				return true;
+			}
+			i += 2 + length;
+		}
+	}
+	return false;
+}
+
+// stands in for stbi_load: the pixels are the file's bytes run through a little state, every byte of the output written once
+static unsigned char* read_image(const char* path, int* width, int* height, int* channels)
+{
+	MappedFile file;
+	if (!file.open(path) || !image_header(file.data(), file.size(), width, height, channels))
+		return NULL;
+
+	size_t count = (size_t)*width * *height * *channels;
+	unsigned char* pixels = (unsigned char*)malloc(count);
+	const unsigned char* data = file.data();
+	size_t size = file.size();
+	unsigned int state = 2166136261u;
+	for (size_t i = 0, j = 0; i < count; i++)
+	{
+		state = (state ^ data[j]) * 16777619u;
+		pixels[i] = (unsigned char)(state >> 13);
+		if (++j == size) j = 0;
+	}
+	decoded_images++;
+	return pixels;
+}
+
+static void release_image(unsigned char* pixels)
+{
+	released_images++;
+	free(pixels);
+}
+
+// what one upload saw: its place, the file, and a hash of every level
+struct Uploaded {
+	size_t index;
+	std::string path;
+	bool ok;
+	int levels;
+	unsigned long long hash;
+};
+
+static TextureLoaderCore::UploadFunction record(std::vector<Uploaded>& uploads)
+{
+	return [&uploads](const TextureLoaderCore::Image& image, size_t index)
+	{
+		Uploaded upload = { index, image.path, image.ok(), image.level_count(), 0 };
+		upload.hash = hash_bytes(&image.width, sizeof(int) * 3);
+		for (int l = 0; l < image.level_count(); l++)
+		{
+			int w, h;
+			const unsigned char* pixels = image.level(l, w, h);
+			upload.hash = hash_bytes(pixels, (size_t)w * h * image.channels, upload.hash);
+		}
+		uploads.push_back(upload);
+	};
+}
+
+static void setup(TextureLoaderCore& loader, bool parallel)
+{
+	loader.decode = read_image;
+	loader.release = release_image;
+	loader.parallel = parallel;
+	loader.cpu_mipmaps = true;
+}
+
+// in order, one after another, for these files
+static bool in_order(const std::vector<Uploaded>& uploads, const std::vector<std::string>& files)
+{
+	if (uploads.size() != files.size()) return false;
+	for (size_t i = 0; i < uploads.size(); i++)
+		if (uploads[i].index != i || uploads[i].path != files[i])
+			return false;
+	return true;
+}
+
+static bool same_images(const std::vector<Uploaded>& a, const std::vector<Uploaded>& b)
+{
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if (a[i].ok != b[i].ok || a[i].levels != b[i].levels || a[i].hash != b[i].hash)
+			return false;
+	return true;
+}
+
+// the texture files of the viewer in the order it asks for them
+static std::vector<std::string> viewer_textures(const std::string& media)
+{
+	std::vector<std::string> files;
+	const char* faces[] = { "right", "left", "top", "bottom", "back", "front" };
+	for (int i = 0; i < 6; i++)
+		files.push_back(media + "skybox/" + faces[i] + ".jpg");
+	files.push_back(media + "skybox_old/bottom.jpg");
+	files.push_back(media + "textures/container2.png");
+	files.push_back(media + "textures/container2_specular.png");
+
+	const char* models[] = { "nanosuit/", "shell_car/" };
+	for (int m = 0; m < 2; m++)
+	{
+		std::vector<std::string> found;
+		for (const auto& entry : std::filesystem::directory_iterator(media + models[m]))
+			if (entry.path().extension() == ".png")
+				found.push_back(media + models[m] + entry.path().filename().string());
+		std::sort(found.begin(), found.end());
+		files.insert(files.end(), found.begin(), found.end());
+	}
+	return files;
+}
+
+struct Run {
+	std::vector<Uploaded> uploads;
+	// until request() returned for every file, and until the last one was handed over
+	double request_ms, total_ms;
+	double decode_ms, mipmap_ms, wait_ms;
+	size_t bytes;
+};
+
+static Run load_all(const std::vector<std::string>& files, bool parallel)
+{
+	Run run;
+	TextureLoaderCore loader;
+	setup(loader, parallel);
+
+	double t0 = now_ms();
+	for (size_t i = 0; i < files.size(); i++)
+		loader.request(files[i], true);
+	run.request_ms = now_ms() - t0;
+	loader.finish(record(run.uploads));
+	run.total_ms = now_ms() - t0;
+
+	run.decode_ms = loader.decode_ms;
+	run.mipmap_ms = loader.mipmap_ms;
+	run.wait_ms = loader.wait_ms;
+	run.bytes = loader.image_bytes;
+	return run;
+}
+
+// 2x2 averages of a 4x2 image down to 1x1, and the level sizes of odd and long images
+static bool check_mipmaps()
+{
+	TextureLoaderCore::Image image;
+	unsigned char pixels[] = { 0, 4, 8, 12, 2, 6, 10, 14 };
+	image.width = 4;
+	image.height = 2;
+	image.channels = 1;
+	image.pixels = pixels;
+	TextureLoaderCore::make_mipmaps(image);
+
+	int w, h;
+	bool ok = image.level_count() == 3;
+	const unsigned char* level1 = ok ? image.level(1, w, h) : NULL;
+	ok = ok && w == 2 && h == 1 && level1[0] == 3 && level1[1] == 11;
+	const unsigned char* level2 = ok ? image.level(2, w, h) : NULL;
+	ok = ok && w == 1 && h == 1 && level2[0] == 7;
+
+	// 5x3 RGB: 2x1, 1x1
+	std::vector<unsigned char> odd(5 * 3 * 3, 200);
+	image.width = 5;
+	image.height = 3;
+	image.channels = 3;
+	image.pixels = &odd[0];
+	TextureLoaderCore::make_mipmaps(image);
+	ok = ok && image.level_count() == 3;
+	const unsigned char* odd1 = ok ? image.level(1, w, h) : NULL;
+	ok = ok && w == 2 && h == 1 && odd1[5] == 200;
+	ok = ok && image.level(2, w, h) != NULL && w == 1 && h == 1 && image.mip_pixels.size() == (2 + 1) * 3;
+
+	// 1024x1024: 11 levels, 16x1: 5 levels
+	std::vector<unsigned char> square(1024 * 1024 * 4, 7), line(16, 9);
+	image.width = image.height = 1024;
+	image.channels = 4;
+	image.pixels = &square[0];
+	TextureLoaderCore::make_mipmaps(image);
+	ok = ok && image.level_count() == 11 && image.level(10, w, h)[3] == 7 && w == 1 && h == 1;
+	image.width = 16;
+	image.height = 1;
+	image.channels = 1;
+	image.pixels = &line[0];
+	TextureLoaderCore::make_mipmaps(image);
+	ok = ok && image.level_count() == 5 && image.level(4, w, h)[0] == 9 && w == 1 && h == 1;
+
+	// sRGB black and white average to the sRGB of half the light, alpha stays linear
+	unsigned char srgb[] = { 0, 0, 0, 0, 255, 255, 255, 255 };
+	image.width = 2;
+	image.height = 1;
+	image.channels = 4;
+	image.srgb = true;
+	image.pixels = srgb;
+	TextureLoaderCore::make_mipmaps(image);
+	const unsigned char* mixed = image.level(1, w, h);
+	ok = ok && image.level_count() == 2 && mixed[0] == 188 && mixed[2] == 188 && mixed[3] == 128;
+
+	image.pixels = NULL;
+	return ok;
+}
+
+// the same name in more spellings shares one texture, sRGB doesn't, the last release frees it
+static bool check_registry()
+{
+	bool ok = TextureRegistryCore::normalize_path("a\\b//./c/../d.png") == "a/b/d.png"
+		&& TextureRegistryCore::normalize_path("../Project_2/Media/nanosuit/../textures/wall.jpg") == "../Project_2/Media/textures/wall.jpg"
+		&& TextureRegistryCore::normalize_path("./nanosuit/arm_dif.png") == "nanosuit/arm_dif.png"
+		&& TextureRegistryCore::normalize_path("/a/../../b.png") == "/b.png"
+		&& TextureRegistryCore::normalize_path("a/../../b.png") == "../b.png";
+
+	TextureRegistryCore registry;
+	std::string name = TextureRegistryCore::normalize_path("Media/nanosuit/arm_dif.png");
+	ok = ok && registry.acquire(name, false) == 0;
+	registry.insert(name, false, 7);
+	registry.add_bytes(7, 1000);
+	ok = ok && registry.acquire(TextureRegistryCore::normalize_path("Media/shell_car/../nanosuit//arm_dif.png"), false) == 7;
+	ok = ok && registry.acquire(name, true) == 0;
+	registry.insert(name, true, 8);
+	registry.add_bytes(8, 500);
+
+	const TextureRegistryCore::Entry* entry = registry.find(7);
+	ok = ok && entry != NULL && entry->references == 2 && registry.texture_count() == 2 && registry.total_bytes() == 1500;
+	ok = ok && !registry.release(7) && registry.total_bytes() == 1500;
+	ok = ok && registry.release(7) && registry.total_bytes() == 500 && registry.find(7) == NULL;
+	ok = ok && registry.acquire(name, false) == 0 && registry.acquire(name, true) == 8;
+	registry.add_bytes(7, 100);
+	ok = ok && !registry.release(8) && registry.release(8) && registry.texture_count() == 0 && registry.total_bytes() == 0;
+	ok = ok && !registry.release(8);
+	ok = ok && registry.lookups == 5 && registry.hits == 2;
+	return ok;
+}
+
+// lookups of names among count textures, through the registry and the way Model searched its textures_loaded
+static void bench_registry(size_t count, size_t lookups)
+{
+	std::vector<std::string> names(count);
+	TextureRegistryCore registry;
+	for (size_t i = 0; i < count; i++)
+	{
+		names[i] = "../Project_2/Media/model" + std::to_string(i / 16) + "/texture_" + std::to_string(i) + ".png";
+		registry.insert(names[i], false, (unsigned int)i + 1);
+	}
+
+	unsigned int sum = 0;
+	double t0 = now_ms();
+	for (size_t i = 0; i < lookups; i++)
+		sum += registry.acquire(names[(i * 7919) % count], false);
+	double hashed_ms = now_ms() - t0;
+
+	t0 = now_ms();
+	for (size_t i = 0; i < lookups; i++)
+	{
+		const std::string& name = names[(i * 7919) % count];
+		for (size_t j = 0; j < count; j++)
+			if (strcmp(names[j].c_str(), name.c_str()) == 0)
+			{
+				sum -= (unsigned int)j + 1;
+				break;
+			}
+	}
+	double linear_ms = now_ms() - t0;
+
+	std::printf("%-12zu %10zu %12.2f %12.2f %s\n", count, lookups, hashed_ms, linear_ms, sum == 0 ? "" : "(different textures)");
+}
+
+int main(int argc, char** argv)
+{
+	std::string media = argc > 1 ? argv[1] : "../Project_2/Media/";
+	if (!std::filesystem::exists(media + "skybox/right.jpg"))
+	{
+		std::printf("no textures in %s\n", media.c_str());
+		return 1;
+	}
+	std::vector<std::string> files = viewer_textures(media);
+	bool passed = true;
+
+	// the textures the viewer loads, one after another and on the decode threads
+	Run serial = load_all(files, false);
+	Run parallel = load_all(files, true);
+
+	std::printf("%zu textures, %.1f MB with mip levels, %u decode threads\n\n", files.size(), parallel.bytes / (1024.0 * 1024.0),
+		TextureLoaderCore::decode_threads());
+	std::printf("%-12s %11s %10s %10s %10s %10s\n", "", "request ms", "total ms", "decode ms", "mipmap ms", "waited ms");
+	std::printf("%-12s %11.1f %10.1f %10.1f %10.1f %10.1f\n", "serial", serial.request_ms, serial.total_ms, serial.decode_ms,
+		serial.mipmap_ms, serial.wait_ms);
+	std::printf("%-12s %11.1f %10.1f %10.1f %10.1f %10.1f\n", "parallel", parallel.request_ms, parallel.total_ms,
+		parallel.decode_ms, parallel.mipmap_ms, parallel.wait_ms);
+	std::printf("(request ms is how soon the main thread can get on with the heightmap and the track;\n"
+		" the viewer prints its stb_image times and the time to its first frame)\n\n");
+
+	std::printf("%-12s %10s %12s %12s\n", "textures", "lookups", "registry ms", "linear ms");
+	bench_registry(28, 100000);
+	bench_registry(1000, 100000);
+	std::printf("\n");
+
+	passed = report("decode threads give the same pixels", same_images(serial.uploads, parallel.uploads)) && passed;
+	passed = report("handed back in request order", in_order(serial.uploads, files) && in_order(parallel.uploads, files)) && passed;
+	{
+		bool all = serial.uploads.size() == files.size();
+		for (size_t i = 0; all && i < serial.uploads.size(); i++)
+			all = serial.uploads[i].ok && serial.uploads[i].levels > 1;
+		passed = report("every texture decoded with mip levels", all) && passed;
+	}
+
+	// upload_ready() takes what's there from the front, a missing file comes back failed in its place
+	{
+		std::vector<std::string> mixed;
+		mixed.push_back(files[0]);
+		mixed.push_back(media + "missing.png");
+		mixed.insert(mixed.end(), files.begin() + 1, files.end());
+
+		std::vector<Uploaded> uploads;
+		TextureLoaderCore loader;
+		setup(loader, true);
+		for (size_t i = 0; i < mixed.size(); i++)
+			loader.request(mixed[i], true);
+
+		bool never_waits = true;
+		while (loader.uploaded() < loader.requested())
+		{
+			loader.upload_ready(record(uploads));
+			never_waits = never_waits && loader.wait_ms == 0.0;
+		}
+		passed = report("upload_ready() never waits or skips", never_waits && in_order(uploads, mixed)) && passed;
+		passed = report("missing file handed back failed", uploads.size() > 1 && !uploads[1].ok && uploads[1].levels == 0
+			&& loader.failed_count == 1 && uploads[2].ok) && passed;
+	}
+
+	passed = report("mip levels halve and average", check_mipmaps()) && passed;
+	passed = report("registry shares by path and frees the last", check_registry()) && passed;
+
+	// a loader that goes away before it was drained still releases what it decoded
+	{
+		TextureLoaderCore loader;
+		setup(loader, true);
+		for (size_t i = 0; i < files.size(); i++)
+			loader.request(files[i], true);
+	}
+	passed = report("every decoded image released", decoded_images == released_images) && passed;
+
+	if (!passed)
+		std::printf("\nFAILED\n");
+	return passed ? 0 : 1;
+}
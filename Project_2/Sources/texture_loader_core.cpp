@@ -0,0 +1,239 @@
+/*** @file texture_loader_core.cpp
+*
+*   @brief Texture images decoded and mipmapped on the decode threads, handed back in request order
+**/
+
+#include <texture_loader_core.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+
+
+// Not the shared pool: its queue runs jobs in order, so a parallel_for() of the heightmap or the track asked
+// for while the images are decoding would wait behind all of them. Decoding is mostly waiting on memory and
+// the file, having both pools busy for a moment at startup costs less than that.
+static ThreadPool& decode_pool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+// sRGB byte -> linear, and linear in 1/4096 steps -> sRGB byte
+struct SrgbTables {
+	float to_linear[256];
+	unsigned char to_srgb[4097];
+
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			to_linear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= 4096; i++)
+		{
+			float l = i / 4096.0f;
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+			to_srgb[i] = (unsigned char)std::min(255.0f, c * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const SrgbTables& srgb_tables()
+{
+	static SrgbTables tables;
+	return tables;
+}
+
+static double ms_since(std::chrono::steady_clock::time_point t0)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+const unsigned char* TextureLoaderCore::Image::level(int index, int& level_width, int& level_height) const
+{
+	level_width = width;
+	level_height = height;
+	for (int i = 0; i < index; i++)
+	{
+		level_width = std::max(1, level_width / 2);
+		level_height = std::max(1, level_height / 2);
+	}
+	return index == 0 ? pixels : &mip_pixels[mip_offsets[index - 1]];
+}
+
+unsigned int TextureLoaderCore::decode_threads()
+{
+	return decode_pool().size();
+}
+
+void TextureLoaderCore::make_mipmaps(Image& image)
+{
+	image.mip_pixels.clear();
+	image.mip_offsets.clear();
+	if (!image.ok()) return;
+
+	// sizes first so all the levels take one allocation
+	int channels = image.channels;
+	size_t total = 0;
+	for (int w = image.width, h = image.height; w > 1 || h > 1; )
+	{
+		w = std::max(1, w / 2);
+		h = std::max(1, h / 2);
+		image.mip_offsets.push_back(total);
+		total += (size_t)w * h * channels;
+	}
+	image.mip_pixels.resize(total);
+
+	// the colour channels of an sRGB image, alpha stays linear
+	int srgb_channels = image.srgb && channels >= 3 ? 3 : 0;
+	const SrgbTables& tables = srgb_tables();
+
+	const unsigned char* source = image.pixels;
+	int source_width = image.width, source_height = image.height;
+	for (size_t l = 0; l < image.mip_offsets.size(); l++)
+	{
+		int w = std::max(1, source_width / 2), h = std::max(1, source_height / 2);
+		unsigned char* target = &image.mip_pixels[image.mip_offsets[l]];
+		size_t stride = (size_t)source_width * channels;
+
+		for (int y = 0; y < h; y++)
+		{
+			// a level one texel high or wide averages the texel with itself
+			const unsigned char* row0 = source + std::min(2 * y, source_height - 1) * stride;
+			const unsigned char* row1 = source + std::min(2 * y + 1, source_height - 1) * stride;
+			unsigned char* out = target + (size_t)y * w * channels;
+			for (int x = 0; x < w; x++)
+			{
+				int x0 = std::min(2 * x, source_width - 1) * channels;
+				int x1 = std::min(2 * x + 1, source_width - 1) * channels;
+				for (int c = 0; c < srgb_channels; c++)
+				{
+					float linear = tables.to_linear[row0[x0 + c]] + tables.to_linear[row0[x1 + c]]
+						+ tables.to_linear[row1[x0 + c]] + tables.to_linear[row1[x1 + c]];
+					out[x * channels + c] = tables.to_srgb[(int)(linear * 1024.0f + 0.5f)];
+				}
+				for (int c = srgb_channels; c < channels; c++)
+					out[x * channels + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+			}
+		}
+
+		source = target;
+		source_width = w;
+		source_height = h;
+	}
+}
+
+void TextureLoaderCore::decode_image(Image& image, bool mipmaps)
+{
+	auto t0 = std::chrono::steady_clock::now();
+	if (decode)
+		image.pixels = decode(image.path.c_str(), &image.width, &image.height, &image.channels);
+	if (image.pixels == NULL)
+		image.width = image.height = image.channels = 0;
+	image.decode_ms = ms_since(t0);
+
+	if (mipmaps && image.ok())
+	{
+		t0 = std::chrono::steady_clock::now();
+		make_mipmaps(image);
+		image.mipmap_ms = ms_since(t0);
+	}
+}
+
+void TextureLoaderCore::free_pixels(Image& image)
+{
+	if (image.pixels != NULL)
+	{
+		if (release) release(image.pixels);
+		else free(image.pixels);
+	}
+	image.pixels = NULL;
+	std::vector<unsigned char>().swap(image.mip_pixels);
+	std::vector<size_t>().swap(image.mip_offsets);
+}
+
+size_t TextureLoaderCore::request(const std::string& path, bool mipmaps, bool srgb)
+{
+	size_t index = images.size();
+	images.emplace_back();
+	Image* image = &images.back();
+	image->path = path;
+	image->mipmaps = mipmaps;
+	image->srgb = srgb;
+	bool make_mipmaps = mipmaps && cpu_mipmaps;
+
+	if (!parallel)
+	{
+		decode_image(*image, make_mipmaps);
+		image->decoded = true;
+		return index;
+	}
+
+	decode_pool().enqueue([this, image, make_mipmaps]()
+	{
+		decode_image(*image, make_mipmaps);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		image->decoded = true;
+		decoded.notify_all();
+	});
+	return index;
+}
+
+size_t TextureLoaderCore::drain(const UploadFunction& upload, bool wait)
+{
+	size_t count = 0;
+	while (next_upload < images.size())
+	{
+		Image& image = images[next_upload];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!image.decoded)
+			{
+				if (!wait) break;
+				auto t0 = std::chrono::steady_clock::now();
+				while (!image.decoded) decoded.wait(lock);
+				wait_ms += ms_since(t0);
+			}
+		}
+
+		upload(image, next_upload);
+
+		image_count++;
+		if (!image.ok()) failed_count++;
+		image_bytes += (size_t)image.width * image.height * image.channels + image.mip_pixels.size();
+		decode_ms += image.decode_ms;
+		mipmap_ms += image.mipmap_ms;
+
+		// the texture has it now
+		free_pixels(image);
+		next_upload++;
+		count++;
+	}
+	return count;
+}
+
+size_t TextureLoaderCore::upload_ready(const UploadFunction& upload)
+{
+	return drain(upload, false);
+}
+
+size_t TextureLoaderCore::finish(const UploadFunction& upload)
+{
+	return drain(upload, true);
+}
+
+TextureLoaderCore::~TextureLoaderCore()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (size_t i = next_upload; i < images.size(); i++)
+	{
+		while (!images[i].decoded) decoded.wait(lock);
+		free_pixels(images[i]);
+	}
+}
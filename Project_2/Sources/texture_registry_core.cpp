@@ -0,0 +1,91 @@
+/*** @file texture_registry_core.cpp
+*
+*   @brief Shared textures by normalized path, counted references and texture memory
+**/
+
+#include <texture_registry_core.hpp>
+
+#include <vector>
+
+
+std::string TextureRegistryCore::normalize_path(const std::string& path)
+{
+	bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+
+	// the parts between the slashes, '.' dropped and '..' taking the part before it with it
+	std::vector<std::string> parts;
+	size_t begin = 0;
+	while (begin <= path.size())
+	{
+		size_t end = path.find_first_of("/\\", begin);
+		if (end == std::string::npos) end = path.size();
+		std::string part = path.substr(begin, end - begin);
+		begin = end + 1;
+
+		if (part.empty() || part == ".") continue;
+		if (part == ".." && !parts.empty() && parts.back() != "..")
+			parts.pop_back();
+		else if (part != ".." || !absolute)
+			parts.push_back(part);
+	}
+
+	std::string normalized = absolute ? "/" : "";
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		if (i > 0) normalized += '/';
+		normalized += parts[i];
+	}
+	return normalized.empty() ? std::string(".") : normalized;
+}
+
+std::string TextureRegistryCore::key(const std::string& name, bool srgb)
+{
+	std::string key = name;
+	key += '\0';
+	key += srgb ? 's' : 'l';
+	return key;
+}
+
+unsigned int TextureRegistryCore::acquire(const std::string& name, bool srgb)
+{
+	lookups++;
+	auto found = by_name.find(key(name, srgb));
+	if (found == by_name.end()) return 0;
+
+	hits++;
+	by_id[found->second].references++;
+	return found->second;
+}
+
+void TextureRegistryCore::insert(const std::string& name, bool srgb, unsigned int id)
+{
+	Entry entry = { id, name, srgb, 1, 0 };
+	by_name[key(name, srgb)] = id;
+	by_id[id] = entry;
+}
+
+bool TextureRegistryCore::release(unsigned int id)
+{
+	auto found = by_id.find(id);
+	if (found == by_id.end()) return false;
+	if (--found->second.references > 0) return false;
+
+	bytes -= found->second.bytes;
+	by_name.erase(key(found->second.name, found->second.srgb));
+	by_id.erase(found);
+	return true;
+}
+
+void TextureRegistryCore::add_bytes(unsigned int id, size_t count)
+{
+	auto found = by_id.find(id);
+	if (found == by_id.end()) return;
+	found->second.bytes += count;
+	bytes += count;
+}
+
+const TextureRegistryCore::Entry* TextureRegistryCore::find(unsigned int id) const
+{
+	auto found = by_id.find(id);
+	return found == by_id.end() ? NULL : &found->second;
+}
@@ -0,0 +1,266 @@
+/*** @file tiles_bench.cpp
+*
+*   @brief Headless benchmark for the streamed terrain tiles (TerrainTilesCore)
+*
+*   Writes a generated tile set of 16 bit tiles to a temporary folder and flies a camera
+*   across it and back with a memory budget well below the size of the whole terrain,
+*   counting cache hits, misses and evictions, the time update() takes on the calling
+*   thread and the time the loader thread spends building each tile.
+*
+*   Checks that the tiles in memory never go over the budget, that every loaded tile has
+*   the heights that were written, that neighbouring tiles meet on their shared edge, that a
+*   float tile set loads exactly, and that a broken tile or tile set file is reported.
+*   The exit code is 1 if any check fails.
+*
+*   usage: tiles_bench [tiles per side] [samples per tile side] [budget MB]
+*   e.g.   tiles_bench 16 513 256
+**/
+
+#include <terrain_tiles_core.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// rolling hills over the whole survey, x and z in samples from its first one
+static float survey_height(int x, int z)
+{
+	return 0.5f + 0.25f * sin(0.004f * x + 1.0f) * cos(0.005f * z) + 0.15f * sin(0.011f * (x + z));
+}
+
+// the 16 bit sample of survey_height, the same for both tiles on a shared edge
+static uint16_t survey_sample(int x, int z)
+{
+	return (uint16_t)(survey_height(x, z) * 65535.0f);
+}
+
+// the tile set file and one raw file per tile
+static bool write_tile_set(const std::string& folder, int tiles, int samples, bool as_float)
+{
+	std::filesystem::create_directories(folder);
+
+	FILE* file = fopen((folder + "terrain.tiles").c_str(), "w");
+	if (file == NULL) return false;
+	fprintf(file, "# generated by tiles_bench\n");
+	fprintf(file, "tiles %d %d\n", tiles, tiles);
+	fprintf(file, "samples %d %d   # shared edges\n", samples, samples);
+	fprintf(file, "format %s\n", as_float ? "f32" : "u16");
+	fprintf(file, "spacing 0.1\n");
+	fprintf(file, "scale %s\n", as_float ? "1" : "0.0002");
+	fprintf(file, "offset -25\n");
+	fprintf(file, "origin 0 0\n");
+	fclose(file);
+
+	std::vector<uint16_t> shorts((size_t)samples * samples);
+	std::vector<float> floats((size_t)samples * samples);
+	for (int row = 0; row < tiles; row++)
+	{
+		for (int column = 0; column < tiles; column++)
+		{
+			for (int r = 0; r < samples; r++)
+				for (int c = 0; c < samples; c++)
+				{
+					int x = row * (samples - 1) + r, z = column * (samples - 1) + c;
+					shorts[(size_t)r * samples + c] = survey_sample(x, z);
+					floats[(size_t)r * samples + c] = survey_height(x, z) * 13.0f;
+				}
+
+			char name[64];
+			snprintf(name, sizeof(name), "%d_%d.raw", row, column);
+			FILE* tile = fopen((folder + name).c_str(), "wb");
+			if (tile == NULL) return false;
+			if (as_float)
+				fwrite(&floats[0], sizeof(float), floats.size(), tile);
+			else
+				fwrite(&shorts[0], sizeof(uint16_t), shorts.size(), tile);
+			fclose(tile);
+		}
+	}
+	return true;
+}
+
+// every tile that is in memory has the heights that were written
+static bool check_heights(const TerrainTilesCore& terrain, bool as_float)
+{
+	for (size_t id = 0; id < terrain.tiles.size(); id++)
+	{
+		const TerrainTilesCore::Tile& tile = terrain.tiles[id];
+		if (tile.state != TerrainTilesCore::TILE_RESIDENT) continue;
+
+		for (int r = 0; r < terrain.sample_rows; r++)
+			for (int c = 0; c < terrain.sample_columns; c++)
+			{
+				int x = tile.row * (terrain.sample_rows - 1) + r, z = tile.column * (terrain.sample_columns - 1) + c;
+				float sample = as_float ? survey_height(x, z) * 13.0f : float(survey_sample(x, z));
+				if (tile.vertices[(size_t)r * terrain.sample_columns + c].Position.y != terrain.offset + sample * terrain.scale)
+					return false;
+			}
+	}
+	return true;
+}
+
+// neighbouring tiles in memory meet: the same heights and (within rounding) the same world positions on the shared edge
+static bool check_edges(const TerrainTilesCore& terrain)
+{
+	for (size_t id = 0; id < terrain.tiles.size(); id++)
+	{
+		const TerrainTilesCore::Tile& tile = terrain.tiles[id];
+		if (tile.state != TerrainTilesCore::TILE_RESIDENT || tile.row + 1 >= terrain.tile_rows) continue;
+
+		size_t below = id + terrain.tile_columns;
+		if (terrain.tiles[below].state != TerrainTilesCore::TILE_RESIDENT) continue;
+
+		for (int c = 0; c < terrain.sample_columns; c++)
+		{
+			const Vertex& a = tile.vertices[(size_t)(terrain.sample_rows - 1) * terrain.sample_columns + c];
+			const Vertex& b = terrain.tiles[below].vertices[c];
+			glm::vec3 world_a = terrain.tile_origin(id) + a.Position;
+			glm::vec3 world_b = terrain.tile_origin(below) + b.Position;
+			if (a.Position.y != b.Position.y || glm::length(world_a - world_b) > 1.0e-3f)
+				return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	int tiles = argc > 1 ? atoi(argv[1]) : 12;
+	int samples = argc > 2 ? atoi(argv[2]) : 257;
+	size_t budget_mb = argc > 3 ? (size_t)atoi(argv[3]) : 64;
+
+	std::string root = (std::filesystem::temp_directory_path() / "tiles_bench").string() + "/";
+	std::filesystem::remove_all(root);
+
+	bool passed = true;
+
+	// the 16 bit survey, flown across and back
+	double t0 = now_ms();
+	if (!write_tile_set(root + "u16/", tiles, samples, false))
+	{
+		std::printf("can't write the tile set to %s\n", root.c_str());
+		return 1;
+	}
+	double write_ms = now_ms() - t0;
+
+	TerrainTilesCore terrain;
+	if (!terrain.open(root + "u16/terrain.tiles"))
+	{
+		std::printf("%s\n", terrain.error.c_str());
+		return 1;
+	}
+	terrain.memory_budget = budget_mb << 20;
+	terrain.view_distance = 3.0f * (samples - 1) * terrain.spacing;
+
+	float extent = tiles * (samples - 1) * terrain.spacing;
+	const int FRAMES = 600;
+	double update_total = 0.0, update_max = 0.0;
+	bool in_budget = true, heights_ok = true, edges_ok = true;
+	for (int frame = 0; frame < FRAMES; frame++)
+	{
+		// corner to corner and back, a little off the diagonal on the way back
+		float t = frame < FRAMES / 2 ? float(frame) / (FRAMES / 2) : 1.0f - float(frame - FRAMES / 2) / (FRAMES / 2);
+		glm::vec3 camera(t * extent, 0.0f, t * extent * (frame < FRAMES / 2 ? 1.0f : 0.8f));
+
+		double t1 = now_ms();
+		terrain.update(camera);
+		double t2 = now_ms();
+		update_total += t2 - t1;
+		update_max = std::max(update_max, t2 - t1);
+
+		in_budget = in_budget && terrain.resident_bytes <= terrain.memory_budget;
+		if (frame % 50 == 0)
+		{
+			heights_ok = heights_ok && check_heights(terrain, false);
+			edges_ok = edges_ok && check_edges(terrain);
+		}
+
+		// the rest of the frame, the loader thread gets the core meanwhile
+		std::this_thread::sleep_for(std::chrono::milliseconds(4));
+	}
+	terrain.wait();
+
+	double whole_mb = terrain.tiles.size() * terrain.tile_bytes() / (1024.0 * 1024.0);
+	size_t loads = terrain.misses - terrain.failures;
+
+	std::printf("%-10s %7s %9s %10s %9s %8s %8s %8s %9s %10s %9s %12s %12s %12s\n",
+		"tile set", "tiles", "tile MB", "whole MB", "budget MB", "frames", "hits", "misses", "hit rate", "evictions",
+		"peak MB", "build ms/tile", "update ms", "max update");
+	std::printf("%-10s %7zu %9.2f %10.1f %9zu %8d %8zu %8zu %9.3f %10zu %9.1f %12.2f %12.3f %12.3f\n",
+		"u16", terrain.tiles.size(), terrain.tile_bytes() / (1024.0 * 1024.0), whole_mb, budget_mb, FRAMES,
+		terrain.hits, terrain.misses, terrain.hits / double(terrain.hits + terrain.misses), terrain.evictions,
+		terrain.peak_resident_bytes / (1024.0 * 1024.0), loads > 0 ? terrain.build_ms / loads : 0.0,
+		update_total / FRAMES, update_max);
+	std::printf("(writing the tile set took %.0f ms)\n\n", write_ms);
+
+	std::printf("%-34s %s\n", "resident bytes within the budget", in_budget && terrain.peak_resident_bytes <= terrain.memory_budget ? "ok" : "OVER");
+	std::printf("%-34s %s\n", "heights as written", heights_ok ? "ok" : "WRONG");
+	std::printf("%-34s %s\n", "neighbouring tiles meet", edges_ok ? "ok" : "WRONG");
+	passed = passed && in_budget && heights_ok && edges_ok && terrain.failures == 0;
+
+	// a small float survey, everything resident
+	{
+		bool ok = write_tile_set(root + "f32/", 3, 65, true);
+		TerrainTilesCore floats;
+		ok = ok && floats.open(root + "f32/terrain.tiles");
+		floats.view_distance = 1000.0f;
+		floats.uploads_per_frame = 100;
+		for (int i = 0; i < 3 && ok; i++)
+		{
+			floats.update(glm::vec3(0.0f));
+			floats.wait();
+		}
+		floats.update(glm::vec3(0.0f));
+		for (size_t id = 0; id < floats.tiles.size() && ok; id++)
+			ok = floats.tiles[id].state == TerrainTilesCore::TILE_RESIDENT;
+		ok = ok && check_heights(floats, true) && check_edges(floats);
+		std::printf("%-34s %s\n", "f32 tiles exact", ok ? "ok" : "WRONG");
+		passed = passed && ok;
+	}
+
+	// a tile cut short is reported once and left out, the others still load
+	{
+		write_tile_set(root + "broken/", 2, 33, false);
+		std::filesystem::resize_file(root + "broken/1_0.raw", 100);
+
+		TerrainTilesCore broken;
+		bool ok = broken.open(root + "broken/terrain.tiles");
+		broken.view_distance = 1000.0f;
+		for (int i = 0; i < 4 && ok; i++)
+		{
+			broken.update(glm::vec3(0.0f));
+			broken.wait();
+		}
+		ok = ok && broken.failures == 1 && broken.tiles[2].state == TerrainTilesCore::TILE_FAILED
+			&& broken.tiles[0].state == TerrainTilesCore::TILE_RESIDENT && broken.tiles[3].state == TerrainTilesCore::TILE_RESIDENT;
+		std::printf("%-34s %s\n", "truncated tile left out", ok ? "ok" : "WRONG");
+		passed = passed && ok;
+
+		FILE* file = fopen((root + "broken/bad.tiles").c_str(), "w");
+		fprintf(file, "tiles 2 2\nsamples 33 thirty-three\n");
+		fclose(file);
+		bool rejected = !broken.open(root + "broken/bad.tiles") && broken.error.find(":2:") != std::string::npos;
+		std::printf("%-34s %s (%s)\n", "bad tile set file rejected", rejected ? "ok" : "WRONG", broken.error.c_str());
+		passed = passed && rejected;
+	}
+
+	std::filesystem::remove_all(root);
+
+	if (!passed)
+		std::printf("\nFAILED\n");
+	return passed ? 0 : 1;
+}
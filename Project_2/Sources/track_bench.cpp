@@ -0,0 +1,765 @@
+/*** @file track_bench.cpp
+*
+*   @brief Headless benchmark for the GL-free track code (TrackCore and rc_Spline)
+*
+*   Times every stage of the track generation on the shipped .sp files and on
+*   large generated tracks: spline loading, Catmull-Rom evaluation, the arc length
+*   table, frame propagation and the rail/plank mesh.
+*
+*   The rail and plank generation is then timed on 1 .. N threads for the largest
+*   generated track, and checked to give the same bytes on every thread count.
+*
+*   The shipped tracks are also compiled (written next to them as .spc, like track_compile)
+*   and loaded back, timed against generating them from the .sp files. The rails have to come
+*   straight from the mapping, and files whose sections don't fit together have to be ignored.
+*
+*   Also checks that get_point and the batch get_points agree with the original
+*   matrix form of the spline (get_point_reference), and that evaluate() matches the
+*   derivatives of the textbook Catmull-Rom form in double, and that the frame table
+*   closes the loop.
+*
+*   The supports table places a pillar every support_spacing along each track on a generated
+*   1024x1024 heightmap and times it, the ground batch on its own too. Every pillar has to stand
+*   on the ground exactly where a single ground query puts it, none may be shorter than allowed,
+*   every thread count has to give the same bytes, and on flat ground with the plank spacing every
+*   upright plank gets a pillar right below it.
+*
+*   The check table runs check_track() on every track against the same ground, and on the
+*   largest again with the samples packed to 100k. The samples every issue covers have to be
+*   the ones an all pairs search flags, every thread count has to find the same issues, a flat
+*   figure eight has to cross itself once and not at all once one lobe is lifted over the other,
+*   and ground at a known height has to be too close exactly where the track dips below it.
+*   The exit code is 1 if any check fails.
+*
+*   usage: track_bench [media folder] [generated control point counts ...]
+*   e.g.   track_bench ../Project_2/Media/ 1000 4000
+**/
+
+#include <track_core.hpp>
+#include <heightmap_core.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+
+// float rounding differs between the matrix product and Horner's scheme, nothing more
+static const float POINT_TOLERANCE = 1.0e-5f;
+// the derivatives lose a few more bits, they are differences of the coefficients
+static const float DERIVATIVE_TOLERANCE = 1.0e-4f;
+// the closing twist is spread over the loop, the last frame only misses the first by rounding
+static const float SEAM_TOLERANCE = 1.0e-3f;
+
+// peak resident memory of the process so far, in MB
+static double peak_memory_mb()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+	return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+#endif
+}
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// fill the spline with n offsets that go once around a wobbly circle, spaced a few units
+// apart like the hand made tracks, so the loop closes on itself
+static void generate_track(rc_Spline& spline, int n, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+
+	float radius = n * 1.5f / 3.14159265f;
+	float height = 0.0f;
+
+	glm::vec3 prev(0.0f, 0.0f, 0.0f);
+	for (int i = 0; i < n; i++)
+	{
+		float angle = 2.0f * 3.14159265f * i / n;
+		height += jitter(rng);
+		height *= 0.98f;
+
+		glm::vec3 pt(radius * cos(angle) + jitter(rng), 4.0f * height, radius * sin(angle) + jitter(rng));
+		spline.addPoint(pt - prev);
+		prev = pt;
+	}
+}
+
+// largest distance between the fast paths and get_point_reference, relative to the size of the point
+static float check_spline(TrackCore& track, const std::vector<float>& s, const std::vector<float>& x,
+	const std::vector<float>& y, const std::vector<float>& z)
+{
+	float worst = 0.0f;
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		glm::vec3 reference = track.get_point_reference(s[i]);
+		float scale = std::max(1.0f, glm::length(reference));
+
+		worst = std::max(worst, glm::length(track.get_point(s[i]) - reference) / scale);
+		worst = std::max(worst, glm::length(glm::vec3(x[i], y[i], z[i]) - reference) / scale);
+	}
+	return worst;
+}
+
+// largest error of evaluate() and get_second_derivative() against the textbook form of the
+// tau = 0.5 Catmull-Rom segment, written out separately here and evaluated in double
+static float check_derivatives(TrackCore& track)
+{
+	float worst = 0.0f;
+	for (int i = 0; i < track.max_s * 16; i++)
+	{
+		float s = i / 16.0f + 0.03f;
+		int seg = (int)floor(s);
+		double u = s - seg;
+
+		glm::dvec3 p0(track.controlPoints[(seg + track.max_s - 1) % track.max_s]);
+		glm::dvec3 p1(track.controlPoints[seg % track.max_s]);
+		glm::dvec3 p2(track.controlPoints[(seg + 1) % track.max_s]);
+		glm::dvec3 p3(track.controlPoints[(seg + 2) % track.max_s]);
+
+		// P(u) = 0.5 * (2 p1 + (p2 - p0) u + (2 p0 - 5 p1 + 4 p2 - p3) u^2 + (3 p1 - p0 - 3 p2 + p3) u^3)
+		glm::dvec3 a = 0.5 * (p2 - p0);
+		glm::dvec3 b = 0.5 * (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3);
+		glm::dvec3 c = 0.5 * (3.0 * p1 - p0 - 3.0 * p2 + p3);
+		glm::dvec3 position = p1 + (a + (b + c * u) * u) * u;
+		glm::dvec3 d = a + (2.0 * b + 3.0 * c * u) * u;
+		glm::dvec3 dd = 2.0 * b + 6.0 * c * u;
+		double curvature = glm::length(glm::cross(d, dd)) / pow(glm::length(d), 3.0);
+
+		// the float coefficients are rounded relative to the size of the coordinates, and the
+		// derivatives come from differences between them, so that's the scale every error is measured in
+		SplinePoint point = track.evaluate(s);
+		double scale = std::max(1.0, glm::length(position));
+		worst = std::max(worst, (float)(glm::length(glm::dvec3(point.position) - position) / scale));
+		worst = std::max(worst, (float)(glm::length(glm::dvec3(point.tangent) - glm::normalize(d)) / scale));
+		worst = std::max(worst, (float)(glm::length(glm::dvec3(track.get_second_derivative(s)) - dd) / scale));
+		worst = std::max(worst, (float)(std::fabs(point.curvature - curvature) / scale));
+
+		// the normal is perpendicular to the tangent and on the inside of the turn
+		if (glm::length(point.normal) > 0.0f)
+		{
+			worst = std::max(worst, std::fabs(glm::dot(point.normal, point.tangent)));
+			if (glm::dot(glm::dvec3(point.normal), dd) < 0.0) worst = 1.0f;
+		}
+	}
+	return worst;
+}
+
+// the supports of one track
+struct SupportStats
+{
+	std::string name;
+	size_t candidates, supports;
+	double build_ms, ground_ms;
+	bool ok;
+};
+
+// rolling hills like heightmap_bench's, for the supports to stand on
+static void generate_ground(HeightmapCore& map, int size)
+{
+	std::vector<unsigned char> pixels((size_t)size * size);
+	for (int row = 0; row < size; row++)
+	{
+		for (int column = 0; column < size; column++)
+		{
+			float x = float(row) / float(size), z = float(column) / float(size);
+			float h = 0.5f + 0.25f * sin(6.0f * x + 1.0f) * cos(5.0f * z) + 0.15f * sin(17.0f * (x + z));
+			pixels[(size_t)row * size + column] = (unsigned char)std::min(255.0f, std::max(0.0f, h * 255.0f + 0.5f));
+		}
+	}
+	map.create_heightmap(&pixels[0], size, size, 1);
+}
+
+// place the supports of a generated track on map and check them
+static SupportStats bench_supports(const char* name, TrackCore& track, const HeightmapCore& map)
+{
+	SupportStats stats;
+	stats.name = name;
+	stats.ground_ms = 0.0;
+
+	TrackCore::GroundQuery ground = [&map, &stats](const glm::vec2* points, size_t count, float* heights)
+	{
+		double t0 = now_ms();
+		map.ground_heights(points, count, heights);
+		stats.ground_ms += now_ms() - t0;
+	};
+
+	double t0 = now_ms();
+	track.build_supports(ground);
+	stats.build_ms = now_ms() - t0;
+	stats.supports = track.support_instances.size();
+	stats.candidates = 0;
+	for (float distance = track.support_spacing; distance < track.track_length(); distance += track.support_spacing)
+		stats.candidates++;
+
+	// standing on the ground, tall enough
+	stats.ok = stats.supports > 0;
+	for (size_t i = 0; i < track.support_instances.size(); i++)
+	{
+		const glm::vec4& support = track.support_instances[i];
+		float ground_y = map.ground_height(glm::vec2(support.x, support.z));
+		stats.ok = stats.ok && support.y + TrackCore::SUPPORT_SINK == ground_y
+			&& support.w - TrackCore::SUPPORT_SINK >= track.support_min_height;
+	}
+
+	// the same bytes on one thread
+	std::vector<glm::vec4> pool = track.support_instances;
+	track.threads = 1;
+	track.build_supports(ground);
+	track.threads = 0;
+	stats.ok = stats.ok && pool.size() == track.support_instances.size()
+		&& memcmp(&pool[0], &track.support_instances[0], pool.size() * sizeof(glm::vec4)) == 0;
+
+	// flat ground far below with the planks' spacing: a pillar right under every upright plank
+	float spacing = track.support_spacing;
+	track.support_spacing = track.plank_spacing;
+	track.build_supports([](const glm::vec2*, size_t count, float* heights)
+	{
+		for (size_t i = 0; i < count; i++)
+			heights[i] = -1000.0f;
+	});
+	size_t next = 0;
+	for (size_t i = 0; i < track.plank_transforms.size() && stats.ok; i++)
+	{
+		const glm::mat4& plank = track.plank_transforms[i];
+		if (plank[1].y < track.support_min_up) continue;
+
+		glm::vec3 top = glm::vec3(plank[3]) - glm::vec3(plank[1]) * TrackCore::SUPPORT_TOP_OFFSET;
+		stats.ok = next < track.support_instances.size() && track.support_instances[next].x == top.x
+			&& track.support_instances[next].z == top.z && track.support_instances[next].y == -1000.0f - TrackCore::SUPPORT_SINK;
+		next++;
+	}
+	stats.ok = stats.ok && next == track.support_instances.size();
+	track.support_spacing = spacing;
+	track.build_supports(ground);
+	return stats;
+}
+
+static bool print_supports(const std::vector<SupportStats>& results)
+{
+	std::printf("\n%-26s %10s %9s %9s %9s %11s %9s\n", "supports", "positions", "pillars", "build ms", "ground ms", "ns/support", "checks");
+
+	bool passed = true;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const SupportStats& stats = results[i];
+		std::printf("%-26s %10zu %9zu %9.2f %9.2f %11.0f %9s\n", stats.name.c_str(), stats.candidates, stats.supports,
+			stats.build_ms, stats.ground_ms, stats.candidates > 0 ? stats.build_ms * 1.0e6 / stats.candidates : 0.0,
+			stats.ok ? "ok" : "WRONG");
+		passed = passed && stats.ok;
+	}
+	return passed;
+}
+
+// the check_track() results of one track
+struct CheckStats
+{
+	std::string name;
+	size_t samples, crossings, clearance;
+	double check_ms;
+	bool ok;
+};
+
+// the samples check_track() takes, the same way it takes them
+static void check_samples(TrackCore& track, std::vector<float>& s, std::vector<glm::vec3>& positions)
+{
+	size_t count = (size_t)std::ceil(track.track_length() / track.check_spacing);
+	s.resize(count);
+	positions.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		s[i] = track.s_at_distance(i * track.check_spacing);
+		positions[i] = track.get_point(s[i]);
+	}
+}
+
+// s in [begin, end], which goes over s = 0 if end is below begin
+static bool inside(float s, float begin, float end)
+{
+	return begin <= end ? s >= begin && s <= end : s >= begin || s <= end;
+}
+
+// true if s is inside one of the issues of kind, on either side of a crossing
+static bool covered(const std::vector<TrackIssue>& issues, TrackIssue::Kind kind, float s)
+{
+	for (size_t i = 0; i < issues.size(); i++)
+	{
+		if (issues[i].kind != kind) continue;
+		if (inside(s, issues[i].s_begin, issues[i].s_end)
+			|| (kind == TrackIssue::SELF_INTERSECTION && inside(s, issues[i].other_begin, issues[i].other_end)))
+			return true;
+	}
+	return false;
+}
+
+// every pair of samples: the ones that run into another part of the track are covered by the
+// crossings, the ones that aren't run into nothing, and every crossing starts and ends on one
+static bool check_all_pairs(TrackCore& track)
+{
+	std::vector<float> s;
+	std::vector<glm::vec3> positions;
+	check_samples(track, s, positions);
+
+	float total = track.track_length();
+	float reach = 2.0f * track.check_envelope, neighbours = 4.0f * track.check_envelope;
+	std::vector<char> flagged(s.size(), 0);
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		for (size_t j = i + 1; j < s.size(); j++)
+		{
+			float along = (j - i) * track.check_spacing;
+			if (std::min(along, total - along) <= neighbours) continue;
+			if (glm::length(positions[j] - positions[i]) < reach)
+				flagged[i] = flagged[j] = 1;
+		}
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < s.size() && ok; i++)
+		ok = (flagged[i] != 0) == covered(track.issues, TrackIssue::SELF_INTERSECTION, s[i]);
+	return ok;
+}
+
+// check a track against map, the exact issues are compared on one thread and against all pairs
+static CheckStats bench_check(const char* name, TrackCore& track, const HeightmapCore& map, bool all_pairs)
+{
+	TrackCore::GroundQuery ground = [&map](const glm::vec2* points, size_t count, float* heights)
+	{
+		map.ground_heights(points, count, heights);
+	};
+
+	CheckStats stats;
+	stats.name = name;
+	stats.samples = (size_t)std::ceil(track.track_length() / track.check_spacing);
+
+	double t0 = now_ms();
+	track.check_track(ground);
+	stats.check_ms = now_ms() - t0;
+	stats.crossings = stats.clearance = 0;
+	for (size_t i = 0; i < track.issues.size(); i++)
+		(track.issues[i].kind == TrackIssue::SELF_INTERSECTION ? stats.crossings : stats.clearance)++;
+
+	// the same issues on one thread
+	std::vector<TrackIssue> pool = track.issues;
+	track.threads = 1;
+	track.check_track(ground);
+	track.threads = 0;
+	stats.ok = pool.size() == track.issues.size()
+		&& (pool.empty() || memcmp(&pool[0], &track.issues[0], pool.size() * sizeof(TrackIssue)) == 0);
+
+	if (all_pairs)
+		stats.ok = stats.ok && check_all_pairs(track);
+	return stats;
+}
+
+// a flat figure eight through the origin, lift > 0 takes one lobe over the other
+static bool check_figure_eight(float lift, size_t expected)
+{
+	TrackCore track;
+	glm::vec3 prev(0.0f);
+	for (int i = 0; i < 48; i++)
+	{
+		float t = 2.0f * 3.14159265f * (i + 6) / 48;
+		glm::vec3 pt(20.0f * sin(2.0f * t), lift * cos(t), 20.0f * sin(t));
+		track.g_Track.addPoint(pt - prev);
+		prev = pt;
+	}
+	track.create_track();
+	track.check_track();
+
+	bool ok = track.issues.size() == expected && check_all_pairs(track);
+	// it crosses at t = pi and t = 0, 18 and 42 control points in
+	for (size_t i = 0; i < track.issues.size() && ok; i++)
+		ok = track.issues[i].kind == TrackIssue::SELF_INTERSECTION && track.issues[i].distance < 2.0f * track.check_envelope
+			&& std::fabs(0.5f * (track.issues[i].s_begin + track.issues[i].s_end) - 18.0f) < 1.0f
+			&& std::fabs(0.5f * (track.issues[i].other_begin + track.issues[i].other_end) - 42.0f) < 1.0f;
+	return ok;
+}
+
+// ground at height across the whole track: too close exactly where the track is
+static bool check_flat_clearance(TrackCore& track, float height)
+{
+	track.check_track([height](const glm::vec2*, size_t count, float* heights)
+	{
+		for (size_t i = 0; i < count; i++)
+			heights[i] = height;
+	});
+
+	std::vector<float> s;
+	std::vector<glm::vec3> positions;
+	check_samples(track, s, positions);
+
+	bool ok = true;
+	for (size_t i = 0; i < s.size() && ok; i++)
+	{
+		bool low = positions[i].y - track.check_envelope - height < track.check_clearance;
+		ok = low == covered(track.issues, TrackIssue::TERRAIN_CLEARANCE, s[i]);
+	}
+	return ok;
+}
+
+static bool print_check(const std::vector<CheckStats>& results)
+{
+	std::printf("\n%-26s %10s %9s %9s %9s %11s %9s\n", "check", "samples", "crossings", "too low", "check ms", "ns/sample", "checks");
+
+	bool passed = true;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const CheckStats& stats = results[i];
+		std::printf("%-26s %10zu %9zu %9zu %9.2f %11.0f %9s\n", stats.name.c_str(), stats.samples, stats.crossings,
+			stats.clearance, stats.check_ms, stats.samples > 0 ? stats.check_ms * 1.0e6 / stats.samples : 0.0,
+			stats.ok ? "ok" : "WRONG");
+		passed = passed && stats.ok;
+	}
+	return passed;
+}
+
+// run every stage of create_track() on its own and print one row of results,
+// returns false if one of the spline checks failed
+static bool bench_track(const char* name, TrackCore& track, double load_ms)
+{
+	double t0 = now_ms();
+	track.build_control_points();
+	track.build_segment_coefficients();
+	double t1 = now_ms();
+	track.build_arc_length_table();
+	double t2 = now_ms();
+	track.build_frames();
+	double t3 = now_ms();
+	track.build_mesh();
+	double t4 = now_ms();
+	track.build_planks();
+	double t4b = now_ms();
+
+	// raw spline evaluation, 1024 samples per segment
+	int samples = track.max_s * 1024;
+	glm::vec3 sum(0.0f, 0.0f, 0.0f);
+	double t5 = now_ms();
+	for (int i = 0; i < samples; i++)
+		sum += track.get_point((float)i / 1024.0f);
+	double t6 = now_ms();
+
+	// the same samples through the batch evaluator
+	std::vector<float> s(samples), x(samples), y(samples), z(samples);
+	for (int i = 0; i < samples; i++)
+		s[i] = (float)i / 1024.0f;
+	double t7 = now_ms();
+	track.get_points(&s[0], samples, &x[0], &y[0], &z[0]);
+	double t8 = now_ms();
+
+	// keep the compiler from dropping the loop
+	if (sum.x == 12345.678f) std::printf(" ");
+
+	// every 7th sample is plenty for the check
+	std::vector<float> cs, cx, cy, cz;
+	for (int i = 0; i < samples; i += 7)
+	{
+		cs.push_back(s[i]); cx.push_back(x[i]); cy.push_back(y[i]); cz.push_back(z[i]);
+	}
+	// values outside [0, max_s) twice over, so they go through both the vector path and the scalar tail
+	float outside[5] = { -0.25f, -1.5f, (float)track.max_s, track.max_s + 0.75f, 3.0f * track.max_s + 0.5f };
+	std::vector<float> batch(outside, outside + 5);
+	batch.insert(batch.end(), outside, outside + 5);
+	std::vector<float> bx(batch.size()), by(batch.size()), bz(batch.size());
+	track.get_points(&batch[0], (int)batch.size(), &bx[0], &by[0], &bz[0]);
+	cs.insert(cs.end(), batch.begin(), batch.end());
+	cx.insert(cx.end(), bx.begin(), bx.end());
+	cy.insert(cy.end(), by.begin(), by.end());
+	cz.insert(cz.end(), bz.begin(), bz.end());
+
+	float error = check_spline(track, cs, cx, cy, cz);
+	float derivative_error = check_derivatives(track);
+
+	// what the ride does every frame, 1000 lookups per lap
+	float lap = track.track_length();
+	glm::vec3 up_sum(0.0f, 0.0f, 0.0f);
+	double t9 = now_ms();
+	for (int i = 0; i < 1000; i++)
+		up_sum += track.frame_at_distance(lap * i / 1000.0f).Up;
+	double t10 = now_ms();
+	if (up_sum.x == 12345.678f) std::printf(" ");
+
+	// the frame table has to close the loop: the last frame is the first one again
+	const Orientation& first = track.frames.front();
+	const Orientation& last = track.frames.back();
+	float seam = std::max(glm::length(last.Up - first.Up), glm::length(last.Right - first.Right));
+
+	double mesh_mb = track.mesh_bytes() / (1024.0 * 1024.0);
+	double vertices_per_s = (t4 - t3) > 0.0 ? track.vertices.size() / ((t4 - t3) / 1000.0) : 0.0;
+
+	std::printf("%-26s %8d %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.1f %9.2f %9.1f %10zu %10zu %12.0f %9.2f %9.1f %9.1e %9.1e %9.1f %9.1e\n",
+		name, track.max_s, load_ms, t1 - t0, t2 - t1, t3 - t2, t4 - t3, t4b - t4,
+		(t6 - t5) * 1.0e6 / samples,
+		(t8 - t7) * 1.0e6 / samples,
+		(t3 - t2) * 1.0e6 / track.frames.size(),
+		track.vertices.size(), track.indices.size(), vertices_per_s, mesh_mb, peak_memory_mb(), error, derivative_error,
+		(t10 - t9) * 1.0e6 / 1000, seam);
+
+	return error <= POINT_TOLERANCE && derivative_error <= DERIVATIVE_TOLERANCE && seam <= SEAM_TOLERANCE;
+}
+
+// generate the track from the .sp file and from its compiled file, which is written first,
+// returns false if the two don't give the same data
+static bool bench_compiled(const char* name, const std::string& folder)
+{
+	double t0 = now_ms();
+	TrackCore generated;
+	if (!generated.load_track(name, folder)) return false;
+	generated.create_track();
+	double t1 = now_ms();
+
+	std::string compiled = TrackCore::compiled_path(name);
+	if (!generated.save_compiled(compiled, folder)) return false;
+	double t2 = now_ms();
+
+	TrackCore loaded;
+	bool ok = loaded.load_compiled(compiled, folder);
+	double t3 = now_ms();
+
+	// the rails are read from the mapping, not copied
+	ok = ok && loaded.vertices.empty() && loaded.indices.empty()
+		&& loaded.rail_vertex_count() == generated.vertices.size() && loaded.rail_index_count() == generated.indices.size()
+		&& loaded.frames.size() == generated.frames.size() && loaded.plank_transforms.size() == generated.plank_transforms.size()
+		&& memcmp(loaded.rail_vertex_data(), &generated.vertices[0], generated.vertices.size() * sizeof(Vertex)) == 0
+		&& memcmp(loaded.rail_index_data(), &generated.indices[0], generated.indices.size() * sizeof(unsigned int)) == 0
+		&& memcmp(&loaded.frames[0], &generated.frames[0], generated.frames.size() * sizeof(Orientation)) == 0
+		&& loaded.get_point(1.25f) == generated.get_point(1.25f)
+		&& loaded.mesh_bytes() == generated.mesh_bytes();
+	loaded.release_compiled();
+	ok = ok && loaded.rail_vertex_data() == NULL && loaded.rail_index_count() == generated.indices.size();
+
+	std::printf("%-26s %9.2f %9.2f %9.2f %9s\n", compiled.c_str(), t1 - t0, t2 - t1, t3 - t2, ok ? "yes" : "NO");
+	return ok;
+}
+
+// compiled files whose sections don't fit together have to be ignored, so the spline is loaded instead
+static bool check_damaged_compiled(const char* name, const std::string& folder)
+{
+	std::string damaged = TrackCore::compiled_path(name) + ".damaged";
+	bool passed = true;
+	for (int damage = 0; damage < 4; damage++)
+	{
+		TrackCore track;
+		if (!track.load_track(name, folder)) return false;
+		track.create_track();
+		if (damage == 0) track.arc_length.clear();
+		if (damage == 1) track.controlPoints.pop_back();
+		if (damage == 2) track.indices[track.indices.size() / 2] = (unsigned int)track.vertices.size();
+		if (damage == 3) track.plank_indices[0] = (unsigned int)track.plank_vertices.size();
+		track.save_compiled(damaged, folder);
+
+		TrackCore loaded;
+		passed = !loaded.load_compiled(damaged, folder) && loaded.arc_length.empty() && passed;
+	}
+	std::remove((folder + damaged).c_str());
+	return passed;
+}
+
+// parallel_for() with one piece throwing, once on the calling thread and once on a worker: the exception
+// has to come out, and only after the other pieces (which sleep so they are still running) have all finished.
+static bool check_throwing_pieces()
+{
+	ThreadPool pool(3);
+	// piece 3 is the caller's own, piece 0 goes to a worker
+	const size_t throwers[] = { 3, 0 };
+	bool passed = true;
+	for (size_t thrower : throwers)
+	{
+		std::atomic<int> finished{ 0 };
+		bool caught = false;
+		try
+		{
+			pool.parallel_for(0, 4, [&finished, thrower](size_t first, size_t)
+			{
+				if (first == thrower) throw std::runtime_error("piece failed");
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				finished++;
+			});
+		}
+		catch (const std::runtime_error&)
+		{
+			caught = true;
+		}
+		passed = passed && caught && finished == 3;
+	}
+	return passed;
+}
+
+// build_mesh() and build_planks() on 1 .. max_threads threads, the output has to be the same
+// bytes as with one thread. Returns false if it isn't.
+static bool bench_scaling(TrackCore& track, unsigned int max_threads)
+{
+	std::printf("\n%-8s %9s %9s %9s %9s\n", "threads", "mesh ms", "plank ms", "speedup", "identical");
+
+	std::vector<Vertex> one_vertices;
+	std::vector<unsigned int> one_indices;
+	std::vector<glm::mat4> one_transforms;
+	double one_ms = 0.0;
+	bool identical = true;
+
+	for (unsigned int threads = 1; threads <= max_threads; threads++)
+	{
+		track.threads = threads;
+
+		double t0 = now_ms();
+		track.build_mesh();
+		double t1 = now_ms();
+		track.build_planks();
+		double t2 = now_ms();
+
+		bool same = true;
+		if (threads == 1)
+		{
+			one_vertices = track.vertices;
+			one_indices = track.indices;
+			one_transforms = track.plank_transforms;
+			one_ms = t2 - t0;
+		}
+		else
+		{
+			same = track.vertices.size() == one_vertices.size() && track.indices.size() == one_indices.size()
+				&& track.plank_transforms.size() == one_transforms.size()
+				&& memcmp(&track.vertices[0], &one_vertices[0], one_vertices.size() * sizeof(Vertex)) == 0
+				&& memcmp(&track.indices[0], &one_indices[0], one_indices.size() * sizeof(unsigned int)) == 0
+				&& memcmp(&track.plank_transforms[0], &one_transforms[0], one_transforms.size() * sizeof(glm::mat4)) == 0;
+			identical = identical && same;
+		}
+
+		std::printf("%-8u %9.2f %9.2f %9.2f %9s\n", threads, t1 - t0, t2 - t1, one_ms / (t2 - t0), same ? "yes" : "NO");
+	}
+
+	track.threads = 0;
+	return identical;
+}
+
+int main(int argc, char** argv)
+{
+	std::string folder = argc > 1 ? argv[1] : "../Project_2/Media/";
+
+	std::vector<int> generated;
+	for (int i = 2; i < argc; i++)
+		generated.push_back(atoi(argv[i]));
+	if (generated.empty())
+	{
+		generated.push_back(1000);
+		generated.push_back(4000);
+	}
+
+	std::printf("%-26s %8s %9s %9s %9s %9s %9s %9s %9s %9s %9s %10s %10s %12s %9s %9s %9s %9s %9s %9s\n",
+		"track", "ctrl pts", "load ms", "ctrl ms", "arc ms", "frame ms", "mesh ms", "plank ms",
+		"ns/sample", "ns/batch", "ns/frame", "vertices", "indices", "vertices/s", "mesh MB", "peak MB", "max err", "d err", "ns/ride", "seam");
+
+	bool passed = true;
+
+	// the ground for the supports, the heightmap's size and place in the world are the viewer's
+	HeightmapCore ground;
+	generate_ground(ground, 1024);
+	std::vector<SupportStats> supports;
+	std::vector<CheckStats> checks;
+
+	const char* shipped[] = { "spline/custom_track.sp", "spline/track.sp" };
+	for (int i = 0; i < 2; i++)
+	{
+		TrackCore track;
+
+		double t0 = now_ms();
+		if (!track.load_track(shipped[i], folder)) return 1;
+		double t1 = now_ms();
+
+		passed = bench_track(shipped[i], track, t1 - t0) && passed;
+		supports.push_back(bench_supports(shipped[i], track, ground));
+		checks.push_back(bench_check(shipped[i], track, ground, true));
+	}
+
+	for (size_t i = 0; i < generated.size(); i++)
+	{
+		TrackCore track;
+		generate_track(track.g_Track, generated[i], 458u + (unsigned int)i);
+
+		std::string name = "generated " + std::to_string(generated[i]);
+		passed = bench_track(name.c_str(), track, 0.0) && passed;
+		supports.push_back(bench_supports(name.c_str(), track, ground));
+		checks.push_back(bench_check(name.c_str(), track, ground, i == 0));
+	}
+	passed = print_supports(supports) && passed;
+
+	{
+		TrackCore largest;
+		generate_track(largest.g_Track, *std::max_element(generated.begin(), generated.end()), 458u);
+		largest.create_track();
+		largest.check_spacing = largest.track_length() / 100000.0f;
+		checks.push_back(bench_check("largest, 100k samples", largest, ground, false));
+
+		largest.check_spacing = 0.25f;
+		bool flat = check_flat_clearance(largest, 0.0f) && check_flat_clearance(largest, -3.0f);
+		bool crossing = check_figure_eight(0.0f, 1);
+		bool overpass = check_figure_eight(3.0f, 0);
+		passed = print_check(checks) && passed;
+		std::printf("%-40s %s\n", "figure eight crosses itself once", crossing ? "ok" : "WRONG");
+		std::printf("%-40s %s\n", "lifted figure eight doesn't", overpass ? "ok" : "WRONG");
+		std::printf("%-40s %s\n", "too low exactly over flat ground", flat ? "ok" : "WRONG");
+		passed = passed && crossing && overpass && flat;
+	}
+
+	// the compiled files are written next to the shipped tracks, like track_compile does
+	std::printf("\n%-26s %9s %9s %9s %9s\n", "compiled track", "sp ms", "save ms", "map ms", "identical");
+	for (int i = 0; i < 2; i++)
+		passed = bench_compiled(shipped[i], folder) && passed;
+	bool damaged = check_damaged_compiled(shipped[0], folder);
+	std::printf("%-40s %s\n", "damaged compiled tracks ignored", damaged ? "ok" : "WRONG");
+	passed = passed && damaged;
+
+	// mesh generation scaling on the largest track, at least 4 threads so the
+	// parallel path gets checked even on small machines
+	TrackCore largest;
+	generate_track(largest.g_Track, *std::max_element(generated.begin(), generated.end()), 458u);
+	largest.create_track();
+
+	bool throwing = check_throwing_pieces();
+	std::printf("%-40s %s\n", "throwing pieces waited for", throwing ? "ok" : "WRONG");
+	passed = passed && throwing;
+
+	unsigned int max_threads = std::max(4u, ThreadPool::shared().size() + 1);
+	if (!bench_scaling(largest, max_threads))
+	{
+		std::printf("parallel mesh FAILED: output differs from one thread\n");
+		return 1;
+	}
+
+	if (!passed)
+	{
+		std::printf("check FAILED: max err above %g, d err above %g, seam above %g, a compiled track differs, a support or a track check is wrong\n", POINT_TOLERANCE, DERIVATIVE_TOLERANCE, SEAM_TOLERANCE);
+		return 1;
+	}
+	std::printf("all checks passed\n");
+	return 0;
+}
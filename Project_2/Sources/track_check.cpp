@@ -0,0 +1,233 @@
+/*** @file track_check.cpp
+*
+*   @brief Track validation: self intersections and terrain clearance through a spatial hash
+**/
+
+#include <track_core.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+
+
+namespace
+{
+	// integer cell of a sample, the cells are one envelope diameter wide so two samples
+	// that overlap are always in the same or neighbouring cells
+	struct Cell {
+		int x, y, z;
+	};
+
+	Cell cell_of(const glm::vec3& p, float inverse_size)
+	{
+		return Cell{ (int)std::floor(p.x * inverse_size), (int)std::floor(p.y * inverse_size), (int)std::floor(p.z * inverse_size) };
+	}
+
+	// bucket of a cell, cells that land in the same bucket are told apart by the distance test
+	uint32_t bucket_of(int x, int y, int z, uint32_t mask)
+	{
+		return ((uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ (uint32_t)z * 83492791u) & mask;
+	}
+
+	// the other sample a flagged sample runs into, and how far apart they are
+	struct Hit {
+		uint32_t other;
+		float distance;
+	};
+	const uint32_t NO_HIT = 0xffffffffu;
+}
+
+size_t TrackCore::check_track(const GroundQuery& ground)
+{
+	issues.clear();
+
+	float total = track_length();
+	if (check_spacing <= 0.0f || total <= 0.0f) return 0;
+
+	size_t count = (size_t)std::ceil(total / check_spacing);
+	std::vector<float> sample_s(count);
+	std::vector<glm::vec3> positions(count);
+	ThreadPool::shared().parallel_for(0, count, [this, &sample_s, &positions](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			sample_s[i] = s_at_distance(i * check_spacing);
+			positions[i] = get_point(sample_s[i]);
+		}
+	}, threads);
+
+	// self intersections: two samples whose envelopes overlap but which are more than 4 envelopes apart along
+	// the track, going either way round it
+	float reach = 2.0f * check_envelope;
+	float neighbours = 4.0f * check_envelope;
+	float inverse_size = 1.0f / reach;
+
+	// counting sort of the samples by bucket, bucket b holds order[start[b] .. start[b + 1])
+	uint32_t buckets = 1;
+	while (buckets < 2 * count) buckets <<= 1;
+	uint32_t mask = buckets - 1;
+	std::vector<uint32_t> bucket(count), start(buckets + 1, 0), order(count);
+	ThreadPool::shared().parallel_for(0, count, [&positions, &bucket, inverse_size, mask](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			Cell c = cell_of(positions[i], inverse_size);
+			bucket[i] = bucket_of(c.x, c.y, c.z, mask);
+		}
+	}, threads);
+	for (size_t i = 0; i < count; i++)
+		start[bucket[i] + 1]++;
+	for (uint32_t b = 0; b < buckets; b++)
+		start[b + 1] += start[b];
+	{
+		std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+		for (size_t i = 0; i < count; i++)
+			order[fill[bucket[i]]++] = (uint32_t)i;
+	}
+
+	// closest sample every sample runs into, every sample only looks at the 27 cells around its own
+	std::vector<Hit> hits(count);
+	ThreadPool::shared().parallel_for(0, count, [&](size_t first, size_t last)
+	{
+		float reach2 = reach * reach;
+		for (size_t i = first; i < last; i++)
+		{
+			Hit hit = { NO_HIT, FLT_MAX };
+			glm::vec3 p = positions[i];
+			Cell c = cell_of(p, inverse_size);
+
+			// neighbouring cells can share a bucket, don't look at one twice
+			uint32_t seen[27];
+			int seen_count = 0;
+			for (int dx = -1; dx <= 1; dx++)
+			for (int dy = -1; dy <= 1; dy++)
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				uint32_t b = bucket_of(c.x + dx, c.y + dy, c.z + dz, mask);
+				if (std::find(seen, seen + seen_count, b) != seen + seen_count) continue;
+				seen[seen_count++] = b;
+
+				for (uint32_t k = start[b]; k < start[b + 1]; k++)
+				{
+					uint32_t j = order[k];
+					glm::vec3 d = positions[j] - p;
+					float distance2 = glm::dot(d, d);
+					if (distance2 >= reach2 || distance2 >= hit.distance) continue;
+
+					float along = std::fabs(float((int64_t)j - (int64_t)i)) * check_spacing;
+					if (std::min(along, total - along) <= neighbours) continue;
+					hit.other = j;
+					hit.distance = distance2;
+				}
+			}
+			if (hit.other != NO_HIT) hit.distance = std::sqrt(hit.distance);
+			hits[i] = hit;
+		}
+	}, threads);
+
+	// runs of flagged samples that run into one part of the track, going round the track from a sample that
+	// isn't flagged so no run is cut in two at s = 0
+	size_t from = 0;
+	while (from < count && hits[from].other != NO_HIT) from++;
+	if (from == count) from = 0;
+
+	struct Run {
+		size_t first, last;
+		// the samples it runs into relative to the one the first sample runs into, it can go over s = 0 too
+		int64_t reference, low, high;
+		float closest;
+	};
+	std::vector<Run> runs;
+	std::vector<uint32_t> run_of(count, NO_HIT);
+	int64_t samples = (int64_t)count;
+	int64_t gap = (int64_t)(2.0f * neighbours / check_spacing) + 2;
+	auto offset = [samples](int64_t index, int64_t reference)
+	{
+		return (index - reference + samples + samples / 2) % samples - samples / 2;
+	};
+	for (size_t k = 0; k < count; )
+	{
+		size_t first = (from + k) % count;
+		if (hits[first].other == NO_HIT) { k++; continue; }
+
+		Run run = { first, first, hits[first].other, 0, 0, hits[first].distance };
+		run_of[first] = (uint32_t)runs.size();
+		for (k++; k < count; k++)
+		{
+			size_t i = (from + k) % count;
+			if (hits[i].other == NO_HIT) break;
+
+			int64_t other = offset(hits[i].other, run.reference);
+			if (other < run.low - gap || other > run.high + gap) break;
+			run.low = std::min(run.low, other);
+			run.high = std::max(run.high, other);
+			run.closest = std::min(run.closest, hits[i].distance);
+			run.last = i;
+			run_of[i] = (uint32_t)runs.size();
+		}
+		runs.push_back(run);
+	}
+
+	// every crossing is found from both sides, only the side that starts first is reported, with the other
+	// side grown to the whole run there
+	for (size_t r = 0; r < runs.size(); r++)
+	{
+		const Run& run = runs[r];
+		if ((int64_t)run.first > run.reference) continue;
+
+		const Run& other = runs[run_of[run.reference]];
+		int64_t low = std::min(run.low, offset(other.first, run.reference));
+		int64_t high = std::max(run.high, offset(other.last, run.reference));
+
+		TrackIssue issue;
+		issue.kind = TrackIssue::SELF_INTERSECTION;
+		issue.s_begin = sample_s[run.first];
+		issue.s_end = sample_s[run.last];
+		issue.other_begin = sample_s[(run.reference + low + samples) % samples];
+		issue.other_end = sample_s[(run.reference + high + samples) % samples];
+		issue.distance = std::min(run.closest, other.closest);
+		issues.push_back(issue);
+	}
+
+	// terrain clearance: one batch of ground heights under every sample
+	if (ground)
+	{
+		std::vector<glm::vec2> points(count);
+		for (size_t i = 0; i < count; i++)
+			points[i] = glm::vec2(positions[i].x, positions[i].z);
+		std::vector<float> heights(count);
+		ground(&points[0], count, &heights[0]);
+
+		std::vector<float> above(count);
+		for (size_t i = 0; i < count; i++)
+			above[i] = positions[i].y - check_envelope - heights[i];
+
+		size_t from = 0;
+		while (from < count && above[from] < check_clearance) from++;
+		if (from == count) from = 0;
+
+		for (size_t k = 0; k < count; )
+		{
+			size_t first = (from + k) % count;
+			if (above[first] >= check_clearance) { k++; continue; }
+
+			TrackIssue issue;
+			issue.kind = TrackIssue::TERRAIN_CLEARANCE;
+			issue.other_begin = issue.other_end = 0.0f;
+			issue.distance = above[first];
+			size_t last = first;
+			for (k++; k < count && above[(from + k) % count] < check_clearance; k++)
+			{
+				last = (from + k) % count;
+				issue.distance = std::min(issue.distance, above[last]);
+			}
+			issue.s_begin = sample_s[first];
+			issue.s_end = sample_s[last];
+			issues.push_back(issue);
+		}
+	}
+
+	return issues.size();
+}
@@ -0,0 +1,67 @@
+/*** @file track_compile.cpp
+*
+*   @brief Offline step that turns .sp tracks into compiled track files
+*
+*   Runs the whole track generation once and writes the result next to the spline
+*   (custom_track.sp -> custom_track.spc). Project2 maps that file at startup instead
+*   of generating the track again, as long as the .sp files haven't changed since.
+*
+*   usage: track_compile [media folder] [track files ...]
+*   e.g.   track_compile ../Project_2/Media/ spline/custom_track.sp spline/track.sp
+**/
+
+#include <track_core.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+// wall clock in milliseconds
+static double now_ms()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char** argv)
+{
+	std::string folder = argc > 1 ? argv[1] : "../Project_2/Media/";
+
+	std::vector<std::string> tracks;
+	for (int i = 2; i < argc; i++)
+		tracks.push_back(argv[i]);
+	if (tracks.empty())
+	{
+		tracks.push_back("spline/custom_track.sp");
+		tracks.push_back("spline/track.sp");
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < tracks.size(); i++)
+	{
+		double t0 = now_ms();
+
+		TrackCore track;
+		if (!track.load_track(tracks[i].c_str(), folder))
+		{
+			failed++;
+			continue;
+		}
+		track.create_track();
+
+		std::string compiled = TrackCore::compiled_path(tracks[i]);
+		if (!track.save_compiled(compiled, folder))
+		{
+			failed++;
+			continue;
+		}
+
+		double t1 = now_ms();
+		std::printf("%s -> %s: %zu vertices, %zu indices, %zu planks, %.1f KB in %.2f ms\n",
+			tracks[i].c_str(), compiled.c_str(), track.vertices.size(), track.indices.size(),
+			track.plank_transforms.size(), track.mesh_bytes() / 1024.0, t1 - t0);
+	}
+
+	return failed == 0 ? 0 : 1;
+}
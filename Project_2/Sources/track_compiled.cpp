@@ -0,0 +1,310 @@
+/*** @file track_compiled.cpp
+*
+*   @brief Compiled track files: everything create_track() makes, stored so it can be mapped back in
+*
+*   Layout (native byte order, every section 16 byte aligned):
+*     CompiledHeader
+*     source list: per .sp file { uint64 hash, uint32 name length, name bytes }
+*     sections:    control points, arc length table, frames, frame distances,
+*                  rail vertices, rail indices, plank vertices, plank indices, plank transforms
+*
+*   The header records the version and the generation constants, a file written with
+*   different ones, or with section sizes that don't fit together, is ignored. The source list is the index file and every segment it
+*   named with a hash of their contents, if any of them changed the file is stale.
+**/
+
+#ifdef WIN32
+/* get rid of ridiculous warnings */
+#define _CRT_SECURE_NO_WARNINGS 1
+#endif
+
+#include <track_core.hpp>
+#include <mapped_file.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+
+// bump whenever the layout or the way the mesh is generated changes
+static const uint32_t COMPILED_VERSION = 2;
+static const char COMPILED_MAGIC[8] = { 'R', 'C', 'T', 'R', 'A', 'C', 'K', 0 };
+static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+enum CompiledSection
+{
+	SECTION_CONTROL_POINTS,
+	SECTION_ARC_LENGTH,
+	SECTION_FRAMES,
+	SECTION_FRAME_DISTANCE,
+	SECTION_VERTICES,
+	SECTION_INDICES,
+	SECTION_PLANK_VERTICES,
+	SECTION_PLANK_INDICES,
+	SECTION_PLANK_TRANSFORMS,
+	SECTION_COUNT
+};
+
+struct CompiledHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	// sizes of the stored structs and the constants the mesh was generated with
+	uint32_t vertex_size;
+	uint32_t orientation_size;
+	float step_size;
+	int32_t arc_samples;
+	int32_t ring_size;
+
+	int32_t max_s;
+	float hmax;
+	float plank_spacing;
+
+	uint32_t source_count;
+	uint32_t padding;
+
+	// byte offset and element count of every section
+	uint64_t offset[SECTION_COUNT];
+	uint64_t count[SECTION_COUNT];
+};
+
+// element size of every section, in CompiledSection order
+static const size_t SECTION_ELEMENT_SIZE[SECTION_COUNT] = {
+	sizeof(glm::vec3), sizeof(float), sizeof(Orientation), sizeof(float),
+	sizeof(Vertex), sizeof(unsigned int), sizeof(Vertex), sizeof(unsigned int), sizeof(glm::mat4)
+};
+
+
+// custom_track.sp -> custom_track.spc
+std::string TrackCore::compiled_path(const std::string& trackPath)
+{
+	std::string path = trackPath;
+	if (path.size() >= 3 && path.compare(path.size() - 3, 3, ".sp") == 0)
+		path.erase(path.size() - 3);
+	return path + ".spc";
+}
+
+// write one section at the next 16 byte boundary and record where it went
+template <typename T>
+static void write_section(FILE* file, CompiledHeader& header, CompiledSection section, const std::vector<T>& data)
+{
+	static const char zeros[16] = { 0 };
+	long position = ftell(file);
+	fwrite(zeros, 1, (16 - position % 16) % 16, file);
+
+	header.offset[section] = (uint64_t)ftell(file);
+	header.count[section] = data.size();
+	if (!data.empty())
+		fwrite(&data[0], sizeof(T), data.size(), file);
+}
+
+bool TrackCore::save_compiled(const std::string& path, const std::string& folder)
+{
+	std::string filename = folder + path;
+	FILE* file = fopen(filename.c_str(), "wb");
+	if (file == NULL)
+	{
+		printf("can't write file %s\n", filename.c_str());
+		return false;
+	}
+
+	CompiledHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, COMPILED_MAGIC, sizeof(header.magic));
+	header.version = COMPILED_VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.vertex_size = sizeof(Vertex);
+	header.orientation_size = sizeof(Orientation);
+	header.step_size = step_size;
+	header.arc_samples = ARC_SAMPLES_PER_SEGMENT;
+	header.ring_size = RAIL_RING_SIZE;
+	header.max_s = max_s;
+	header.hmax = hmax;
+	header.plank_spacing = plank_spacing;
+	header.source_count = (uint32_t)g_Track.files.size();
+
+	// the header is written again at the end, once the offsets are known
+	fwrite(&header, sizeof(header), 1, file);
+
+	for (size_t i = 0; i < g_Track.files.size(); i++)
+	{
+		const std::string& name = g_Track.files[i];
+		uint64_t hash = hash_file(folder + name);
+		uint32_t length = (uint32_t)name.size();
+		fwrite(&hash, sizeof(hash), 1, file);
+		fwrite(&length, sizeof(length), 1, file);
+		fwrite(name.data(), 1, length, file);
+	}
+
+	write_section(file, header, SECTION_CONTROL_POINTS, controlPoints);
+	write_section(file, header, SECTION_ARC_LENGTH, arc_length);
+	write_section(file, header, SECTION_FRAMES, frames);
+	write_section(file, header, SECTION_FRAME_DISTANCE, frame_distance);
+	write_section(file, header, SECTION_VERTICES, vertices);
+	write_section(file, header, SECTION_INDICES, indices);
+	write_section(file, header, SECTION_PLANK_VERTICES, plank_vertices);
+	write_section(file, header, SECTION_PLANK_INDICES, plank_indices);
+	write_section(file, header, SECTION_PLANK_TRANSFORMS, plank_transforms);
+
+	fseek(file, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, file);
+
+	bool ok = ferror(file) == 0;
+	fclose(file);
+	return ok;
+}
+
+// where one section starts in the mapping
+template <typename T>
+static const T* section_data(MappedFile& file, const CompiledHeader& header, CompiledSection section)
+{
+	return (const T*)(file.data() + header.offset[section]);
+}
+
+// Copy one section out of the mapping. The tables and frames are read all through the ride and the
+// plank mesh is made again by build_planks(), so they live in memory; only the rails stay in the file.
+template <typename T>
+static void read_section(MappedFile& file, const CompiledHeader& header, CompiledSection section, std::vector<T>& data)
+{
+	const T* first = section_data<T>(file, header, section);
+	data.assign(first, first + header.count[section]);
+}
+
+// every index below count
+static bool indices_below(const unsigned int* index, uint64_t size, uint64_t count)
+{
+	for (uint64_t i = 0; i < size; i++)
+		if (index[i] >= count) return false;
+	return true;
+}
+
+void TrackCore::release_compiled()
+{
+	compiled.close();
+	mapped_vertices = NULL;
+	mapped_indices = NULL;
+}
+
+bool TrackCore::load_compiled(const std::string& path, const std::string& folder)
+{
+	std::string filename = folder + path;
+
+	// a missing file is the normal case before the first compile, no message for that
+	MappedFile file;
+	if (!file.open(filename)) return false;
+
+	CompiledHeader header;
+	if (file.size() < sizeof(header))
+	{
+		printf("compiled track %s is truncated, ignoring it\n", filename.c_str());
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+
+	if (memcmp(header.magic, COMPILED_MAGIC, sizeof(header.magic)) != 0 || header.version != COMPILED_VERSION
+		|| header.byte_order != BYTE_ORDER_MARK || header.vertex_size != sizeof(Vertex)
+		|| header.orientation_size != sizeof(Orientation) || header.step_size != step_size
+		|| header.arc_samples != ARC_SAMPLES_PER_SEGMENT || header.ring_size != RAIL_RING_SIZE
+		|| header.max_s <= 0)
+	{
+		printf("compiled track %s is from another version, ignoring it\n", filename.c_str());
+		return false;
+	}
+
+	// the tables, frames and rails all follow from max_s
+	if (header.count[SECTION_CONTROL_POINTS] != (uint64_t)header.max_s
+		|| header.count[SECTION_ARC_LENGTH] != (uint64_t)header.max_s * ARC_SAMPLES_PER_SEGMENT + 1
+		|| header.count[SECTION_FRAMES] != (uint64_t)(header.max_s / step_size) + 1
+		|| header.count[SECTION_FRAME_DISTANCE] != header.count[SECTION_FRAMES]
+		|| header.count[SECTION_VERTICES] != header.count[SECTION_FRAMES] * RAIL_RING_SIZE
+		|| header.count[SECTION_INDICES] != (header.count[SECTION_FRAMES] - 1) * RAIL_PART_SIZE
+		|| header.count[SECTION_PLANK_INDICES] % 3 != 0)
+	{
+		printf("compiled track %s has sections that don't fit together, ignoring it\n", filename.c_str());
+		return false;
+	}
+
+	for (int section = 0; section < SECTION_COUNT; section++)
+	{
+		uint64_t end = header.offset[section] + header.count[section] * SECTION_ELEMENT_SIZE[section];
+		if (header.offset[section] % 16 != 0 || end > file.size() || end < header.offset[section])
+		{
+			printf("compiled track %s is truncated, ignoring it\n", filename.c_str());
+			return false;
+		}
+	}
+
+	// the draws can't be allowed to read past the vertex buffers
+	if (!indices_below(section_data<unsigned int>(file, header, SECTION_INDICES), header.count[SECTION_INDICES], header.count[SECTION_VERTICES])
+		|| !indices_below(section_data<unsigned int>(file, header, SECTION_PLANK_INDICES), header.count[SECTION_PLANK_INDICES],
+			header.count[SECTION_PLANK_VERTICES]))
+	{
+		printf("compiled track %s has indices out of range, ignoring it\n", filename.c_str());
+		return false;
+	}
+
+	// every .sp file it was made from has to be unchanged
+	std::vector<std::string> sources;
+	size_t position = sizeof(header);
+	for (uint32_t i = 0; i < header.source_count; i++)
+	{
+		uint64_t hash;
+		uint32_t length;
+		if (position + sizeof(hash) + sizeof(length) > file.size())
+		{
+			printf("compiled track %s is truncated, ignoring it\n", filename.c_str());
+			return false;
+		}
+		memcpy(&hash, file.data() + position, sizeof(hash));
+		memcpy(&length, file.data() + position + sizeof(hash), sizeof(length));
+		position += sizeof(hash) + sizeof(length);
+
+		if (position + length > file.size())
+		{
+			printf("compiled track %s is truncated, ignoring it\n", filename.c_str());
+			return false;
+		}
+		std::string name((const char*)file.data() + position, length);
+		position += length;
+
+		if (hash_file(folder + name) != hash)
+		{
+			printf("compiled track %s is older than %s, loading the spline instead\n", filename.c_str(), name.c_str());
+			return false;
+		}
+		sources.push_back(name);
+	}
+
+	// everything checks out, take it all
+	g_Track.folder = folder;
+	g_Track.files = sources;
+	g_Track.points().clear();
+
+	max_s = header.max_s;
+	hmax = header.hmax;
+	plank_spacing = header.plank_spacing;
+
+	read_section(file, header, SECTION_CONTROL_POINTS, controlPoints);
+	read_section(file, header, SECTION_ARC_LENGTH, arc_length);
+	read_section(file, header, SECTION_FRAMES, frames);
+	read_section(file, header, SECTION_FRAME_DISTANCE, frame_distance);
+	read_section(file, header, SECTION_PLANK_VERTICES, plank_vertices);
+	read_section(file, header, SECTION_PLANK_INDICES, plank_indices);
+	read_section(file, header, SECTION_PLANK_TRANSFORMS, plank_transforms);
+
+	// the rails go to the GPU straight from the mapping, which stays open until release_compiled()
+	vertices.clear();
+	indices.clear();
+	mapped_vertices = section_data<Vertex>(file, header, SECTION_VERTICES);
+	mapped_indices = section_data<unsigned int>(file, header, SECTION_INDICES);
+	mapped_vertex_count = header.count[SECTION_VERTICES];
+	mapped_index_count = header.count[SECTION_INDICES];
+	compiled.swap(file);
+
+	// get_point and everything built on it need these, they are quick to make
+	build_segment_coefficients();
+
+	return true;
+}
@@ -0,0 +1,933 @@
+/*** @file track_core.cpp
+*
+*   @brief GL-free part of the track: spline evaluation, frames and mesh generation
+**/
+
+#include <track_core.hpp>
+#include <thread_pool.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// the batch evaluator uses the widest instruction set the compiler was told it can use,
+// x64 always has SSE2
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRACK_CORE_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRACK_CORE_SSE2
+#endif
+
+
+TrackCore::TrackCore(const char* trackPath)
+{
+	// the compiled track has everything already, no need to read the spline
+	if (load_compiled(compiled_path(trackPath)))
+		return;
+
+	// load Track data, there is nothing to show without it
+	if (!load_track(trackPath))
+		exit(1);
+
+	create_track();
+}
+
+bool TrackCore::load_track(const char* trackPath, std::string folder)
+{
+	// Set folder path for our projects (easier than repeatedly defining it)
+	g_Track.folder = folder;
+
+	// Load the control points
+	return g_Track.loadSplineFrom(trackPath);
+}
+
+// Here is the class where you will make the vertices or positions of the necessary objects of the track (calling subfunctions)
+//  For example, to make a basic roller coster:
+//    First, make the vertices for each rail here (and indices for the EBO if you do it that way).  
+//        You need the XYZ world coordinates, the Normal Coordinates, and the texture coordinates.
+//        The normal coordinates are necessary for the lighting to work.  
+//    Second, make vector of transformations for the planks across the rails
+void TrackCore::create_track()
+{
+	controlPoints.clear();
+	frames.clear();
+	frame_distance.clear();
+	vertices.clear();
+	indices.clear();
+
+	build_control_points();
+	build_segment_coefficients();
+	build_arc_length_table();
+	build_frames();
+	build_mesh();
+	build_planks();
+}
+
+void TrackCore::build_control_points()
+{
+	glm::vec3 currentpos = glm::vec3(-2.0f, 0.0f, -2.0f);
+	max_s = 0;
+	hmax = 0.0f;
+
+	for (pointVectorIter ptsiter = g_Track.points().begin(); ptsiter != g_Track.points().end(); ptsiter++)
+	{
+		/* get the next point from the iterator */
+		glm::vec3 pt(*ptsiter);
+
+		/* now just the uninteresting code that is no use at all for this project */
+		currentpos += pt;
+
+		// Set the control points apart
+		controlPoints.push_back(currentpos * 2.0f);
+
+		// record the hmax
+		if (currentpos.y * 2.0f > hmax) hmax = currentpos.y * 2.0f;
+
+		max_s += 1;
+	}
+
+	hmax *= 1.05f;
+}
+
+// multiply the tau matrix out once per segment, so evaluating a point is just a cubic in u
+void TrackCore::build_segment_coefficients()
+{
+	glm::mat4 mat_tau = catmull_rom_matrix(0.5f);
+
+	coeff_x.assign(max_s * 4, 0.0f);
+	coeff_y.assign(max_s * 4, 0.0f);
+	coeff_z.assign(max_s * 4, 0.0f);
+
+	for (int i = 0; i < max_s; i++)
+	{
+		glm::mat4x3 mat_points;
+		mat_points[0] = controlPoints[(i + max_s - 1) % max_s];
+		mat_points[1] = controlPoints[i];
+		mat_points[2] = controlPoints[(i + 1) % max_s];
+		mat_points[3] = controlPoints[(i + 2) % max_s];
+
+		// column k holds the coefficient of u^k
+		glm::mat4x3 coeffs = mat_points * mat_tau;
+		for (int k = 0; k < 4; k++)
+		{
+			coeff_x[i * 4 + k] = coeffs[k].x;
+			coeff_y[i * 4 + k] = coeffs[k].y;
+			coeff_z[i * 4 + k] = coeffs[k].z;
+		}
+	}
+}
+
+// fill arc_length with the cumulative distance at every table step
+void TrackCore::build_arc_length_table()
+{
+	int n = max_s * ARC_SAMPLES_PER_SEGMENT;
+
+	arc_length.clear();
+	arc_length.reserve(n + 1);
+	arc_length.push_back(0.0f);
+
+	// accumulate in double so long tracks don't lose the small steps at the end
+	double total = 0.0;
+	for (int i = 0; i < n; i++)
+	{
+		float s0 = (float)i / ARC_SAMPLES_PER_SEGMENT;
+		float s1 = (float)(i + 1) / ARC_SAMPLES_PER_SEGMENT;
+		total += integrate_length(s0, s1);
+		arc_length.push_back((float)total);
+	}
+}
+
+// Rotation-minimizing frames by double reflection (Wang et al. 2008): each frame is the
+// previous one reflected across the plane between the two origins, then across the plane
+// between the reflected and the actual tangent. That keeps Up from spinning around Front
+// any more than the curve forces it to.
+// A closed loop generally comes back twisted by some angle, which is taken out a little at
+// every frame in proportion to the distance travelled, so the last frame matches the first.
+void TrackCore::build_frames()
+{
+	int count = (int)(max_s / step_size) + 1;
+	frames.reserve(count);
+	frame_distance.reserve(count);
+
+	// every origin in one go through the batch evaluator, the tangents one at a time
+	std::vector<float> s(count), x(count), y(count), z(count);
+	for (int k = 0; k < count; k++)
+		s[k] = k * step_size;
+	get_points(&s[0], count, &x[0], &y[0], &z[0]);
+
+	// Initialize on s=0, Up is world up made perpendicular to Front
+	Orientation ori;
+	ori.origin = glm::vec3(x[0], y[0], z[0]);
+	ori.Front = get_tangent(0.0f);
+	ori.Up = glm::vec3(0.0f, 1.0f, 0.0f) - ori.Front.y * ori.Front;
+	ori.Up = glm::length(ori.Up) > 1.0e-3f ? glm::normalize(ori.Up) : glm::vec3(0.0f, 0.0f, 1.0f);
+	ori.Right = glm::normalize(glm::cross(ori.Front, ori.Up));
+
+	frames.push_back(ori);
+	frame_distance.push_back(0.0f);
+
+	// Then traverse the spline with small steps
+	for (int k = 1; k < count; k++)
+	{
+		Orientation prev = ori;
+		glm::vec3 position(x[k], y[k], z[k]);
+		glm::vec3 tangent = get_tangent(s[k]);
+
+		// first reflection, across the plane halfway between the two origins
+		glm::vec3 v1 = position - prev.origin;
+		float c1 = glm::dot(v1, v1);
+		glm::vec3 up_l = prev.Up, front_l = prev.Front;
+		if (c1 > 0.0f)
+		{
+			up_l -= (2.0f / c1) * glm::dot(v1, prev.Up) * v1;
+			front_l -= (2.0f / c1) * glm::dot(v1, prev.Front) * v1;
+		}
+
+		// second reflection, turns the reflected tangent onto the actual one
+		glm::vec3 v2 = tangent - front_l;
+		float c2 = glm::dot(v2, v2);
+		if (c2 > 0.0f)
+			up_l -= (2.0f / c2) * glm::dot(v2, up_l) * v2;
+
+		ori.origin = position;
+		ori.Front = tangent;
+		// remove the rounding error so Up stays perpendicular to Front
+		ori.Up = glm::normalize(up_l - glm::dot(up_l, ori.Front) * ori.Front);
+		ori.Right = glm::normalize(glm::cross(ori.Front, ori.Up));
+
+		frames.push_back(ori);
+		// distance_at wraps s = max_s back to 0, the last frame is at the end of the loop instead
+		frame_distance.push_back(k == count - 1 ? track_length() : distance_at(s[k]));
+	}
+
+	// twist between where Up came back to and where it started, measured around Front
+	const Orientation& first = frames.front();
+	const Orientation& last = frames.back();
+	float twist = atan2(glm::dot(glm::cross(last.Up, first.Up), last.Front), glm::dot(last.Up, first.Up));
+
+	float total = track_length();
+	for (size_t k = 1; k < frames.size(); k++)
+	{
+		float angle = twist * frame_distance[k] / total;
+		Orientation& f = frames[k];
+
+		// rotate Up around Front, Up is perpendicular to Front so Rodrigues' formula is just this
+		f.Up = glm::normalize(f.Up * cos(angle) + glm::cross(f.Front, f.Up) * sin(angle));
+		f.Right = glm::normalize(glm::cross(f.Front, f.Up));
+	}
+}
+
+// Create the vertices for the rails from the frames
+// Every ring and every rail part has a fixed size, so where each one goes in the buffers is
+// known up front. The buffers are sized once and the rings are written in parallel,
+// each thread takes a run of consecutive frames. The result is the same as doing it in order.
+void TrackCore::build_mesh()
+{
+	// Create the vertices and indices (optional) for the rails
+	//    One trick in creating these is to move along the spline and 
+	//    shift left and right (from the forward direction of the spline) 
+	//     to find the 3D coordinates of the rails.
+
+	// rails from a compiled file are replaced
+	release_compiled();
+	mapped_vertex_count = mapped_index_count = 0;
+
+	// ring k starts at vertex k * RAIL_RING_SIZE, the rail part that ends at ring k at index (k - 1) * RAIL_PART_SIZE
+	vertices.resize(frames.size() * RAIL_RING_SIZE);
+	indices.resize((frames.size() - 1) * RAIL_PART_SIZE);
+
+	ThreadPool::shared().parallel_for(0, frames.size(), [this](size_t first, size_t last)
+	{
+		for (size_t k = first; k < last; k++)
+		{
+			unsigned int cur_ring = k * RAIL_RING_SIZE;
+			makeRailRing(frames[k], glm::vec2(0.5f, 0.1f), (float)k, &vertices[cur_ring]);
+
+			// rail between this frame and the one before
+			if (k > 0)
+				makeRailPart(cur_ring - RAIL_RING_SIZE, cur_ring, &indices[(k - 1) * RAIL_PART_SIZE]);
+		}
+	}, threads);
+}
+
+// how many of spacing, 2 * spacing ... fit before total, the start of the loop is left out
+size_t TrackCore::spacing_count(float total, float spacing)
+{
+	size_t count = (size_t)(total / spacing);
+	if (count > 0 && count * spacing >= total) count--;
+	return count;
+}
+
+// Planks are all the same box, so there is only one mesh and a model matrix per plank.
+// They are placed at exact distances along the track instead of every few frames,
+// so they are evenly spaced however fast the spline moves.
+// Plank i is at (i + 1) * plank_spacing, the transforms are found in parallel.
+void TrackCore::build_planks()
+{
+	if (plank_vertices.empty())
+		makePlank(glm::vec2(0.5f, 0.1f));
+
+	plank_transforms.clear();
+	if (plank_spacing <= 0.0f) return;
+
+	float spacing = plank_spacing;
+	plank_transforms.resize(spacing_count(track_length(), spacing));
+
+	ThreadPool::shared().parallel_for(0, plank_transforms.size(), [this, spacing](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			Orientation ori = frame_at(s_at_distance((i + 1) * spacing));
+
+			glm::mat4 transform;
+			transform[0] = glm::vec4(ori.Right, 0.0f);
+			transform[1] = glm::vec4(ori.Up, 0.0f);
+			transform[2] = glm::vec4(-ori.Front, 0.0f);
+			transform[3] = glm::vec4(ori.origin, 1.0f);
+			plank_transforms[i] = transform;
+		}
+	}, threads);
+}
+
+void TrackCore::build_supports(const GroundQuery& ground)
+{
+	if (support_vertices.empty())
+		makePillar(0.06f);
+
+	support_instances.clear();
+	if (support_spacing <= 0.0f || !ground) return;
+
+	float spacing = support_spacing;
+	size_t count = spacing_count(track_length(), spacing);
+	if (count == 0) return;
+
+	// the top of every pillar and the point on the ground below it
+	std::vector<glm::vec3> tops(count);
+	std::vector<glm::vec2> points(count);
+	std::vector<char> upright(count);
+	ThreadPool::shared().parallel_for(0, count, [this, spacing, &tops, &points, &upright](size_t first, size_t last)
+	{
+		for (size_t i = first; i < last; i++)
+		{
+			Orientation ori = frame_at(s_at_distance((i + 1) * spacing));
+			tops[i] = ori.origin - ori.Up * SUPPORT_TOP_OFFSET;
+			points[i] = glm::vec2(tops[i].x, tops[i].z);
+			upright[i] = ori.Up.y >= support_min_up;
+		}
+	}, threads);
+
+	std::vector<float> heights(count);
+	ground(&points[0], points.size(), &heights[0]);
+
+	support_instances.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!upright[i] || tops[i].y - heights[i] < support_min_height) continue;
+
+		float bottom = heights[i] - SUPPORT_SINK;
+		support_instances.push_back(glm::vec4(tops[i].x, bottom, tops[i].z, tops[i].y - bottom));
+	}
+}
+
+// give a positive float s, find the point by interpolation
+// the segment is chosen by the integer of s and u is the decimal of s
+// E.g. s=1.5 is the at the halfway point between the 1st and 2nd control point,
+//		the 4 control points are:[0,1,2,3], with u=0.5
+glm::vec3 TrackCore::get_point(float s)
+{
+	float u;
+	int i = segment_of(s, u) * 4;
+
+	// Horner's scheme on the coefficients from build_segment_coefficients()
+	return glm::vec3(
+		((coeff_x[i + 3] * u + coeff_x[i + 2]) * u + coeff_x[i + 1]) * u + coeff_x[i],
+		((coeff_y[i + 3] * u + coeff_y[i + 2]) * u + coeff_y[i + 1]) * u + coeff_y[i],
+		((coeff_z[i + 3] * u + coeff_z[i + 2]) * u + coeff_z[i + 1]) * u + coeff_z[i]);
+}
+
+// same as get_point, but returns the derivative dP/ds instead of the position
+glm::vec3 TrackCore::get_derivative(float s)
+{
+	float u;
+	int i = segment_of(s, u) * 4;
+
+	return glm::vec3(
+		(3.0f * coeff_x[i + 3] * u + 2.0f * coeff_x[i + 2]) * u + coeff_x[i + 1],
+		(3.0f * coeff_y[i + 3] * u + 2.0f * coeff_y[i + 2]) * u + coeff_y[i + 1],
+		(3.0f * coeff_z[i + 3] * u + 2.0f * coeff_z[i + 2]) * u + coeff_z[i + 1]);
+}
+
+// derivative of get_derivative, 2*c2 + 6*c3*u
+glm::vec3 TrackCore::get_second_derivative(float s)
+{
+	float u;
+	int i = segment_of(s, u) * 4;
+
+	return glm::vec3(
+		6.0f * coeff_x[i + 3] * u + 2.0f * coeff_x[i + 2],
+		6.0f * coeff_y[i + 3] * u + 2.0f * coeff_y[i + 2],
+		6.0f * coeff_z[i + 3] * u + 2.0f * coeff_z[i + 2]);
+}
+
+// unit tangent at s, the exact direction of travel
+glm::vec3 TrackCore::get_tangent(float s)
+{
+	return glm::normalize(get_derivative(s));
+}
+
+// curvature at s, 1 / radius of the turn
+float TrackCore::get_curvature(float s)
+{
+	return evaluate(s).curvature;
+}
+
+// All of the above from one segment lookup. With d = P' and dd = P'':
+//   tangent   = d / |d|
+//   curvature = |d x dd| / |d|^3
+//   normal    = the part of dd perpendicular to the tangent, normalized
+// The normal is left at zero where the track is straight, it has no direction there.
+SplinePoint TrackCore::evaluate(float s)
+{
+	float u;
+	int i = segment_of(s, u) * 4;
+
+	glm::vec3 c0(coeff_x[i], coeff_y[i], coeff_z[i]);
+	glm::vec3 c1(coeff_x[i + 1], coeff_y[i + 1], coeff_z[i + 1]);
+	glm::vec3 c2(coeff_x[i + 2], coeff_y[i + 2], coeff_z[i + 2]);
+	glm::vec3 c3(coeff_x[i + 3], coeff_y[i + 3], coeff_z[i + 3]);
+
+	glm::vec3 d = (3.0f * c3 * u + 2.0f * c2) * u + c1;
+	glm::vec3 dd = 6.0f * c3 * u + 2.0f * c2;
+
+	SplinePoint point;
+	point.position = ((c3 * u + c2) * u + c1) * u + c0;
+
+	float speed = glm::length(d);
+	point.tangent = d / speed;
+	point.curvature = glm::length(glm::cross(d, dd)) / (speed * speed * speed);
+
+	glm::vec3 across = dd - glm::dot(dd, point.tangent) * point.tangent;
+	float across_length = glm::length(across);
+	point.normal = across_length > 1.0e-6f * (1.0f + glm::length(dd)) ? across / across_length : glm::vec3(0.0f);
+
+	return point;
+}
+
+// determine pA, pB, pC, pD based on the integer of s and run the full matrix product,
+// this is what get_point used to do before the coefficients were cached
+glm::vec3 TrackCore::get_point_reference(float s)
+{
+	// use modulo operation to ensure all points are valid (max_s hard-coded)
+	int pA = ((int)floor(s) + max_s - 1) % max_s;
+	int pB = ((int)floor(s) + max_s) % max_s;
+	int pC = ((int)floor(s) + max_s + 1) % max_s;
+	int pD = ((int)floor(s) + max_s + 2) % max_s;
+	float u = s - floor(s);
+
+	return interpolate(controlPoints[pA], controlPoints[pB], controlPoints[pC], controlPoints[pD], 0.5f, u);
+}
+
+// Same cubic as get_point, several s at a time. The coefficients of each lane's segment are
+// gathered from the per axis arrays, the rest is straight vector math.
+// Whatever doesn't fill a whole vector goes through get_point.
+void TrackCore::get_points(const float* s, int count, float* out_x, float* out_y, float* out_z)
+{
+	int n = 0;
+
+#if defined(TRACK_CORE_AVX2)
+	const __m256 segments = _mm256_set1_ps((float)max_s);
+	const __m256 last = _mm256_set1_ps((float)(max_s - 1));
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (; n + 8 <= count; n += 8)
+	{
+		__m256 vs = _mm256_loadu_ps(s + n);
+		__m256 whole = _mm256_floor_ps(vs);
+		__m256 u = _mm256_sub_ps(vs, whole);
+
+		// segment = floor(s) mod max_s, the clamp only guards against rounding
+		__m256 seg = _mm256_sub_ps(whole, _mm256_mul_ps(segments, _mm256_floor_ps(_mm256_div_ps(whole, segments))));
+		seg = _mm256_min_ps(_mm256_max_ps(seg, zero), last);
+		__m256i base = _mm256_slli_epi32(_mm256_cvtps_epi32(seg), 2);
+
+		const float* coeffs[3] = { &coeff_x[0], &coeff_y[0], &coeff_z[0] };
+		float* outs[3] = { out_x, out_y, out_z };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m256 c0 = _mm256_i32gather_ps(coeffs[axis] + 0, base, 4);
+			__m256 c1 = _mm256_i32gather_ps(coeffs[axis] + 1, base, 4);
+			__m256 c2 = _mm256_i32gather_ps(coeffs[axis] + 2, base, 4);
+			__m256 c3 = _mm256_i32gather_ps(coeffs[axis] + 3, base, 4);
+
+			__m256 p = _mm256_add_ps(_mm256_mul_ps(c3, u), c2);
+			p = _mm256_add_ps(_mm256_mul_ps(p, u), c1);
+			p = _mm256_add_ps(_mm256_mul_ps(p, u), c0);
+			_mm256_storeu_ps(outs[axis] + n, p);
+		}
+	}
+#elif defined(TRACK_CORE_SSE2)
+	const __m128 segments = _mm_set1_ps((float)max_s);
+	const __m128 last = _mm_set1_ps((float)(max_s - 1));
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (; n + 4 <= count; n += 4)
+	{
+		__m128 vs = _mm_loadu_ps(s + n);
+
+		// SSE2 has no floor: truncate, then step down where that rounded up (negative s)
+		__m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(vs));
+		whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, vs), one));
+		__m128 u = _mm_sub_ps(vs, whole);
+
+		// segment = floor(s) mod max_s, the clamp only guards against rounding
+		__m128 q = _mm_div_ps(whole, segments);
+		__m128 q_whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(q));
+		q_whole = _mm_sub_ps(q_whole, _mm_and_ps(_mm_cmpgt_ps(q_whole, q), one));
+		__m128 seg = _mm_sub_ps(whole, _mm_mul_ps(segments, q_whole));
+		seg = _mm_min_ps(_mm_max_ps(seg, zero), last);
+
+		int base[4];
+		_mm_storeu_si128((__m128i*)base, _mm_slli_epi32(_mm_cvtps_epi32(seg), 2));
+
+		const float* coeffs[3] = { &coeff_x[0], &coeff_y[0], &coeff_z[0] };
+		float* outs[3] = { out_x, out_y, out_z };
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float* c = coeffs[axis];
+			__m128 c0 = _mm_set_ps(c[base[3]], c[base[2]], c[base[1]], c[base[0]]);
+			__m128 c1 = _mm_set_ps(c[base[3] + 1], c[base[2] + 1], c[base[1] + 1], c[base[0] + 1]);
+			__m128 c2 = _mm_set_ps(c[base[3] + 2], c[base[2] + 2], c[base[1] + 2], c[base[0] + 2]);
+			__m128 c3 = _mm_set_ps(c[base[3] + 3], c[base[2] + 3], c[base[1] + 3], c[base[0] + 3]);
+
+			__m128 p = _mm_add_ps(_mm_mul_ps(c3, u), c2);
+			p = _mm_add_ps(_mm_mul_ps(p, u), c1);
+			p = _mm_add_ps(_mm_mul_ps(p, u), c0);
+			_mm_storeu_ps(outs[axis] + n, p);
+		}
+	}
+#endif
+
+	for (; n < count; n++)
+	{
+		glm::vec3 p = get_point(s[n]);
+		out_x[n] = p.x;
+		out_y[n] = p.y;
+		out_z[n] = p.z;
+	}
+}
+
+// total length of one loop of the track
+float TrackCore::track_length()
+{
+	return arc_length.back();
+}
+
+// distance along the track from s=0 to the given s
+// the table gives the distance up to the closest sample below s, the rest is integrated
+float TrackCore::distance_at(float s)
+{
+	s = wrap_s(s);
+
+	int i = (int)(s * ARC_SAMPLES_PER_SEGMENT);
+	if (i >= (int)arc_length.size() - 1) i = (int)arc_length.size() - 2;
+
+	// right on a table step there is nothing left to integrate
+	float s_i = (float)i / ARC_SAMPLES_PER_SEGMENT;
+	if (s == s_i) return arc_length[i];
+
+	return arc_length[i] + integrate_length(s_i, s);
+}
+
+// inverse of distance_at: find the s that is the given distance away from s=0
+// binary search the table for the bracketing samples, then refine with Newton's method
+// since d(distance)/ds = |dP/ds|
+float TrackCore::s_at_distance(float distance)
+{
+	float total = track_length();
+	distance = fmod(distance, total);
+	if (distance < 0.0f) distance += total;
+
+	// first entry that is greater than distance, the answer is between it and the one before
+	std::vector<float>::iterator upper = std::upper_bound(arc_length.begin(), arc_length.end(), distance);
+	int i = (int)(upper - arc_length.begin()) - 1;
+	if (i < 0) i = 0;
+	if (i >= (int)arc_length.size() - 1) i = (int)arc_length.size() - 2;
+
+	float s_lo = (float)i / ARC_SAMPLES_PER_SEGMENT;
+	float s_hi = (float)(i + 1) / ARC_SAMPLES_PER_SEGMENT;
+
+	// initial guess: linear between the two samples
+	float span = arc_length[i + 1] - arc_length[i];
+	float s = s_lo;
+	if (span > 0.0f) s += (distance - arc_length[i]) / span * (s_hi - s_lo);
+
+	// a few Newton steps are enough, the guess is already within one table step
+	for (int iter = 0; iter < 3; iter++)
+	{
+		float speed = glm::length(get_derivative(s));
+		if (speed <= 0.0f) break;
+
+		float error = arc_length[i] + integrate_length(s_lo, s) - distance;
+		s -= error / speed;
+
+		// never leave the bracketing interval
+		if (s < s_lo) s = s_lo;
+		if (s > s_hi) s = s_hi;
+	}
+
+	return s;
+}
+
+// orientation at any s, interpolated between the two closest frames
+// origin comes from the spline, the axes are made orthonormal again after blending
+Orientation TrackCore::frame_at(float s)
+{
+	s = wrap_s(s);
+
+	int k = (int)(s / step_size);
+	if (k > (int)frames.size() - 2) k = (int)frames.size() - 2;
+
+	Orientation ori = blend_frames(k, s / step_size - k);
+	ori.origin = get_point(s);
+	return ori;
+}
+
+// orientation at any distance along the track, interpolated between the two closest frames
+// binary search frame_distance for the bracketing pair, the origin is blended like the axes
+Orientation TrackCore::frame_at_distance(float distance)
+{
+	float total = track_length();
+	distance = fmod(distance, total);
+	if (distance < 0.0f) distance += total;
+
+	std::vector<float>::iterator upper = std::upper_bound(frame_distance.begin(), frame_distance.end(), distance);
+	int k = (int)(upper - frame_distance.begin()) - 1;
+	if (k < 0) k = 0;
+	if (k > (int)frames.size() - 2) k = (int)frames.size() - 2;
+
+	float span = frame_distance[k + 1] - frame_distance[k];
+	float t = span > 0.0f ? (distance - frame_distance[k]) / span : 0.0f;
+
+	return blend_frames(k, t);
+}
+
+// frames[k] and frames[k + 1] mixed by t, the axes orthonormalized again
+Orientation TrackCore::blend_frames(int k, float t)
+{
+	Orientation ori;
+	ori.origin = glm::mix(frames[k].origin, frames[k + 1].origin, t);
+	ori.Front = glm::normalize(glm::mix(frames[k].Front, frames[k + 1].Front, t));
+	ori.Right = glm::normalize(glm::cross(ori.Front, glm::mix(frames[k].Up, frames[k + 1].Up, t)));
+	ori.Up = glm::cross(ori.Right, ori.Front);
+	return ori;
+}
+
+// map any s into [0, max_s)
+float TrackCore::wrap_s(float s)
+{
+	s = fmod(s, (float)max_s);
+	if (s < 0.0f) s += max_s;
+	return s;
+}
+
+// segment that s falls in and the u within it, any s works
+int TrackCore::segment_of(float s, float &u)
+{
+	float whole = floor(s);
+	u = s - whole;
+
+	int i = (int)whole % max_s;
+	if (i < 0) i += max_s;
+	return i;
+}
+
+// length of the spline between s0 and s1 (within the same table step),
+// 5 point Gauss-Legendre quadrature of |dP/ds|
+float TrackCore::integrate_length(float s0, float s1)
+{
+	static const float nodes[5] = { 0.0f, -0.5384693101f, 0.5384693101f, -0.9061798459f, 0.9061798459f };
+	static const float weights[5] = { 0.5688888889f, 0.4786286705f, 0.4786286705f, 0.2369268851f, 0.2369268851f };
+
+	float half = 0.5f * (s1 - s0);
+	float mid = 0.5f * (s1 + s0);
+
+	float length = 0.0f;
+	for (int k = 0; k < 5; k++)
+		length += weights[k] * glm::length(get_derivative(mid + half * nodes[k]));
+
+	return length * half;
+}
+
+// matrix that turns [1, u, u^2, u^3] into the weights of the 4 control points
+glm::mat4 TrackCore::catmull_rom_matrix(float tau)
+{
+	glm::mat4 mat_tau;
+
+	// each group is a column
+	mat_tau[0].x = 0;
+	mat_tau[0].y = -tau;
+	mat_tau[0].z = 2*tau;
+	mat_tau[0].w = -tau;
+
+	mat_tau[1].x = 1;
+	mat_tau[1].y = 0;
+	mat_tau[1].z = tau-3;
+	mat_tau[1].w = 2-tau;
+
+	mat_tau[2].x = 0;
+	mat_tau[2].y = tau;
+	mat_tau[2].z = 3-2*tau;
+	mat_tau[2].w = tau-2;
+
+	mat_tau[3].x = 0;
+	mat_tau[3].y = 0;
+	mat_tau[3].z = -tau;
+	mat_tau[3].w = tau;
+
+	return glm::transpose(mat_tau);
+}
+
+// Implement the Catmull-Rom Spline here
+//	Given 4 points, a tau and the u value 
+//	u in range of [0,1]  
+//	Since you can just use linear algebra from glm, just make the vectors and matrices and multiply them.  
+//	This should not be a very complicated function
+glm::vec3 TrackCore::interpolate(glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, float tau, float u)
+{
+	// Construct a matrix with points 		
+	glm::mat4x3 mat_points;
+	mat_points[0] = pointA;
+	mat_points[1] = pointB;
+	mat_points[2] = pointC;
+	mat_points[3] = pointD;
+
+	// Construct a matrix with tau
+	glm::mat4 mat_tau = catmull_rom_matrix(tau);
+
+	// Construct a vector with u
+	glm::vec4 vec_u;
+
+	vec_u[0] = 1;
+	vec_u[1] = u;
+	vec_u[2] = u * u;
+	vec_u[3] = u * u * u;
+
+	// Return the interpolated point
+	return mat_points * mat_tau * vec_u; 
+}
+
+// derivative of interpolate() with respect to u, same matrices with [0, 1, 2u, 3u^2]
+glm::vec3 TrackCore::interpolate_derivative(glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, float tau, float u)
+{
+	glm::mat4x3 mat_points;
+	mat_points[0] = pointA;
+	mat_points[1] = pointB;
+	mat_points[2] = pointC;
+	mat_points[3] = pointD;
+
+	glm::vec4 vec_du;
+
+	vec_du[0] = 0;
+	vec_du[1] = 1;
+	vec_du[2] = 2 * u;
+	vec_du[3] = 3 * u * u;
+
+	return mat_points * catmull_rom_matrix(tau) * vec_du;
+}
+
+// Given 4 Points, push a quad of 4 vertices and 2 triangles of indices into the given mesh
+// Optional boolean to flip the normal if you need to
+
+//			A---------------------B
+//			|					  |
+//			|					  |
+//			C---------------------D
+
+// By default, All four points has same normal, calculated by AC X AB
+
+void TrackCore::make_face(std::vector<Vertex> &out_vertices, std::vector<unsigned int> &out_indices, glm::vec3 pointA, glm::vec3 pointB, glm::vec3 pointC, glm::vec3 pointD, bool flipNormal)
+{
+	glm::vec3 normal = glm::normalize(glm::cross((pointC - pointA), (pointB - pointA)));
+	if (flipNormal) normal = -normal;
+
+	unsigned int base = out_vertices.size();
+
+	Vertex A, B, C, D;
+	A.Position = pointA; B.Position = pointB; C.Position = pointC; D.Position = pointD;
+	A.Normal = normal; B.Normal = normal; C.Normal = normal; D.Normal = normal;
+	A.TexCoords = glm::vec2(0.0f, 1.0f);
+	B.TexCoords = glm::vec2(1.0f, 1.0f);
+	C.TexCoords = glm::vec2(0.0f, 0.0f);
+	D.TexCoords = glm::vec2(1.0f, 0.0f);
+
+	out_vertices.push_back(A);
+	out_vertices.push_back(B);
+	out_vertices.push_back(C);
+	out_vertices.push_back(D);
+
+	// Push: up triangle
+	out_indices.push_back(base + 0);
+	out_indices.push_back(base + 1);
+	out_indices.push_back(base + 2);
+
+	// Push: down triangle
+	out_indices.push_back(base + 2);
+	out_indices.push_back(base + 1);
+	out_indices.push_back(base + 3);
+}
+
+// Cross section of the two rails around one orientation. Offset can be useful if you want to call this for more than for multiple rails
+//			A-----B						 E-----F
+//			|	  |      Center of       |	   |
+//			|	  |		 Ori.origin      |	   |
+//			C-----D						 G-----H
+
+// In the figure above, front vector is point into the screen, dimension is shown below:
+// lengh(AC) = 2*up_offset; lengh(AF)=2*right_offset; lengh(AB) = 2*up_offset
+
+// Every face of a rail gets its own pair of vertices so the edges stay sharp,
+// 4 faces * 2 rails * 2 vertices = RAIL_RING_SIZE vertices per ring.
+// u is the texture coordinate along the track, the texture repeats once per ring.
+// The ring is written to out[0] .. out[RAIL_RING_SIZE - 1].
+
+void TrackCore::makeRailRing(Orientation ori, glm::vec2 offset, float u, Vertex* out)
+{
+	// offset[0] = left & right offset, offset[1] = up & down offset
+	glm::vec3 right_offset_1 = ori.Right * offset[0];			   // long horizontal offset, like A to center
+	glm::vec3 right_offset_2 = ori.Right * (offset[0] - offset[1]); // short horizontal offset, like B to center
+	glm::vec3 up_offset = ori.Up * offset[1];
+
+	glm::vec3 A = ori.origin - right_offset_1 + up_offset;
+	glm::vec3 F = ori.origin + right_offset_1 + up_offset;
+	glm::vec3 C = ori.origin - right_offset_1 - up_offset;
+	glm::vec3 H = ori.origin + right_offset_1 - up_offset;
+
+	glm::vec3 B = ori.origin - right_offset_2 + up_offset;
+	glm::vec3 E = ori.origin + right_offset_2 + up_offset;
+	glm::vec3 D = ori.origin - right_offset_2 - up_offset;
+	glm::vec3 G = ori.origin + right_offset_2 - up_offset;
+
+	// the two edges of each face (same order as the old per-quad faces) and its outward normal
+	glm::vec3 edges[8][2] = {
+		{ B, D }, { A, B }, { C, A }, { D, C }, // left rail: right, up, left, bottom face
+		{ F, H }, { E, F }, { G, E }, { H, G }  // right rail: right, up, left, bottom face
+	};
+	glm::vec3 normals[4] = { ori.Right, ori.Up, -ori.Right, -ori.Up };
+
+	for (int face = 0; face < 8; face++)
+	{
+		Vertex v;
+		v.Normal = normals[face % 4];
+
+		v.Position = edges[face][0];
+		v.TexCoords = glm::vec2(u, 1.0f);
+		out[2 * face] = v;
+
+		v.Position = edges[face][1];
+		v.TexCoords = glm::vec2(u, 0.0f);
+		out[2 * face + 1] = v;
+	}
+}
+
+// Given the first vertex of two rings made by makeRailRing, create the rail between them
+// Same triangles as make_face, the vertices are shared with the neighbouring rail parts
+// The indices are written to out[0] .. out[RAIL_PART_SIZE - 1].
+
+void TrackCore::makeRailPart(unsigned int prev_ring, unsigned int cur_ring, unsigned int* out)
+{
+	for (unsigned int face = 0; face < 8; face++)
+	{
+		unsigned int A = prev_ring + 2 * face;
+		unsigned int B = cur_ring + 2 * face;
+		unsigned int C = A + 1;
+		unsigned int D = B + 1;
+
+		// up triangle
+		out[6 * face + 0] = A;
+		out[6 * face + 1] = B;
+		out[6 * face + 2] = C;
+
+		// down triangle
+		out[6 * face + 3] = C;
+		out[6 * face + 4] = B;
+		out[6 * face + 5] = D;
+	}
+}
+
+// The plank is built around the origin in its own frame, x = Right, y = Up, z = -Front
+// (Right = Front x Up, so Front has to be -z for the plank transform to be a rotation),
+// build_planks() moves it onto the track. offset is the size of the rail,
+// which should be the same as the makeRailRing offset
+
+//			A----------------------------E
+//		   /|                           /|
+//		  B-|--------------------------F |
+//        | D                          | H
+//        |/                           |/
+//        C----------------------------G
+//
+
+void TrackCore::makePlank(glm::vec2 offset)
+{
+	glm::vec3 front_offset, up_offset, right_offset;
+
+	// Calculate the offsets based on the given rail size
+	// offset[0] = left & right offset, offset[1] = up & down offset
+	up_offset = glm::vec3(0.0f, 1.0f, 0.0f) * offset[1] * 0.7f;
+	right_offset = glm::vec3(1.0f, 0.0f, 0.0f) * offset[0] * 0.9f;
+	front_offset = glm::vec3(0.0f, 0.0f, -1.0f) * offset[1] * 0.7f;
+
+	glm::vec3 pA = -right_offset + up_offset + front_offset;
+	glm::vec3 pB = -right_offset + up_offset - front_offset;
+	glm::vec3 pC = -right_offset - up_offset - front_offset;
+	glm::vec3 pD = -right_offset - up_offset + front_offset;
+
+	glm::vec3 pE = right_offset + up_offset + front_offset;
+	glm::vec3 pF = right_offset + up_offset - front_offset;
+	glm::vec3 pG = right_offset - up_offset - front_offset;
+	glm::vec3 pH = right_offset - up_offset + front_offset;
+
+	// Make faces
+	make_face(plank_vertices, plank_indices, pA, pE, pB, pF, false); // up face
+	make_face(plank_vertices, plank_indices, pD, pH, pA, pE, false); // back face
+	make_face(plank_vertices, plank_indices, pC, pG, pD, pH, false); // bottom face
+	make_face(plank_vertices, plank_indices, pB, pF, pC, pG, false); // front face
+}
+
+// One pillar of 8 sides, standing on y = 0 and one unit tall. The supports' vertex shader
+// (lightingShader_supports.vert) stretches it to every support's height, the sides' normals
+// are horizontal so they stay the same. No caps, the top is under the track and the bottom in the ground.
+
+//			A-----B      one side, seen from outside
+//			|     |
+//			C-----D      y = 0
+
+void TrackCore::makePillar(float radius)
+{
+	const int SIDES = 8;
+	for (int side = 0; side < SIDES; side++)
+	{
+		float a0 = 2.0f * 3.14159265f * side / SIDES, a1 = 2.0f * 3.14159265f * (side + 1) / SIDES;
+		glm::vec3 p0 = glm::vec3(cos(a0), 0.0f, sin(a0)) * radius, p1 = glm::vec3(cos(a1), 0.0f, sin(a1)) * radius;
+		glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+
+		// going round this way AC x AB points inwards
+		make_face(support_vertices, support_indices, p0 + up, p1 + up, p0, p1, true);
+	}
+}
+
+// Find the normal for each triangle uisng the cross product and then add it to all three vertices of the triangle.  
+//   The normalization of all the triangles happens in the shader which averages all norms of adjacent triangles.   
+//   Order of the triangles matters here since you want to normal facing out of the object.  
+void TrackCore::set_normals(Vertex &p1, Vertex &p2, Vertex &p3)
+{
+	glm::vec3 normal = glm::cross(p2.Position - p1.Position, p3.Position - p1.Position);
+	p1.Normal += normal;
+	p2.Normal += normal;
+	p3.Normal += normal;
+}